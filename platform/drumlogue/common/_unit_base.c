@@ -25,6 +25,9 @@ const __attribute__((weak, section(".unit_header"))) unit_header_t unit_header =
     .num_params = 0x0,
     .params = {{0}}};
 
+// Fallback unit capability flags, no optional capabilities by default
+const __attribute__((weak)) uint32_t unit_flags = k_unit_flags_none;
+
 // ---- Fallback entry points from drumlogue runtime ----------------------------------------------
 
 __attribute__((weak)) int8_t unit_init(const unit_runtime_desc_t * desc) {
@@ -81,6 +84,15 @@ __attribute__((weak)) void unit_set_param_value(uint8_t id, int32_t value) {
   (void)value;
 }
 
+__attribute__((weak)) void unit_set_param_values(const int32_t * values, uint32_t mask) {
+  // Fallback for units without a batched implementation: apply parameters one by one
+  while (mask) {
+    const uint8_t id = __builtin_ctz(mask);
+    unit_set_param_value(id, values[id]);
+    mask &= mask - 1;
+  }
+}
+
 __attribute__((weak)) void unit_set_tempo(uint32_t tempo) { (void)tempo; }
 
 __attribute__((weak)) void unit_note_on(uint8_t note, uint8_t mod) {
@@ -0,0 +1,386 @@
+/**
+ * @file biquad.h
+ * @brief Generic biquad structure and convenience methods
+ *
+ * Copyright (c) 2020-2022 KORG Inc. All rights reserved.
+ *
+ * Same interface as dsp::BiQuad of the NTS-1 mkII and NTS-3 SDKs, so that
+ * filter code can be shared across platforms.
+ */
+
+#ifndef DSP_BIQUAD_H_
+#define DSP_BIQUAD_H_
+
+#include <cstdint>
+
+#include "attributes.h"
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /**
+   * Transposed form 2 Bi-Quad construct for FIR/IIR filters.
+   */
+  struct BiQuad {
+    
+    // Transposed Form 2
+    
+    /*=====================================================================*/
+    /* Types and Data Structures.                                          */
+    /*=====================================================================*/
+
+    /**
+     * Filter coefficients
+     */
+    typedef struct Coeffs {
+      float ff0;
+      float ff1;
+      float ff2;
+      float fb1;
+      float fb2;
+      
+      /**
+       * Default constructor
+       */
+      Coeffs() :
+        ff0(0), ff1(0), ff2(0),
+        fb1(0), fb2(0)
+      { }
+
+      // -- Pre-calculations -------------------
+
+      /**
+       * Convert Hz frequency to radians
+       *
+       * @param   fc Frequency in Hz
+       * @param   fsrecip Reciprocal of sampling frequency (1/Fs)
+       */
+      static fast_inline
+      float wc(const float fc, const float fsrecip) {
+        return fc * fsrecip;
+      }
+      
+      // -- Filter types -----------------------
+
+      /**
+       * Calculate coefficients for single pole low pass filter.
+       *
+       * @param   pole Pole position in radians
+       */
+      fast_inline
+      void setPoleLP(const float pole) {
+        ff0 = 1.f - pole;
+        fb1 = -pole;
+        fb2 = ff2 = ff1 = 0.f;
+      }
+
+      /**
+       * Calculate coefficients for single pole high pass filter.
+       *
+       * @param   pole Pole position in radians
+       */
+      fast_inline
+      void setPoleHP(const float pole) {
+        ff0 = 1.f - pole;
+        fb1 = pole;
+        fb2 = ff2 = ff1 = 0.f;
+      }
+
+      /**
+       * Calculate coefficients for single pole DC filter.
+       *
+       * @param   pole Pole position in radians
+       */
+      fast_inline
+      void setFODC(const float pole) {
+        ff0 = 1.f;
+        ff1 = -1.f;
+        fb1 = -pole;
+        fb2 = ff2 = 0.f;
+      }
+
+      /**
+       * Calculate coefficients for first order low pass filter.
+       *
+       * @param   k Tangent of PI x cutoff frequency in radians: tan(pi*wc)
+       */
+      fast_inline
+      void setFOLP(const float k) {
+        const float kp1 = k+1.f;
+        const float km1 = k-1.f;
+        ff0 = ff1 = k / kp1;
+        fb1 = km1 / kp1;
+        fb2 = ff2 = 0.f;
+      }
+
+      /**
+       * Calculate coefficients for first order high pass filter.
+       *
+       * @param   k Tangent of PI x cutoff frequency in radians: tan(pi*wc)
+       */
+      fast_inline
+      void setFOHP(const float k) {
+        // k = tan(pi*wc)
+        const float kp1 = k+1.f;
+        const float km1 = k-1.f;
+        ff0 = 1.f / kp1;
+        ff1 = -ff0;
+        fb1 = km1 / kp1;
+        fb2 = ff2 = 0.f;
+      }
+
+      /**
+       * Calculate coefficients for first order all pass filter.
+       *
+       * @param   k Tangent of PI x cutoff frequency in radians: tan(pi*wc)
+       */
+      fast_inline
+      void setFOAP(const float k) {
+        // k = tan(pi*wc)
+        const float kp1 = k+1.f;
+        const float km1 = k-1.f;
+        ff0 = fb1 = km1 / kp1;
+        ff1 = 1.f;
+        fb2 = ff2 = 0.f;
+      }
+
+      /**
+       * Calculate coefficients for first order all pass filter.
+       *
+       * @param   wc cutoff frequency in radians
+       *
+       * @note Alternative implementation with no tangeant lookup
+       */
+      fast_inline
+      void setFOAP2(const float wc) {
+        // Note: alternative implementation for use in phasers
+        const float g1 = 1.f - wc;
+        ff0 = g1;
+        ff1 = -1;
+        fb1 = -g1;
+        fb2 = ff2 = 0.f;
+      }
+
+      /**
+       * Calculate coefficients for second order DC filter.
+       *
+       * @param   pole Pole position in radians
+       */
+      fast_inline
+      void setSODC(const float pole) {
+        ff0 = ff2 = 1.f;
+        ff1 = 2.f;
+        fb1 = -2.f * pole;
+        fb2 = pole * pole;
+      }
+
+      /**
+       * Calculate coefficients for second order low pass filter.
+       *
+       * @param   k Tangent of PI x cutoff frequency in radians: tan(pi*wc)
+       * @param   q Resonance with flat response at q = sqrt(2)
+       */
+      fast_inline
+      void setSOLP(const float k, const float q) {
+        // k = tan(pi*wc)
+        // flat response at q = sqrt(2)
+        const float qk2 = q * k * k;
+        const float qk2_k_q_r = 1.f / (qk2 + k + q);
+        ff0 = ff2 = qk2 * qk2_k_q_r;
+        ff1 = 2.f * ff0;
+        fb1 = 2.f * (qk2 - q) * qk2_k_q_r;
+        fb2 = (qk2 - k + q) * qk2_k_q_r;
+      }
+
+      /**
+       * Calculate coefficients for second order high pass filter.
+       *
+       * @param   k Tangent of PI x cutoff frequency in radians: tan(pi*wc)
+       * @param   q Resonance with flat response at q = sqrt(2)
+       */
+      fast_inline
+      void setSOHP(const float k, const float q) {
+        // k = tan(pi*wc)
+        // flat response at q = sqrt(2)
+        const float qk2 = q * k * k;
+        const float qk2_k_q_r = 1.f / (qk2 + k + q);
+        ff0 = ff2 = q * qk2_k_q_r;
+        ff1 = -2.f * ff0;
+        fb1 = 2.f * (qk2 - q) * qk2_k_q_r;
+        fb2 = (qk2 - k + q) * qk2_k_q_r;
+      }
+
+      /**
+       * Calculate coefficients for second order band pass filter.
+       *
+       * @param   k Tangent of PI x cutoff frequency in radians: tan(pi*wc)
+       * @param   q Resonance with flat response at q = sqrt(2)
+       */
+      fast_inline
+      void setSOBP(const float k, const float q) {
+        // k = tan(pi*wc)
+        // q is inverse of relative bandwidth (Fc / Fb)
+        const float qk2 = q * k * k;
+        const float qk2_k_q_r = 1.f / (qk2 + k + q);
+        ff0 = k * qk2_k_q_r;
+        ff1 = 0.f;
+        ff2 = -ff0;
+        fb1 = 2.f * (qk2 - q) * qk2_k_q_r;
+        fb2 = (qk2 - k + q) * qk2_k_q_r;
+      }
+
+      /**
+       * Calculate coefficients for second order band reject filter.
+       *
+       * @param   k Tangent of PI x cutoff frequency in radians: tan(pi*wc)
+       * @param   q Resonance with flat response at q = sqrt(2)
+       */
+      fast_inline
+      void setSOBR(const float k, const float q) {
+        // k = tan(pi*wc)
+        // q is inverse of relative bandwidth (Fc / Fb)
+        const float qk2 = q * k * k;
+        const float qk2_k_q_r = 1.f / (qk2 + k + q);
+        ff0 = ff2 = (qk2 + q) * qk2_k_q_r;
+        ff1 = fb1 = 2.f * (qk2 - q) * qk2_k_q_r;
+        fb2 = (qk2 - k + q) * qk2_k_q_r;
+      }
+
+      /**
+       * Calculate coefficients for second order all pass filter.
+       *
+       * @param   k Tangent of PI x cutoff frequency in radians: tan(pi*wc)
+       * @param   q Inverse of relative bandwidth (Fc / Fb)
+       */
+      fast_inline
+      void setSOAP1(const float k, const float q) {
+        // k = tan(pi*wc)
+        // q is inverse of relative bandwidth (Fc / Fb)
+        const float qk2 = q * k * k;
+        const float qk2_k_q_r = 1.f / (qk2 + k + q);
+        ff0 = fb2 = (qk2 - k + q) * qk2_k_q_r;
+        ff1 = fb1 = 2.f * (qk2 - q) * qk2_k_q_r;
+        ff2 = 1.f;
+      }
+
+      /**
+       * Calculate coefficients for second order all pass filter.
+       *
+       * @param   delta cos(2pi*wc)
+       * @param   gamma tan(pi * wb)
+       *
+       * @note q is inverse of relative bandwidth (wc / wb)
+       * @note Alternative implementation, so called "tunable" in DAFX second edition.
+       */
+      fast_inline
+      void setSOAP2(const float delta, const float gamma) {
+        // Note: Alternative implementation .. so called "tunable" in DAFX.
+        // delta = cos(2pi*wc)
+        const float c = (gamma - 1.f) / (gamma + 1.f);
+        const float d = -delta;
+        ff0 = fb2 = -c;
+        ff1 = fb1 = d * (1.f - c);
+        ff2 = 1.f;
+      }
+
+      /**
+       * Calculate coefficients for second order all pass filter.
+       *
+       * @param   delta cos(2pi*wc)
+       * @param   radius 
+       *
+       * @note Another alternative implementation.
+       */
+      fast_inline
+      void setSOAP3(const float delta, const float radius) {
+        // Note: alternative implementation for use in phasers
+        // delta = cos(2pi * wc)
+        const float a1 = -2.f * radius * delta;
+        const float a2 = radius * radius;
+        ff0 = fb2 = a2;
+        ff1 = fb1 = a1;
+        ff2 = 1.f;
+      }
+        
+    } Coeffs;
+      
+    /*=====================================================================*/
+    /* Constructor / Destructor.                                           */
+    /*=====================================================================*/
+
+    /**
+     * Default constructor
+     */
+    BiQuad(void) : mZ1(0), mZ2(0)
+    { }
+      
+    /*=====================================================================*/
+    /* Public Methods.                                                     */
+    /*=====================================================================*/
+
+    /**
+     * Flush internal delays
+     */
+    fast_inline
+    void flush(void) {
+      mZ1 = mZ2 = 0;
+    }
+
+    /**
+     * Second order processing of one sample
+     *
+     * @param xn  Input sample
+     *
+     * @return Output sample
+     */
+    fast_inline
+    float process_so(const float xn) {
+      float acc = mCoeffs.ff0 * xn + mZ1;
+      mZ1 = mCoeffs.ff1 * xn + mZ2;
+      mZ2 = mCoeffs.ff2 * xn;
+      mZ1 -= mCoeffs.fb1 * acc;
+      mZ2 -= mCoeffs.fb2 * acc;
+      return acc;
+    }
+
+    /**
+     * First order processing of one sample
+     *
+     * @param xn  Input sample
+     *
+     * @return Output sample
+     */
+    fast_inline
+    float process_fo(const float xn) {
+      float acc = mCoeffs.ff0 * xn + mZ1;
+      mZ1 = mCoeffs.ff1 * xn;
+      mZ1 -= mCoeffs.fb1 * acc;
+      return acc;
+    }
+
+    /**
+     * Default processing function (second order)
+     *
+     * @param xn  Input sample
+     *
+     * @return Output sample
+     */
+    fast_inline
+    float process(const float xn) {
+      return process_so(xn);
+    }
+      
+    /*=====================================================================*/
+    /* Member Variables.                                                   */
+    /*=====================================================================*/
+
+    /** Coefficients for the Bi-Quad construct */
+    Coeffs mCoeffs;
+    float mZ1, mZ2;      
+  };
+
+}  // namespace dsp
+
+#endif  // DSP_BIQUAD_H_
@@ -0,0 +1,147 @@
+/**
+ * @file delayline.h
+ * @brief Basic delay line
+ *
+ * Copyright (c) 2020-2022 KORG Inc. All rights reserved.
+ *
+ * Same interface as dsp::DelayLine of the NTS-1 mkII and NTS-3 SDKs, so that
+ * delay based code can be shared across platforms.
+ */
+
+#ifndef DSP_DELAYLINE_H_
+#define DSP_DELAYLINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "attributes.h"
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /**
+   * Basic delay line abstraction.
+   */
+  struct DelayLine {
+
+    /*===========================================================================*/
+    /* Constructor / Destructor.                                                 */
+    /*===========================================================================*/
+
+    /**
+     * Default constructor
+     */
+    DelayLine(void) :
+      mLine(0),
+      mFracZ(0),
+      mSize(0),
+      mMask(0),
+      mWriteIdx(0)
+    { }
+
+    /**
+     * Constructor with explicit memory area to use as backing buffer for delay line.
+     *
+     * @param ram Pointer to memory buffer
+     * @param line_size Size in float of memory buffer, must be a power of two
+     */
+    DelayLine(float *ram, size_t line_size) :
+      mLine(ram),
+      mFracZ(0),
+      mSize(line_size),
+      mMask(line_size-1),
+      mWriteIdx(0)
+    { }
+
+    /*===========================================================================*/
+    /* Public Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * Zero clear the whole delay line.
+     */
+    fast_inline void clear(void) {
+      std::memset(mLine, 0, mSize * sizeof(float));
+      mFracZ = 0;
+    }
+
+    /**
+     * Set the memory area to use as backing buffer for the delay line.
+     *
+     * @param ram Pointer to memory buffer
+     * @param line_size Size in float of memory buffer
+     *
+     * @note Will round size down to a power of two, so as not to overrun the buffer.
+     */
+    fast_inline void setMemory(float *ram, size_t line_size) {
+      mLine = ram;
+      mSize = (line_size) ? (1U << (31 - __builtin_clz(line_size))) : 0;
+      mMask = (mSize-1);
+      mWriteIdx = 0;
+    }
+
+    /**
+     * Write a single sample to the head of the delay line
+     *
+     * @param s Sample to write
+     */
+    fast_inline void write(const float s) {
+      mLine[(mWriteIdx--) & mMask] = s;
+    }
+
+    /**
+     * Read a single sample from the delay line at given position from current write index.
+     *
+     * @param pos Offset from write index, i.e.: a sample written pos calls to write() ago
+     * @return Sample at given position from write index
+     */
+    fast_inline float read(const uint32_t pos) const {
+      return mLine[(mWriteIdx + pos) & mMask];
+    }
+
+    /**
+     * Read a sample from the delay line at a fractional position from current write index.
+     *
+     * @param pos Offset from write index as floating point.
+     * @return Linearly interpolated sample at given fractional position from write index
+     */
+    fast_inline float readFrac(const float pos) const {
+      const uint32_t base = (uint32_t)pos;
+      const float frac = pos - base;
+      const float s0 = read(base);
+      const float s1 = read(base+1);
+      return s0 + frac * (s1 - s0);
+    }
+
+    /**
+     * Read a sample from the delay line at a position from current write index with interpolation from last read.
+     *
+     * @param pos Offset from write index
+     * @param frac Interpolation from last read pair.
+     * @return Interpolation of last read sample and sample at given position from write index.
+     */
+    fast_inline float readFracz(const uint32_t pos, const float frac) {
+      const float s0 = read(pos);
+      const float y = s0 + frac * (mFracZ - s0);
+      mFracZ = s0;
+      return y;
+    }
+
+    /*===========================================================================*/
+    /* Member Variables.                                                         */
+    /*===========================================================================*/
+
+    float   *mLine;
+    float    mFracZ;
+    size_t   mSize;
+    size_t   mMask;
+    uint32_t mWriteIdx;
+
+  };
+
+}  // namespace dsp
+
+#endif  // DSP_DELAYLINE_H_
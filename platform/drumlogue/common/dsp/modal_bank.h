@@ -0,0 +1,312 @@
+/**
+ * @file modal_bank.h
+ * @brief Bank of parallel two-pole resonators for modal synthesis
+ *
+ * Copyright (c) 2020-2022 KORG Inc. All rights reserved.
+ *
+ * Each mode is a two-pole resonator with its own frequency, decay time and
+ * gain:
+ *
+ *   y[n] = a1 y[n-1] - a2 y[n-2] + b x[n],
+ *   a1 = 2 r cos(w), a2 = r^2, b = gain sin(w)
+ *
+ * Coefficients and state are kept as structures of arrays, and four modes
+ * are updated at once with NEON. A trigger clears the state and sets the
+ * impulse response of each mode in place, so it costs a few stores per mode.
+ * An excitation signal (noise, a sample...) can also be fed to all modes.
+ *
+ * @code
+ * dsp::ModalBank<16> tom_;
+ *
+ * // Init()
+ * tom_.init(desc->samplerate);
+ * tom_.setModes(110.f, dsp::k_modal_membrane_ratios, nullptr, 16, 0.8f, 0.5f);
+ *
+ * // NoteOn()
+ * tom_.trigger(velocity * (1.f / 127.f));
+ *
+ * // Render(), mono render, silent banks return right away
+ * std::memset(mono_, 0, frames * sizeof(float));
+ * tom_.process(nullptr, mono_, frames);
+ * @endcode
+ *
+ * Note: per sample cost is about 5 NEON instructions per 4 modes, plus one
+ *       vector accumulation per 8 modes and one reduction into the output.
+ */
+
+#ifndef DSP_MODAL_BANK_H_
+#define DSP_MODAL_BANK_H_
+
+#include <arm_neon.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "attributes.h"
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /** Frequency ratios of the first modes of an ideal circular membrane */
+  static const float k_modal_membrane_ratios[16] = {
+    1.000f, 1.594f, 2.136f, 2.296f, 2.653f, 2.918f, 3.156f, 3.501f,
+    3.600f, 3.652f, 4.060f, 4.154f, 4.230f, 4.601f, 4.832f, 4.903f
+  };
+
+  /** Frequency ratios of the first modes of an ideal free bar */
+  static const float k_modal_bar_ratios[8] = {
+    1.000f, 2.756f, 5.404f, 8.933f, 13.345f, 18.638f, 24.814f, 31.870f
+  };
+
+  /**
+   * Bank of parallel two-pole resonators.
+   *
+   * @tparam Modes Number of modes, multiple of 4 in [4, 64]
+   */
+  template <size_t Modes>
+  struct ModalBank {
+    static_assert(Modes >= 4 && Modes <= 64 && (Modes & 3) == 0, "Modes must be a multiple of 4 in [4, 64]");
+
+    /*===========================================================================*/
+    /* Constructor / Destructor.                                                 */
+    /*===========================================================================*/
+
+    ModalBank(void) :
+      mFsRecip(1.f / 48000.f),
+      mActive(false)
+    {
+      std::memset(mA1, 0, sizeof(mA1));
+      std::memset(mA2, 0, sizeof(mA2));
+      std::memset(mB, 0, sizeof(mB));
+      reset();
+    }
+
+    /*===========================================================================*/
+    /* Public Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * @param samplerate Sampling frequency in Hz
+     */
+    inline void init(const float samplerate) {
+      mFsRecip = 1.f / samplerate;
+      reset();
+    }
+
+    /**
+     * Silence all modes.
+     */
+    inline void reset(void) {
+      std::memset(mY1, 0, sizeof(mY1));
+      std::memset(mY2, 0, sizeof(mY2));
+      mActive = false;
+    }
+
+    /**
+     * Set a single mode. Can be called while the bank sounds.
+     *
+     * @param i Mode index
+     * @param hz Frequency in Hz, modes too close to Nyquist are muted
+     * @param decay Time to -60dB in seconds, 0 mutes the mode
+     * @param gain Amplitude of the mode on trigger(1.f)
+     */
+    inline void setMode(const size_t i, const float hz, const float decay, const float gain) {
+      if (i >= Modes)
+        return;
+      const float w = 6.28318531f * hz * mFsRecip;
+      if (!(w > 0.f && w < 3.f) || !(decay > 0.f)) {
+        mA1[i] = mA2[i] = mB[i] = 0.f;
+        return;
+      }
+      const float r = expf(-6.9077553f * mFsRecip / decay);
+      mA1[i] = 2.f * r * cosf(w);
+      mA2[i] = r * r;
+      mB[i] = gain * sinf(w);
+    }
+
+    /**
+     * Set modes from a table of frequency ratios, e.g.: k_modal_membrane_ratios.
+     * Modes beyond count are muted.
+     *
+     * @param hz Frequency of the first mode in Hz
+     * @param ratios Frequency ratios to the first mode
+     * @param gains Gains of each mode, nullptr for 1 / (i + 1)
+     * @param count Number of entries in ratios and gains
+     * @param decay Time to -60dB of the first mode in seconds
+     * @param damping Higher modes decay faster, by 1 + damping * (ratio - 1)
+     */
+    inline void setModes(const float hz, const float *ratios, const float *gains, size_t count,
+                         const float decay, const float damping) {
+      if (count > Modes)
+        count = Modes;
+      for (size_t i = 0; i < count; ++i) {
+        const float gain = gains ? gains[i] : 1.f / (i + 1);
+        setMode(i, hz * ratios[i], decay / (1.f + damping * (ratios[i] - 1.f)), gain);
+      }
+      for (size_t i = count; i < Modes; ++i)
+        setMode(i, 0.f, 0.f, 0.f);
+    }
+
+    /**
+     * Strike: clear the state and start the impulse response of every mode.
+     *
+     * @param velocity Impulse amplitude
+     */
+    inline void trigger(const float velocity) {
+      // Note: y[-1] = b * velocity, y[-2] = 0, output starts with y[-1]
+      const float32x4_t v = vdupq_n_f32(velocity);
+      const float32x4_t zero = vdupq_n_f32(0.f);
+      for (size_t i = 0; i < Modes; i += 4) {
+        vst1q_f32(mY1 + i, vmulq_f32(vld1q_f32(mB + i), v));
+        vst1q_f32(mY2 + i, zero);
+      }
+      mActive = true;
+    }
+
+    inline bool isActive(void) const { return mActive; }
+
+    /**
+     * Render a block, mixed into the output.
+     *
+     * @param exc Excitation fed to all modes, nullptr for none
+     * @param out Mono output buffer, the bank output is added to its content
+     * @param frames Number of frames to render
+     */
+    inline void process(const float * __restrict exc, float * __restrict out, size_t frames) {
+      if (!mActive && !exc)
+        return;
+
+      // Note: mode outputs are summed as vectors per chunk, and reduced once per sample
+      float32x4_t acc[k_chunk];
+      for (size_t done = 0; done < frames; done += k_chunk) {
+        const size_t n = (frames - done < k_chunk) ? frames - done : k_chunk;
+        const float * exc_c = exc ? exc + done : nullptr;
+        for (size_t k = 0; k < n; ++k)
+          acc[k] = vdupq_n_f32(0.f);
+        size_t i = 0;
+        for (; i + 8 <= Modes; i += 8)
+          processPair(i, exc_c, acc, n);
+        if (i < Modes)
+          processGroup(i, exc_c, acc, n);
+        float * __restrict out_p = out + done;
+        for (size_t k = 0; k < n; ++k)
+          out_p[k] += hsum(acc[k]);
+      }
+
+      float32x4_t peak = vdupq_n_f32(0.f);
+      for (size_t i = 0; i < Modes; i += 4)
+        peak = vmaxq_f32(peak, vmaxq_f32(vabsq_f32(vld1q_f32(mY1 + i)), vabsq_f32(vld1q_f32(mY2 + i))));
+
+      // Note: about -120dB, also clears the state before values go subnormal
+      float32x2_t p = vpmax_f32(vget_low_f32(peak), vget_high_f32(peak));
+      p = vpmax_f32(p, p);
+      if (!exc && vget_lane_f32(p, 0) < 1e-6f)
+        reset();
+      else
+        mActive = true;
+    }
+
+   private:
+
+    /*===========================================================================*/
+    /* Private Methods.                                                          */
+    /*===========================================================================*/
+
+    /**
+     * Two groups of 4 modes per sample, independent recursions hide each other's latency.
+     */
+    fast_inline void processPair(const size_t i, const float * __restrict exc, float32x4_t * __restrict acc,
+                                 const size_t frames) {
+      const float32x4_t a1a = vld1q_f32(mA1 + i), a1b = vld1q_f32(mA1 + i + 4);
+      const float32x4_t a2a = vld1q_f32(mA2 + i), a2b = vld1q_f32(mA2 + i + 4);
+      float32x4_t y1a = vld1q_f32(mY1 + i), y1b = vld1q_f32(mY1 + i + 4);
+      float32x4_t y2a = vld1q_f32(mY2 + i), y2b = vld1q_f32(mY2 + i + 4);
+
+      if (exc) {
+        const float32x4_t ba = vld1q_f32(mB + i), bb = vld1q_f32(mB + i + 4);
+        for (size_t k = 0; k < frames; ++k) {
+          acc[k] = vaddq_f32(acc[k], vaddq_f32(y1a, y1b));
+          const float32x4_t ya = vmlaq_n_f32(vmlsq_f32(vmulq_f32(a1a, y1a), a2a, y2a), ba, exc[k]);
+          const float32x4_t yb = vmlaq_n_f32(vmlsq_f32(vmulq_f32(a1b, y1b), a2b, y2b), bb, exc[k]);
+          y2a = y1a;
+          y2b = y1b;
+          y1a = ya;
+          y1b = yb;
+        }
+      } else {
+        for (size_t k = 0; k < frames; ++k) {
+          acc[k] = vaddq_f32(acc[k], vaddq_f32(y1a, y1b));
+          const float32x4_t ya = vmlsq_f32(vmulq_f32(a1a, y1a), a2a, y2a);
+          const float32x4_t yb = vmlsq_f32(vmulq_f32(a1b, y1b), a2b, y2b);
+          y2a = y1a;
+          y2b = y1b;
+          y1a = ya;
+          y1b = yb;
+        }
+      }
+
+      vst1q_f32(mY1 + i, y1a);
+      vst1q_f32(mY1 + i + 4, y1b);
+      vst1q_f32(mY2 + i, y2a);
+      vst1q_f32(mY2 + i + 4, y2b);
+    }
+
+    /**
+     * Last group of 4 modes when Modes is not a multiple of 8.
+     */
+    fast_inline void processGroup(const size_t i, const float * __restrict exc, float32x4_t * __restrict acc,
+                                  const size_t frames) {
+      const float32x4_t a1 = vld1q_f32(mA1 + i);
+      const float32x4_t a2 = vld1q_f32(mA2 + i);
+      float32x4_t y1 = vld1q_f32(mY1 + i);
+      float32x4_t y2 = vld1q_f32(mY2 + i);
+
+      if (exc) {
+        const float32x4_t b = vld1q_f32(mB + i);
+        for (size_t k = 0; k < frames; ++k) {
+          acc[k] = vaddq_f32(acc[k], y1);
+          const float32x4_t y = vmlaq_n_f32(vmlsq_f32(vmulq_f32(a1, y1), a2, y2), b, exc[k]);
+          y2 = y1;
+          y1 = y;
+        }
+      } else {
+        for (size_t k = 0; k < frames; ++k) {
+          acc[k] = vaddq_f32(acc[k], y1);
+          const float32x4_t y = vmlsq_f32(vmulq_f32(a1, y1), a2, y2);
+          y2 = y1;
+          y1 = y;
+        }
+      }
+
+      vst1q_f32(mY1 + i, y1);
+      vst1q_f32(mY2 + i, y2);
+    }
+
+    static fast_inline float hsum(const float32x4_t v) {
+      const float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+      return vget_lane_f32(vpadd_f32(s, s), 0);
+    }
+
+    /*===========================================================================*/
+    /* Member Variables.                                                         */
+    /*===========================================================================*/
+
+    /** Frames per accumulation chunk, bounds the stack used by process() to 512 bytes */
+    static const size_t k_chunk = 32;
+
+    float mA1[Modes] __attribute__((aligned(16)));
+    float mA2[Modes] __attribute__((aligned(16)));
+    float mB[Modes] __attribute__((aligned(16)));
+    float mY1[Modes] __attribute__((aligned(16)));
+    float mY2[Modes] __attribute__((aligned(16)));
+    float mFsRecip;
+    bool  mActive;
+  };
+
+}  // namespace dsp
+
+#endif  // DSP_MODAL_BANK_H_
@@ -0,0 +1,585 @@
+/**
+ * @file string_voice.h
+ * @brief Plucked string voices (Karplus-Strong / digital waveguide)
+ *
+ * Copyright (c) 2020-2022 KORG Inc. All rights reserved.
+ *
+ * Each voice is a feedback loop made of a delay line, a first order allpass
+ * for the fractional part of the period, and a loss filter (dsp::BiQuad,
+ * first order low pass) setting the decay of the partials. The loop is
+ * excited either by a burst of filtered noise, one period long, or by a
+ * sample from the drumlogue sample banks, fed to the loop as is (e.g.: a
+ * body or pick recording).
+ *
+ * Tuning accounts for the phase delay of the loss filter at the fundamental,
+ * and the allpass coefficient is exact at the fundamental rather than the
+ * usual low frequency approximation, which is off by up to a dozen cents at
+ * the top of the note range.
+ *
+ * Loop gains compensate the loss of the filter at the fundamental, so that
+ * decay times hold across the note range. Where that would take the loop
+ * gain at DC above unity (long decays, dark strings, top octave), the loss
+ * filter is partly bypassed instead: decay times are kept at the expense of
+ * brightness.
+ *
+ * Voices run from a pool owning the delay memory, e.g.:
+ *
+ * @code
+ * dsp::StringVoicePool<6> strings_;
+ *
+ * // Init()
+ * strings_.Init(desc->samplerate);
+ *
+ * // NoteOn(), with a sample from the banks or nullptr for noise
+ * strings_.setSample(desc->get_sample(bank, index));
+ * strings_.NoteOn(note, velocity);
+ *
+ * // Render(), mono render then copy to both output channels
+ * strings_.Render(mono_, frames);
+ * @endcode
+ *
+ * Note: coefficients are computed at note on and on pitch or parameter
+ *       changes only, per sample work is about 10 operations per voice.
+ */
+
+#ifndef DSP_STRING_VOICE_H_
+#define DSP_STRING_VOICE_H_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "attributes.h"
+#include "sample_wrapper.h"
+#include "dsp/biquad.h"
+#include "dsp/delayline.h"
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /**
+   * String parameters, shared by the voices of a pool.
+   */
+  struct StringParams {
+    float decay;       /**< Time to -60dB while the note is held, in seconds */
+    float release;     /**< Time to -60dB after note off, in seconds */
+    float brightness;  /**< Loss filter cutoff in [0, 1], from 8x to 256x the fundamental */
+    float pick;        /**< Noise excitation tone in [0, 1], from dark to white */
+
+    StringParams(void) :
+      decay(4.f),
+      release(0.3f),
+      brightness(0.5f),
+      pick(1.f)
+    { }
+  };
+
+  /**
+   * Single plucked string.
+   */
+  struct StringVoice {
+
+    /*===========================================================================*/
+    /* Constructor / Destructor.                                                 */
+    /*===========================================================================*/
+
+    StringVoice(void) :
+      mFs(48000.f),
+      mHz(440.f),
+      mDecay(4.f),
+      mRelease(0.3f),
+      mBrightness(0.5f),
+      mDelayInt(1),
+      mApC(0),
+      mApX(0),
+      mApY(0),
+      mDry(0),
+      mWet(0),
+      mDecayDry(0),
+      mDecayWet(0),
+      mReleaseDry(0),
+      mReleaseWet(0),
+      mQuiet(0),
+      mExcPtr(0),
+      mExcStride(0),
+      mExcLeft(0),
+      mExcGain(0),
+      mNoiseLeft(0),
+      mPickA(1.f),
+      mPickZ(0),
+      mRand(0x2545F491U),
+      mHeld(false),
+      mActive(false)
+    { }
+
+    /*===========================================================================*/
+    /* Public Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * Set the delay memory, which bounds the lowest pitch to samplerate / line_size.
+     *
+     * @param ram Pointer to memory buffer
+     * @param line_size Size in float of memory buffer, must be a power of two
+     */
+    inline void setMemory(float *ram, size_t line_size) {
+      mLine.setMemory(ram, line_size);
+    }
+
+    /**
+     * Seed the noise excitation, so that voices struck together do not play the same burst.
+     *
+     * @param seed Any value, zero is replaced as it would lock up the generator
+     */
+    inline void setSeed(uint32_t seed) {
+      mRand = seed ? seed : 0x2545F491U;
+    }
+
+    /**
+     * @param samplerate Sampling frequency in Hz
+     */
+    inline void init(const float samplerate) {
+      mFs = samplerate;
+      reset();
+    }
+
+    /**
+     * Silence the voice and clear its state.
+     */
+    inline void reset(void) {
+      mLine.clear();
+      mLoss.flush();
+      mApX = mApY = 0;
+      mExcLeft = mNoiseLeft = 0;
+      mQuiet = 0;
+      mPickZ = 0;
+      mHeld = mActive = false;
+    }
+
+    /**
+     * Pluck the string.
+     *
+     * @param hz Fundamental frequency in Hz
+     * @param gain Excitation gain, e.g.: from velocity
+     * @param p String parameters
+     * @param sample Sample to excite the string with, first channel only, nullptr for a noise burst
+     */
+    inline void trigger(const float hz, const float gain, const StringParams &p,
+                        const sample_wrapper_t *sample) {
+      // Note: state is kept, so that retriggering a sounding string does not click
+      mHz = hz;
+      mHeld = true;
+      mActive = true;
+      setParams(p);
+      mExcGain = gain;
+      if (sample && sample->sample_ptr && sample->frames) {
+        mExcPtr = sample->sample_ptr;
+        mExcStride = sample->channels ? sample->channels : 1;
+        mExcLeft = sample->frames;
+        mNoiseLeft = 0;
+      } else {
+        mExcLeft = 0;
+        mNoiseLeft = (uint32_t)(mFs / mHz + 0.5f);
+      }
+    }
+
+    /**
+     * Note off, the string now decays with the release time.
+     */
+    inline void release(void) {
+      mHeld = false;
+      mDry = mReleaseDry;
+      mWet = mReleaseWet;
+    }
+
+    /**
+     * Retune, e.g.: on pitch bend. Can be called while the string sounds.
+     *
+     * @param hz Fundamental frequency in Hz
+     */
+    inline void setPitch(const float hz) {
+      mHz = hz;
+      updateLoop();
+    }
+
+    /**
+     * Apply string parameters. Can be called while the string sounds.
+     *
+     * @param p String parameters
+     */
+    inline void setParams(const StringParams &p) {
+      mDecay = p.decay;
+      mRelease = p.release;
+      mBrightness = p.brightness;
+      mPickA = 0.05f + 0.95f * p.pick;
+      updateLoop();
+    }
+
+    inline bool isActive(void) const { return mActive; }
+    inline bool isHeld(void) const { return mHeld; }
+
+    /**
+     * Render a block, mixed into the output.
+     *
+     * @param out Mono output buffer, the voice output is added to its content
+     * @param frames Number of frames to render
+     */
+    inline void process(float * __restrict out, size_t frames) {
+      if (!mActive)
+        return;
+
+      const uint32_t frames_total = (uint32_t)frames;
+      float peak = 0;
+      while (frames) {
+        size_t len = frames;
+        if (mNoiseLeft) {
+          len = (len < mNoiseLeft) ? len : mNoiseLeft;
+          peak = run<k_exc_noise>(out, len, peak);
+          mNoiseLeft -= len;
+        } else if (mExcLeft) {
+          len = (len < mExcLeft) ? len : mExcLeft;
+          peak = run<k_exc_sample>(out, len, peak);
+          mExcLeft -= len;
+        } else {
+          peak = run<k_exc_none>(out, len, peak);
+        }
+        out += len;
+        frames -= len;
+      }
+
+      // Note: about -100dB, also clears the loop before values go subnormal. The loop only
+      //       holds past output, so the string is silent once a whole period stayed below.
+      if (mNoiseLeft || mExcLeft || peak >= 1e-5f)
+        mQuiet = 0;
+      else if ((mQuiet += frames_total) > mDelayInt + 2)
+        reset();
+    }
+
+   private:
+
+    enum {
+      k_exc_none = 0,
+      k_exc_noise,
+      k_exc_sample,
+    };
+
+    /*===========================================================================*/
+    /* Private Methods.                                                          */
+    /*===========================================================================*/
+
+    /**
+     * Recompute the loop for the current pitch and parameters.
+     */
+    inline void updateLoop(void) {
+      const float max_period = (float)(mLine.mSize - 1);
+      float period = mFs / mHz;
+      if (period > max_period)
+        period = max_period;
+
+      // Loss filter, cutoff relative to the fundamental
+      const float nyq = 0.45f * mFs;
+      float fc = mHz * exp2f(3.f + 5.f * mBrightness);
+      if (fc > nyq)
+        fc = nyq;
+      mLoss.mCoeffs.setFOLP(tanf(3.14159265f * fc / mFs));
+
+      // Response of the loss filter at the fundamental:
+      // H = ff0 (1 + z^-1) / (1 + fb1 z^-1)
+      const float w = 6.28318531f * mHz / mFs;
+      const float cw = cosf(w);
+      const float sw = sinf(w);
+      const float ff0 = mLoss.mCoeffs.ff0;
+      const float fb1 = mLoss.mCoeffs.fb1;
+      const float num_re = ff0 * (1.f + cw);
+      const float num_im = -ff0 * sw;
+      const float den_re = 1.f + fb1 * cw;
+      const float den_im = -fb1 * sw;
+      const float den_rcp = 1.f / (den_re * den_re + den_im * den_im);
+      const float h_re = (num_re * den_re + num_im * den_im) * den_rcp;
+      const float h_im = (num_im * den_re - num_re * den_im) * den_rcp;
+
+      // Loop gains giving the requested -60dB times to the fundamental
+      const float decay_gain = expf(-6.9077553f * period / (mFs * mDecay));
+      const float release_gain = expf(-6.9077553f * period / (mFs * mRelease));
+
+      // Loss stage is x + wet (H x - x), DC gain of 1. The loop gain, i.e.: the gain at DC, is kept
+      // below unity by bypassing part of the filter when it alone loses too much at the fundamental.
+      const float target = fmaxf(decay_gain, release_gain);
+      const float max_gain = fmaxf(0.9999f, target);
+      const float min_h = target / max_gain;
+      float wet = 1.f;
+      if (h_re * h_re + h_im * h_im < min_h * min_h) {
+        // Smallest root of |1 + wet (H - 1)|^2 = min_h^2, within [0, 1)
+        const float a = (h_re - 1.f) * (h_re - 1.f) + h_im * h_im;
+        const float b = 2.f * (h_re - 1.f);
+        const float c = 1.f - min_h * min_h;
+        wet = (-b - sqrtf(fmaxf(b * b - 4.f * a * c, 0.f))) / (2.f * a);
+      }
+      const float mix_re = 1.f + wet * (h_re - 1.f);
+      const float mix_im = wet * h_im;
+      const float loss_delay = -atan2f(mix_im, mix_re) / w;
+      const float rcp_gain = 1.f / sqrtf(mix_re * mix_re + mix_im * mix_im);
+
+      // Integer part, keeping the allpass delay within [0.1, 1.1) where its phase is well behaved
+      float rem = period - loss_delay;
+      int32_t n = (int32_t)(rem - 0.1f);
+      if (n < 1)
+        n = 1;
+      mDelayInt = (uint32_t)n;
+      const float d = rem - n;
+
+      // Allpass coefficient with a phase delay of exactly d at the fundamental
+      mApC = sinf(0.5f * w * (1.f - d)) / sinf(0.5f * w * (1.f + d));
+
+      const float decay_g = fminf(decay_gain * rcp_gain, max_gain);
+      const float release_g = fminf(release_gain * rcp_gain, max_gain);
+      mDecayDry = decay_g * (1.f - wet);
+      mDecayWet = decay_g * wet;
+      mReleaseDry = release_g * (1.f - wet);
+      mReleaseWet = release_g * wet;
+      mDry = mHeld ? mDecayDry : mReleaseDry;
+      mWet = mHeld ? mDecayWet : mReleaseWet;
+    }
+
+    /**
+     * White noise in [-1, 1), xorshift32.
+     */
+    fast_inline float noise(void) {
+      mRand ^= mRand << 13;
+      mRand ^= mRand >> 17;
+      mRand ^= mRand << 5;
+      return (int32_t)mRand * 4.656612873e-10f;
+    }
+
+    /**
+     * Inner loop, specialized per excitation source.
+     */
+    template <int Exc>
+    fast_inline float run(float * __restrict out, size_t frames, float peak) {
+      const uint32_t n = mDelayInt;
+      const float c = mApC;
+      const float dry = mDry;
+      const float wet = mWet;
+      const float exc_gain = mExcGain;
+      const float pick_a = mPickA;
+      float ap_x = mApX;
+      float ap_y = mApY;
+      float pick_z = mPickZ;
+      const float *exc = mExcPtr;
+      const uint32_t stride = mExcStride;
+
+      for (const float *out_e = out + frames; out != out_e; ++out) {
+        const float s = mLine.read(n);
+        // y[n] = c x[n] + x[n-1] - c y[n-1]
+        ap_y = c * (s - ap_y) + ap_x;
+        ap_x = s;
+        float y = dry * ap_y + wet * mLoss.process_fo(ap_y);
+        if (Exc == k_exc_noise) {
+          pick_z += pick_a * (noise() - pick_z);
+          y += exc_gain * pick_z;
+        } else if (Exc == k_exc_sample) {
+          y += exc_gain * *exc;
+          exc += stride;
+        }
+        mLine.write(y);
+        *out += y;
+        const float a = fabsf(y);
+        peak = (a > peak) ? a : peak;
+      }
+
+      mApX = ap_x;
+      mApY = ap_y;
+      mPickZ = pick_z;
+      mExcPtr = exc;
+      return peak;
+    }
+
+    /*===========================================================================*/
+    /* Member Variables.                                                         */
+    /*===========================================================================*/
+
+    DelayLine mLine;
+    BiQuad    mLoss;
+    float     mFs;
+    float     mHz;
+    float     mDecay;
+    float     mRelease;
+    float     mBrightness;
+    uint32_t  mDelayInt;
+    float     mApC;
+    float     mApX;
+    float     mApY;
+    float     mDry;
+    float     mWet;
+    float     mDecayDry;
+    float     mDecayWet;
+    float     mReleaseDry;
+    float     mReleaseWet;
+    uint32_t  mQuiet;
+    const float *mExcPtr;
+    uint32_t  mExcStride;
+    size_t    mExcLeft;
+    float     mExcGain;
+    uint32_t  mNoiseLeft;
+    float     mPickA;
+    float     mPickZ;
+    uint32_t  mRand;
+    bool      mHeld;
+    bool      mActive;
+  };
+
+  /**
+   * Pool of plucked strings with voice allocation, owning the delay memory.
+   *
+   * @tparam Voices Number of voices
+   * @tparam LineSize Delay line size in float per voice, power of two. The
+   *         default of 4096 reaches down to 11.7Hz at 48kHz.
+   */
+  template <size_t Voices, size_t LineSize = 4096>
+  class StringVoicePool {
+    static_assert(Voices > 0, "At least one voice");
+    static_assert(LineSize >= 16 && (LineSize & (LineSize - 1)) == 0, "LineSize must be a power of two");
+
+   public:
+    StringVoicePool(void) : sample_(nullptr), bend_(0), age_(0) {
+      for (size_t i = 0; i < Voices; ++i) {
+        voices_[i].setMemory(lines_[i], LineSize);
+        voices_[i].setSeed(0x2545F491U ^ (uint32_t)(i * 0x9E3779B9U));
+        notes_[i] = 0xFF;
+        ages_[i] = 0;
+      }
+    }
+
+    /**
+     * @param samplerate Sampling frequency in Hz
+     */
+    inline void Init(float samplerate) {
+      for (size_t i = 0; i < Voices; ++i)
+        voices_[i].init(samplerate);
+      // Note: excitations are not zero mean and the loops hold DC as long as the fundamental, about 5Hz
+      dc_.mCoeffs.setFODC(1.f - 31.4159265f / samplerate);
+      dc_.flush();
+    }
+
+    /**
+     * Silence all voices.
+     */
+    inline void Reset() {
+      for (size_t i = 0; i < Voices; ++i) {
+        voices_[i].reset();
+        notes_[i] = 0xFF;
+      }
+      dc_.flush();
+    }
+
+    /**
+     * Update the string parameters, sounding voices included.
+     */
+    inline void setParams(const StringParams &p) {
+      params_ = p;
+      for (size_t i = 0; i < Voices; ++i) {
+        if (voices_[i].isActive())
+          voices_[i].setParams(params_);
+      }
+    }
+
+    inline const StringParams &getParams() const { return params_; }
+
+    /**
+     * Excitation for the next notes.
+     *
+     * @param sample Sample from the banks (see unit_runtime_desc_t::get_sample), nullptr for noise
+     */
+    inline void setSample(const sample_wrapper_t *sample) { sample_ = sample; }
+
+    inline void NoteOn(uint8_t note, uint8_t velocity) {
+      const size_t i = allocate(note);
+      notes_[i] = note;
+      ages_[i] = ++age_;
+      voices_[i].trigger(noteToHz(note), velocity * (1.f / 127.f), params_, sample_);
+    }
+
+    inline void NoteOff(uint8_t note) {
+      for (size_t i = 0; i < Voices; ++i) {
+        if (notes_[i] == note && voices_[i].isHeld())
+          voices_[i].release();
+      }
+    }
+
+    inline void AllNoteOff() {
+      for (size_t i = 0; i < Voices; ++i) {
+        if (voices_[i].isHeld())
+          voices_[i].release();
+      }
+    }
+
+    /**
+     * @param semitones Pitch offset applied to all voices
+     */
+    inline void PitchBend(float semitones) {
+      bend_ = semitones;
+      for (size_t i = 0; i < Voices; ++i) {
+        if (voices_[i].isActive())
+          voices_[i].setPitch(noteToHz(notes_[i]));
+      }
+    }
+
+    /**
+     * Render all voices.
+     *
+     * @param out Mono output buffer, overwritten
+     * @param frames Number of frames to render
+     */
+    inline void Render(float * __restrict out, size_t frames) {
+      std::memset(out, 0, frames * sizeof(float));
+      for (size_t i = 0; i < Voices; ++i)
+        voices_[i].process(out, frames);
+      for (const float *out_e = out + frames; out != out_e; ++out)
+        *out = dc_.process_fo(*out);
+    }
+
+   private:
+    inline float noteToHz(uint8_t note) const {
+      return 440.f * exp2f(((float)note - 69.f + bend_) * (1.f / 12.f));
+    }
+
+    /**
+     * Same note if sounding, else a free voice, else the oldest released one, else the oldest one.
+     */
+    inline size_t allocate(uint8_t note) const {
+      size_t free_idx = Voices, released = Voices, oldest = 0;
+      for (size_t i = 0; i < Voices; ++i) {
+        if (!voices_[i].isActive()) {
+          if (free_idx == Voices)
+            free_idx = i;
+          continue;
+        }
+        if (notes_[i] == note)
+          return i;
+        if (!voices_[i].isHeld() && (released == Voices || ages_[i] < ages_[released]))
+          released = i;
+        if (ages_[i] < ages_[oldest])
+          oldest = i;
+      }
+      if (free_idx != Voices)
+        return free_idx;
+      return (released != Voices) ? released : oldest;
+    }
+
+    float lines_[Voices][LineSize];
+    StringVoice voices_[Voices];
+    BiQuad dc_;
+    uint8_t notes_[Voices];
+    uint32_t ages_[Voices];
+    StringParams params_;
+    const sample_wrapper_t *sample_;
+    float bend_;
+    uint32_t age_;
+  };
+
+}  // namespace dsp
+
+#endif  // DSP_STRING_VOICE_H_
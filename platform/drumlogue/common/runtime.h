@@ -182,6 +182,17 @@ typedef struct unit_param {
 } unit_param_t;  // 24 bytes
 #pragma pack(pop)
 
+/**
+ * Unit capability flags.
+ * The unit header has no spare fields on this platform, flags are thus exposed via the unit_flags symbol.
+ * Runtimes ignore flags they do not know about.
+ */
+enum {
+  k_unit_flags_none = 0U,
+  /** unit_render() produces correct output when called with in == out. Only meaningful when input and output channel counts match. */
+  k_unit_flag_inplace_render = (1U << 0),
+};
+
 /** @private */
 #pragma pack(push, 1)
 typedef struct unit_header {
@@ -241,6 +252,7 @@ typedef int32_t (*unit_get_param_value_func)(uint8_t);                       //
 typedef const char * (*unit_get_param_str_value_func)(uint8_t, int32_t);     // sym: unit_get_param_str_value
 typedef const uint8_t * (*unit_get_param_bmp_value_func)(uint8_t, int32_t);  // sym: unit_get_param_bmp_value
 typedef void (*unit_set_param_value_func)(uint8_t, int32_t);                 // sym: unit_set_param_value
+typedef void (*unit_set_param_values_func)(const int32_t *, uint32_t);       // sym: unit_set_param_values
 typedef void (*unit_set_tempo_func)(uint32_t);                               // sym: unit_set_tempo
 typedef void (*unit_note_on_func)(uint8_t, uint8_t);                         // sym: unit_note_on
 typedef void (*unit_note_off_func)(uint8_t);                                 // sym: unit_note_off
@@ -0,0 +1,221 @@
+#
+# Worst-case stack usage report for unit callbacks
+#
+# Reads the call graph files emitted by GCC's -fcallgraph-info=su (*.ci), and
+# computes the deepest stack reachable from each unit callback, i.e. each
+# externally visible unit_* function the unit defines. Frame sizes are those of
+# -fstack-usage. With compilers lacking -fcallgraph-info, pass the *.su files
+# instead: only individual frame sizes can then be checked.
+#
+# Usage: awk -v limit=<bytes> -f stack_report.awk build/obj/*.ci > report
+#
+# The full report is written to the standard output, a summary to the
+# standard error. With a non-zero limit, exits with status 1 if a callback
+# may exceed it, or allocates an unbounded amount of stack (VLA, alloca()).
+#
+# Not accounted for, and listed in the report:
+#  - calls to functions defined outside of the unit (firmware API, libc)
+#  - calls through function pointers
+#  - recursion, only the first pass through a cycle is counted
+#
+
+function basename(path) {
+  sub(/^.*\//, "", path)
+  return path
+}
+
+function field(line, key,    rest) {
+  if (!match(line, key ": \"[^\"]*\""))
+    return ""
+  rest = substr(line, RSTART + length(key) + 3, RLENGTH - length(key) - 4)
+  return rest
+}
+
+# Deepest stack from f, memoized in depth[], callee on the worst path in next_on_path[].
+# Functions reaching calls through pointers are marked in indirect[].
+function walk(f,    n, i, callee, d, best, best_callee, list) {
+  if (f in depth)
+    return depth[f]
+  if (f in on_stack) {
+    recursive[f] = 1
+    return 0
+  }
+  if (!(f in frame)) {
+    if (f != "__indirect_call")
+      external[f] = 1
+    return 0
+  }
+  if (qual[f] ~ /dynamic/ && qual[f] !~ /bounded/)
+    unbounded[f] = 1
+
+  on_stack[f] = 1
+  best = 0
+  best_callee = ""
+  n = split(callees[f], list, SUBSEP)
+  for (i = 1; i <= n; ++i) {
+    callee = list[i]
+    if (callee == "")
+      continue
+    d = walk(callee)
+    if (callee == "__indirect_call" || (callee in indirect))
+      indirect[f] = 1
+    if (d > best || best_callee == "") {
+      best = d
+      best_callee = callee
+    }
+  }
+  delete on_stack[f]
+
+  depth[f] = frame[f] + best
+  next_on_path[f] = best_callee
+  return depth[f]
+}
+
+BEGIN {
+  if (limit == "")
+    limit = 0
+  mode = ""
+}
+
+# ---- Call graph files (-fcallgraph-info=su) ---------------------------------
+
+/^node: / {
+  mode = "ci"
+  title = field($0, "title")
+  label = field($0, "label")
+  if (match(label, /\\n[0-9]+ bytes \([a-z,]+\)/)) {
+    size_str = substr(label, RSTART + 2, RLENGTH - 2)
+    split(size_str, parts, " ")
+    q = parts[3]
+    gsub(/[()]/, "", q)
+    # Note: weak fallbacks and their overrides share a name, keep the largest
+    if (!(title in frame) || parts[1] + 0 > frame[title]) {
+      frame[title] = parts[1] + 0
+      qual[title] = q
+      split(label, lines, /\\n/)
+      where[title] = lines[2]
+    }
+  }
+  next
+}
+
+/^edge: / {
+  src = field($0, "sourcename")
+  dst = field($0, "targetname")
+  if (!((src, dst) in has_edge)) {
+    has_edge[src, dst] = 1
+    callees[src] = callees[src] SUBSEP dst
+  }
+  next
+}
+
+# ---- Stack usage files (-fstack-usage), fallback ----------------------------
+
+FILENAME ~ /\.su$/ {
+  mode = "su"
+  n = split($0, cols, "\t")
+  if (n < 3)
+    next
+  su_count++
+  su_name[su_count] = cols[1]
+  su_size[su_count] = cols[2] + 0
+  su_qual[su_count] = cols[3]
+  next
+}
+
+END {
+  failed = 0
+
+  if (mode == "su") {
+    print "Stack frames (call graph not available, per function only)"
+    print "limit: " limit " bytes"
+    print ""
+    for (i = 1; i <= su_count; ++i) {
+      flag = ""
+      if (su_qual[i] ~ /dynamic/ && su_qual[i] !~ /bounded/) {
+        flag = "  UNBOUNDED"
+        failed = limit > 0
+      } else if (limit > 0 && su_size[i] > limit) {
+        flag = "  OVER LIMIT"
+        failed = 1
+      }
+      printf "%8d  %-16s %s%s\n", su_size[i], su_qual[i], basename(su_name[i]), flag
+    }
+    printf("stack: %d frames checked against %d bytes%s\n", su_count, limit, failed ? ", FAILED" : "") > "/dev/stderr"
+    exit failed
+  }
+
+  if (mode == "") {
+    print "No stack usage information found"
+    print "stack: no stack usage information found, not checked" > "/dev/stderr"
+    exit 0
+  }
+
+  # Roots: defined unit callbacks, local functions are prefixed with their file name
+  root_count = 0
+  for (f in frame) {
+    if (f ~ /^unit_/)
+      roots[++root_count] = f
+  }
+  # Note: insertion sort, for a stable report
+  for (i = 2; i <= root_count; ++i) {
+    r = roots[i]
+    for (j = i - 1; j >= 1 && roots[j] > r; --j)
+      roots[j + 1] = roots[j]
+    roots[j + 1] = r
+  }
+
+  print "Worst-case stack usage per callback"
+  print "limit: " limit " bytes"
+
+  worst = 0
+  for (i = 1; i <= root_count; ++i) {
+    current_root = roots[i]
+    d = walk(current_root)
+    worst = d > worst ? d : worst
+
+    status = ""
+    if (limit > 0 && d > limit) {
+      status = "  OVER LIMIT"
+      failed = 1
+    }
+    printf "\n%-32s %8d bytes%s%s\n", current_root, d, (current_root in indirect) ? " + indirect calls" : "", status
+    summary = summary sprintf("  %-32s %8d%s\n", current_root, d, status)
+
+    # Worst path
+    indent = "  "
+    for (f = current_root; f != ""; f = next_on_path[f]) {
+      name = f
+      sub(/^.*:/, "", name)
+      name = indent name
+      if (f in frame)
+        printf "%-40s %8d  %s\n", name, frame[f], basename(where[f])
+      else
+        printf "%-40s %8s  %s\n", name, "?", (f == "__indirect_call") ? "indirect" : "external"
+      indent = indent "  "
+      # Note: stop at recursion
+      if (!(f in next_on_path) || (f in seen_on_path))
+        break
+      seen_on_path[f] = 1
+    }
+    delete seen_on_path
+  }
+
+  notes = ""
+  for (f in unbounded) {
+    notes = notes sprintf("  unbounded dynamic allocation: %s (%s)\n", f, basename(where[f]))
+    failed = failed || limit > 0
+  }
+  for (f in recursive)
+    notes = notes sprintf("  recursion through: %s\n", f)
+  for (f in external)
+    ext_list = ext_list " " f
+  if (ext_list != "")
+    notes = notes "  not defined in unit, not counted:" ext_list "\n"
+  if (notes != "")
+    printf "\nnotes:\n%s", notes
+
+  printf("stack: worst %d bytes over %d callbacks, limit %d bytes%s\n%s", worst, root_count, limit,
+         failed ? ", FAILED" : "", failed ? summary : "") > "/dev/stderr"
+  exit failed
+}
@@ -0,0 +1,27 @@
+##############################################################################
+# Stack usage analysis, included by unit Makefiles
+#
+# Note: call graphs require GCC 10 or later, older toolchains only get
+#       per-frame checks from the .su files. With LTO, files are written next
+#       to the unit by the link step. See stack_report.awk
+#
+
+# Worst-case stack depth allowed for any unit callback in bytes, 0 to disable the check
+STACK_LIMIT ?= 65536
+
+OPT += -fstack-usage
+OPT += $(shell $(CC) -fcallgraph-info=su -E -x c /dev/null >/dev/null 2>&1 && echo -fcallgraph-info=su)
+
+STACK_INFO = $(or $(wildcard $(OBJDIR)/*.ci $(BUILDDIR)/*.ltrans*.ci),$(wildcard $(OBJDIR)/*.su $(BUILDDIR)/*.ltrans*.su),/dev/null)
+
+ifeq ($(VERBOSE_COMPILE),yes)
+  STACK_Q :=
+else
+  STACK_Q := @
+endif
+
+%.stack: %.drmlgunit
+	@echo Creating $@
+	$(STACK_Q)awk -v limit=$(STACK_LIMIT) -f $(COMMON_SRC_PATH)/stack_report.awk $(STACK_INFO) > $@.tmp \
+	  || { cat $@.tmp; rm -f $@.tmp; exit 1; }
+	$(STACK_Q)mv $@.tmp $@
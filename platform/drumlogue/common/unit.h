@@ -19,6 +19,7 @@ extern "C" {
 #endif
 
 extern const unit_header_t unit_header;
+extern const uint32_t unit_flags;
 
 int8_t unit_init(const unit_runtime_desc_t *);
 void unit_teardown();
@@ -33,6 +34,7 @@ int32_t unit_get_param_value(uint8_t);
 const char * unit_get_param_str_value(uint8_t, int32_t);
 const uint8_t * unit_get_param_bmp_value(uint8_t, int32_t);
 void unit_set_param_value(uint8_t, int32_t);
+void unit_set_param_values(const int32_t *, uint32_t);
 void unit_set_tempo(uint32_t);
 void unit_note_on(uint8_t, uint8_t);
 void unit_note_off(uint8_t);
@@ -0,0 +1,151 @@
+/**
+ * @file neon_math.h
+ * @brief NEON reciprocal, reciprocal square root, square root and division
+ *
+ * Copyright (c) 2020-2022 KORG Inc. All rights reserved.
+ *
+ * NEON has no division nor square root instruction, and the VFP VDIV and
+ * VSQRT of the Cortex-A7 are not pipelined and take over ten times as long
+ * as a multiply. These helpers start from the VRECPE/VRSQRTE estimates
+ * instead, and refine them with Newton-Raphson steps (VRECPS/VRSQRTS), the
+ * number of which is selected by the Steps template parameter:
+ *
+ * @code
+ * // Per block: 1.f / bit_res
+ * const float inv_bit_res = neon_rcp<2>(bit_res);
+ *
+ * // Per sample: normalize 4 lanes at once, 1e-5 is plenty for a gain
+ * const float32x4_t gain = neon_rsqrt<1>(vmaxq_f32(power, vdupq_n_f32(1e-12f)));
+ * @endcode
+ *
+ * Maximum relative errors, over all normal inputs, and the cost of each
+ * step (dependent instructions):
+ *
+ *  Steps | rcp, div   | rsqrt, sqrt | Cost
+ *  ------+------------+-------------+-------------------------------
+ *  0     | 2.9e-3     | 3.3e-3      | estimate only (8 bits)
+ *  1     | 8.3e-6     | 1.6e-5      | + 2 (rcp), + 3 (rsqrt)
+ *  2     | 1.5e-7     | 1.5e-7      | + 4 (rcp), + 6 (rsqrt), ~1 ulp
+ *
+ * Note: inputs must be finite, normal and non-zero, and positive for
+ *       rsqrt. Zero yields infinity with 0 steps and NaN otherwise, as does
+ *       infinity. NEON flushes subnormals to zero. neon_sqrt() handles zero.
+ * Note: neon_div(a, b) is a * neon_rcp(b), its error compounds the
+ *       rounding of the multiply.
+ */
+
+#ifndef NEON_MATH_H_
+#define NEON_MATH_H_
+
+#include <arm_neon.h>
+
+#include <cfloat>
+
+#include "attributes.h"
+
+/*===========================================================================*/
+/* Reciprocal */
+/*===========================================================================*/
+
+/** 1 / x, see file description for errors */
+template <int Steps = 1>
+fast_inline float32x4_t neon_rcp(float32x4_t x) {
+  static_assert(Steps >= 0 && Steps <= 2, "0, 1 or 2 Newton-Raphson steps");
+  float32x4_t y = vrecpeq_f32(x);
+  for (int i = 0; i < Steps; ++i)
+    y = vmulq_f32(y, vrecpsq_f32(x, y));  // y * (2 - x * y)
+  return y;
+}
+
+/** 1 / x, see file description for errors */
+template <int Steps = 1>
+fast_inline float32x2_t neon_rcp(float32x2_t x) {
+  static_assert(Steps >= 0 && Steps <= 2, "0, 1 or 2 Newton-Raphson steps");
+  float32x2_t y = vrecpe_f32(x);
+  for (int i = 0; i < Steps; ++i)
+    y = vmul_f32(y, vrecps_f32(x, y));
+  return y;
+}
+
+/** 1 / x, see file description for errors */
+template <int Steps = 1>
+fast_inline float neon_rcp(float x) {
+  return vget_lane_f32(neon_rcp<Steps>(vdup_n_f32(x)), 0);
+}
+
+/*===========================================================================*/
+/* Reciprocal square root */
+/*===========================================================================*/
+
+/** 1 / sqrt(x), for positive x, see file description for errors */
+template <int Steps = 1>
+fast_inline float32x4_t neon_rsqrt(float32x4_t x) {
+  static_assert(Steps >= 0 && Steps <= 2, "0, 1 or 2 Newton-Raphson steps");
+  float32x4_t y = vrsqrteq_f32(x);
+  for (int i = 0; i < Steps; ++i)
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x, y), y));  // y * (3 - x * y * y) / 2
+  return y;
+}
+
+/** 1 / sqrt(x), for positive x, see file description for errors */
+template <int Steps = 1>
+fast_inline float32x2_t neon_rsqrt(float32x2_t x) {
+  static_assert(Steps >= 0 && Steps <= 2, "0, 1 or 2 Newton-Raphson steps");
+  float32x2_t y = vrsqrte_f32(x);
+  for (int i = 0; i < Steps; ++i)
+    y = vmul_f32(y, vrsqrts_f32(vmul_f32(x, y), y));
+  return y;
+}
+
+/** 1 / sqrt(x), for positive x, see file description for errors */
+template <int Steps = 1>
+fast_inline float neon_rsqrt(float x) {
+  return vget_lane_f32(neon_rsqrt<Steps>(vdup_n_f32(x)), 0);
+}
+
+/*===========================================================================*/
+/* Square root */
+/*===========================================================================*/
+
+/** sqrt(x), for x >= 0, as x / sqrt(x), see file description for errors */
+template <int Steps = 1>
+fast_inline float32x4_t neon_sqrt(float32x4_t x) {
+  // Note: clamped so that zero yields 0 * finite rather than 0 * inf
+  return vmulq_f32(x, neon_rsqrt<Steps>(vmaxq_f32(x, vdupq_n_f32(FLT_MIN))));
+}
+
+/** sqrt(x), for x >= 0, as x / sqrt(x), see file description for errors */
+template <int Steps = 1>
+fast_inline float32x2_t neon_sqrt(float32x2_t x) {
+  return vmul_f32(x, neon_rsqrt<Steps>(vmax_f32(x, vdup_n_f32(FLT_MIN))));
+}
+
+/** sqrt(x), for x >= 0, as x / sqrt(x), see file description for errors */
+template <int Steps = 1>
+fast_inline float neon_sqrt(float x) {
+  return vget_lane_f32(neon_sqrt<Steps>(vdup_n_f32(x)), 0);
+}
+
+/*===========================================================================*/
+/* Division */
+/*===========================================================================*/
+
+/** a / b, see file description for errors */
+template <int Steps = 1>
+fast_inline float32x4_t neon_div(float32x4_t a, float32x4_t b) {
+  return vmulq_f32(a, neon_rcp<Steps>(b));
+}
+
+/** a / b, see file description for errors */
+template <int Steps = 1>
+fast_inline float32x2_t neon_div(float32x2_t a, float32x2_t b) {
+  return vmul_f32(a, neon_rcp<Steps>(b));
+}
+
+/** a / b, see file description for errors */
+template <int Steps = 1>
+fast_inline float neon_div(float a, float b) {
+  return a * neon_rcp<Steps>(b);
+}
+
+#endif  // NEON_MATH_H_
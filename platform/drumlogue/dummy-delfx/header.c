@@ -67,3 +67,8 @@ const __unit_header unit_header_t unit_header = {
         {0, 0, 0, 0, k_unit_param_type_none, 0, 0, 0, {""}},
         {0, 0, 0, 0, k_unit_param_type_none, 0, 0, 0, {""}},
         {0, 0, 0, 0, k_unit_param_type_none, 0, 0, 0, {""}}}};
+
+// ---- Unit capability flags  ---------------------------------------------------------------------
+
+// Note: unit_render() of this unit supports in == out, see k_unit_flag_* in runtime.h
+const uint32_t unit_flags = k_unit_flag_inplace_render;
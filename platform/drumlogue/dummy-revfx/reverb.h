@@ -68,8 +68,10 @@ class Reverb {
   /*===========================================================================*/
 
   fast_inline void Process(const float * in, float * out, size_t frames) {
-    const float * __restrict in_p = in;
-    float * __restrict out_p = out;
+    // Note: in and out may point to the same buffer as this unit declares k_unit_flag_inplace_render (see header.c).
+    //       Pointers must thus not be __restrict qualified, and input samples of a frame must be read before writing its output.
+    const float * in_p = in;
+    float * out_p = out;
     const float * out_e = out_p + (frames << 1);  // assuming stereo output
 
     for (; out_p != out_e; in_p += 2, out_p += 2) {
@@ -87,6 +89,15 @@ class Reverb {
     }
   }
 
+  inline void setParameters(const int32_t * values, uint32_t mask) {
+    // Batched update (e.g.: preset restore). Apply all values first, then
+    // recompute state derived from several parameters only once, here.
+    for (; mask; mask &= mask - 1) {
+      const uint8_t index = __builtin_ctz(mask);
+      setParameter(index, values[index]);
+    }
+  }
+
   inline int32_t getParameterValue(uint8_t index) const {
     switch (index) {
       default:
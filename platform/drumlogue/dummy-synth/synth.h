@@ -85,6 +85,15 @@ class Synth {
     }
   }
 
+  inline void setParameters(const int32_t * values, uint32_t mask) {
+    // Batched update (e.g.: preset restore). Apply all values first, then
+    // recompute state derived from several parameters only once, here.
+    for (; mask; mask &= mask - 1) {
+      const uint8_t index = __builtin_ctz(mask);
+      setParameter(index, values[index]);
+    }
+  }
+
   inline int32_t getParameterValue(uint8_t index) const {
     switch (index) {
       default:
@@ -56,6 +56,10 @@ __unit_callback void unit_set_param_value(uint8_t id, int32_t value) {
   s_synth_instance.setParameter(id, value);
 }
 
+__unit_callback void unit_set_param_values(const int32_t * values, uint32_t mask) {
+  s_synth_instance.setParameters(values, mask);
+}
+
 __unit_callback int32_t unit_get_param_value(uint8_t id) {
   return s_synth_instance.getParameterValue(id);
 }
@@ -53,7 +53,7 @@ const __attribute__((weak, section(".unit_header"))) unit_header_t unit_header =
     .unit_id = 0x0,
     .version = 0x0,
     .name = "undefined",
-    .reserved0 = 0x0,
+    .flags = k_unit_flags_none,
     .num_params = 0x0,
     .params = {{0}}};
 
@@ -94,6 +94,15 @@ __attribute__((weak)) void unit_set_param_value(uint8_t id, int32_t value) {
   (void)value;
 }
 
+__attribute__((weak)) void unit_set_param_values(const int32_t * values, uint32_t mask) {
+  // Fallback for units without a batched implementation: apply parameters one by one
+  while (mask) {
+    const uint8_t id = __builtin_ctz(mask);
+    unit_set_param_value(id, values[id]);
+    mask &= mask - 1;
+  }
+}
+
 __attribute__((weak)) void unit_set_tempo(uint32_t tempo) { (void)tempo; }
 
 __attribute__((weak)) void unit_tempo_4ppqn_tick(uint32_t counter) { (void)counter; }
@@ -50,4 +50,23 @@
 #define __unit_callback __attribute__((used))
 #define __unit_header __attribute__((used, section(".unit_header")))
 
+/** L1 data cache line size of the target core (Cortex-M7) */
+#ifndef UNIT_CACHE_LINE_SIZE
+#define UNIT_CACHE_LINE_SIZE 32
+#endif
+
+/** Align a structure or variable on a cache line boundary */
+#define cache_aligned __attribute__((aligned(UNIT_CACHE_LINE_SIZE)))
+
+/** Mark a structure holding render state accessed for every frame, keep configuration and cross-thread flags elsewhere */
+#define hot_state cache_aligned
+
+/** Check at compile time that a hot state structure fits within the given number of cache lines */
+#define HOT_STATE_CHECK(type, lines)                                    \
+  static_assert(sizeof(type) <= (lines) * UNIT_CACHE_LINE_SIZE,         \
+                #type " does not fit in " #lines " cache line(s)")
+
+#include "profile.h"
+#include "fp_check.h"
+
 #endif // ATTRIBUTES_H_
@@ -0,0 +1,341 @@
+#pragma once
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018-2023, KORG INC.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "utils/float_math.h"
+#include "utils/buffer_ops.h"
+#include "dsp/biquad.hpp"
+#include "dsp/blocksize.hpp"
+
+/**
+ * @file    crossover.hpp
+ * @brief   Linkwitz-Riley multiband crossover.
+ *
+ * @addtogroup dsp DSP
+ * @{
+ */
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /**
+   * Linkwitz-Riley 4th order (LR4) crossover tree splitting interleaved stereo
+   * into 2 to 5 bands, whose sum has a flat magnitude response.
+   *
+   * Each crossover is a pair of LR4 low and high pass filters, i.e.: two
+   * cascaded Butterworth sections each. Bands below a crossover go through
+   * the matching second order allpass, so that all bands stay phase aligned.
+   * For N bands this amounts to 4 (N - 1) + (N - 1) (N - 2) / 2 sections.
+   *
+   * Coefficients and state of all sections are stored as structures of
+   * arrays, and each section is run over the whole block with both channels
+   * processed together, keeping coefficients and state in registers.
+   *
+   * @code
+   * dsp::Crossover<> xo;
+   * xo.init(48000.f);
+   * xo.setBands(3);
+   * xo.setFrequency(0, 200.f);
+   * xo.setFrequency(1, 2000.f);
+   *
+   * // unit_render()
+   * xo.process(in, out, frames, [](float * band, uint32_t index, uint32_t frames) {
+   *   // per band processing, in place on interleaved stereo
+   * });
+   * @endcode
+   *
+   * @tparam MaxFrames Size of the band buffers in frames, larger blocks are processed in chunks.
+   */
+  template <size_t MaxFrames = k_native_frames>
+  struct Crossover {
+
+    /*===========================================================================*/
+    /* Types and Data Structures.                                                */
+    /*===========================================================================*/
+
+    enum {
+      k_max_bands = 5,
+      k_max_sections = 4 * (k_max_bands - 1) + (k_max_bands - 1) * (k_max_bands - 2) / 2,
+    };
+
+    /*===========================================================================*/
+    /* Constructor / Destructor.                                                 */
+    /*===========================================================================*/
+
+    /**
+     * Default constructor
+     */
+    Crossover(void) :
+      mFsRecip(1.f / 48000.f),
+      mBands(2)
+    {
+      for (uint32_t i = 0; i < k_max_bands - 1; ++i)
+        mFreq[i] = 100.f * (1U << (3 * i));  // 100Hz, 800Hz, 6.4kHz...
+      updateAll();
+      flush();
+    }
+
+    /*===========================================================================*/
+    /* Public Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * @param samplerate Sampling frequency in Hz
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void init(const float samplerate) {
+      mFsRecip = 1.f / samplerate;
+      updateAll();
+      flush();
+    }
+
+    /**
+     * Clear filter state.
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void flush(void) {
+      buf_clr_f32(mZ1, k_max_sections * 2);
+      buf_clr_f32(mZ2, k_max_sections * 2);
+    }
+
+    /**
+     * @param bands Number of bands in [2, k_max_bands]
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setBands(const uint32_t bands) {
+      const uint32_t n = (bands < 2) ? 2 : (bands > k_max_bands) ? (uint32_t)k_max_bands : bands;
+      if (n != mBands) {
+        mBands = n;
+        flush();
+      }
+    }
+
+    inline __attribute__((always_inline))
+    uint32_t getBands(void) const {
+      return mBands;
+    }
+
+    /**
+     * Set a crossover frequency, crossovers must be in ascending order.
+     *
+     * @param index Crossover index, between band index and band index + 1
+     * @param hz Crossover frequency in Hz
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setFrequency(const uint32_t index, const float hz) {
+      if (index >= k_max_bands - 1)
+        return;
+      mFreq[index] = hz;
+      update(index);
+    }
+
+    /**
+     * @param index Band index
+     * @return Interleaved stereo buffer of the band, filled by split()
+     */
+    inline __attribute__((always_inline))
+    float * band(const uint32_t index) {
+      return mBand[index];
+    }
+
+    /**
+     * Split a block into the band buffers.
+     *
+     * @param in Interleaved stereo input
+     * @param frames Number of frames, at most MaxFrames
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void split(const float * in, const uint32_t frames) {
+      const uint32_t last = mBands - 1;
+      const float * rest = in;
+      for (uint32_t c = 0; c < last; ++c) {
+        const uint32_t s = section(c);
+        // High part first, into the next band, then the low part in place
+        runSection(s + 2, rest, mBand[c + 1], frames);
+        runSection(s + 3, mBand[c + 1], mBand[c + 1], frames);
+        runSection(s, rest, mBand[c], frames);
+        runSection(s + 1, mBand[c], mBand[c], frames);
+        // Phase alignment of lower bands
+        for (uint32_t j = 0; j < c; ++j)
+          runSection(s + 4 + j, mBand[j], mBand[j], frames);
+        rest = mBand[c + 1];
+      }
+    }
+
+    /**
+     * Sum the band buffers back.
+     *
+     * @param out Interleaved stereo output
+     * @param frames Number of frames, at most MaxFrames
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void sum(float * out, const uint32_t frames) {
+      const uint32_t len = frames * 2;
+      buf_cpy_f32(mBand[0], out, len);
+      for (uint32_t b = 1; b < mBands; ++b) {
+        const float * src = mBand[b];
+        float * dst = out;
+        const float * end = dst + ((len>>2)<<2);
+        for (; dst != end; ) {
+          REP4(*(dst++) += *(src++));
+        }
+        end += len & 0x3;
+        for (; dst != end; ) {
+          *(dst++) += *(src++);
+        }
+      }
+    }
+
+    /**
+     * Split, process each band and sum back, in chunks of at most MaxFrames.
+     *
+     * @param in Interleaved stereo input
+     * @param out Interleaved stereo output, may be in
+     * @param frames Number of frames
+     * @param kernel Callable with signature void(float * band, uint32_t index, uint32_t frames),
+     *               processing a band buffer in place
+     */
+    template <typename Kernel>
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void process(const float * in, float * out, uint32_t frames, Kernel &&kernel) {
+      while (frames) {
+        const uint32_t n = (frames < MaxFrames) ? frames : (uint32_t)MaxFrames;
+        split(in, n);
+        for (uint32_t b = 0; b < mBands; ++b)
+          kernel(mBand[b], b, n);
+        sum(out, n);
+        in += n * 2;
+        out += n * 2;
+        frames -= n;
+      }
+    }
+
+  private:
+
+    /*===========================================================================*/
+    /* Private Methods.                                                          */
+    /*===========================================================================*/
+
+    /**
+     * First section of crossover c: low pass x2, high pass x2, then one allpass per lower band.
+     */
+    static inline __attribute__((always_inline))
+    uint32_t section(const uint32_t c) {
+      return 4 * c + c * (c - 1) / 2;
+    }
+
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setSection(const uint32_t s, const BiQuad::Coeffs &c) {
+      mFF0[s] = c.ff0;
+      mFF1[s] = c.ff1;
+      mFF2[s] = c.ff2;
+      mFB1[s] = c.fb1;
+      mFB2[s] = c.fb2;
+    }
+
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void update(const uint32_t c) {
+      const float q = 0.70710678f;  // Butterworth sections
+      const float fc = clipminmaxf(10.f, mFreq[c], 0.45f / mFsRecip);
+      const float k = tanf(3.14159265f * fc * mFsRecip);
+      BiQuad::Coeffs lp, hp, ap;
+      lp.setSOLP(k, q);
+      hp.setSOHP(k, q);
+      ap.setSOAP1(k, q);
+      const uint32_t s = section(c);
+      setSection(s, lp);
+      setSection(s + 1, lp);
+      setSection(s + 2, hp);
+      setSection(s + 3, hp);
+      for (uint32_t j = 0; j < c; ++j)
+        setSection(s + 4 + j, ap);
+    }
+
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void updateAll(void) {
+      for (uint32_t c = 0; c < k_max_bands - 1; ++c)
+        update(c);
+    }
+
+    /**
+     * Run a second order section over interleaved stereo, src may be dst.
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void runSection(const uint32_t s, const float * src, float * dst, const uint32_t frames) {
+      const float ff0 = mFF0[s], ff1 = mFF1[s], ff2 = mFF2[s];
+      const float fb1 = mFB1[s], fb2 = mFB2[s];
+      float z1l = mZ1[2 * s], z1r = mZ1[2 * s + 1];
+      float z2l = mZ2[2 * s], z2r = mZ2[2 * s + 1];
+      for (const float * src_e = src + 2 * frames; src != src_e; src += 2, dst += 2) {
+        // Transposed form 2, both channels interleaved for the FPU pipeline
+        const float xl = src[0];
+        const float xr = src[1];
+        const float yl = ff0 * xl + z1l;
+        const float yr = ff0 * xr + z1r;
+        z1l = ff1 * xl - fb1 * yl + z2l;
+        z1r = ff1 * xr - fb1 * yr + z2r;
+        z2l = ff2 * xl - fb2 * yl;
+        z2r = ff2 * xr - fb2 * yr;
+        dst[0] = yl;
+        dst[1] = yr;
+      }
+      mZ1[2 * s] = z1l;
+      mZ1[2 * s + 1] = z1r;
+      mZ2[2 * s] = z2l;
+      mZ2[2 * s + 1] = z2r;
+    }
+
+    /*===========================================================================*/
+    /* Member Variables.                                                         */
+    /*===========================================================================*/
+
+    float mBand[k_max_bands][MaxFrames * 2];
+    float mFF0[k_max_sections];
+    float mFF1[k_max_sections];
+    float mFF2[k_max_sections];
+    float mFB1[k_max_sections];
+    float mFB2[k_max_sections];
+    float mZ1[k_max_sections * 2];
+    float mZ2[k_max_sections * 2];
+    float mFreq[k_max_bands - 1];
+    float mFsRecip;
+    uint32_t mBands;
+  };
+}
+
+/** @} */
@@ -0,0 +1,461 @@
+#pragma once
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018-2023, KORG INC.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//*/
+
+/**
+ * @file    fm4op.hpp
+ * @brief   4 operator FM voice with integer phases.
+ *
+ * Operators use uint32_t phase accumulators that wrap for free, and read
+ * the half period sine table of the runtime (wt_sine_lut_f) with a single
+ * interpolated lookup per operator and per sample. Connections are set by a
+ * modulation matrix, usually from one of the 8 classic algorithms, and
+ * operator envelopes are evaluated once per block, levels ramping linearly
+ * across the block.
+ *
+ * Same engine as dsp/fm4op.h of the drumlogue SDK.
+ *
+ * @code
+ * dsp::Fm4OpVoice fm_;
+ *
+ * // Init()
+ * fm_.init(48000.f);
+ * fm_.setAlgorithm(dsp::k_fm_algorithms[0]);
+ *
+ * // NoteOn()
+ * fm_.noteOn(velo * (1.f / 127.f));
+ *
+ * // Process()
+ * fm_.setPitch(osc_w0f_for_note((ctxt->pitch)>>8, ctxt->pitch & 0xFF));
+ * buf_clr_f32(out, frames);
+ * fm_.process(out, frames);
+ * @endcode
+ *
+ * @addtogroup dsp DSP
+ * @{
+ *
+ */
+
+#include "osc_api.h"
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /**
+   * Operator connections of an algorithm. Operators are numbered 0 to 3,
+   * and can only be modulated by operators with a higher number, operator 3
+   * has self feedback.
+   */
+  typedef struct FmAlgorithm {
+    uint8_t mods[4];   /**< Bit j of mods[i] set if operator j modulates operator i */
+    uint8_t carriers;  /**< Bit i set if operator i is heard */
+  } FmAlgorithm;
+
+  /**
+   * The 8 classic 4 operator algorithms, operator 0 being operator 1 of the
+   * usual charts.
+   */
+  static const FmAlgorithm k_fm_algorithms[8] = {
+    { { 0x2, 0x4, 0x8, 0x0 }, 0x1 },  // 3 > 2 > 1 > 0
+    { { 0x2, 0xC, 0x0, 0x0 }, 0x1 },  // (2 + 3) > 1 > 0
+    { { 0xA, 0x4, 0x0, 0x0 }, 0x1 },  // (2 > 1 + 3) > 0
+    { { 0x6, 0x0, 0x8, 0x0 }, 0x1 },  // (3 > 2 + 1) > 0
+    { { 0x2, 0x0, 0x8, 0x0 }, 0x5 },  // 1 > 0, 3 > 2
+    { { 0x8, 0x8, 0x8, 0x0 }, 0x7 },  // 3 > (0, 1, 2)
+    { { 0x0, 0x0, 0x8, 0x0 }, 0x7 },  // 3 > 2, 1, 0
+    { { 0x0, 0x0, 0x0, 0x0 }, 0xF },  // 3, 2, 1, 0
+  };
+
+  /**
+   * Operator parameters.
+   */
+  typedef struct FmOperatorParams {
+    float ratio;    /**< Frequency ratio to the voice pitch */
+    float level;    /**< Output level of a carrier, modulation index in cycles of a modulator, up to 16 */
+    float attack;   /**< Attack time in seconds, linear */
+    float decay;    /**< Time to -60dB towards sustain in seconds */
+    float sustain;  /**< Sustain level in [0, 1] */
+    float release;  /**< Time to -60dB after note off in seconds */
+
+    FmOperatorParams(void) :
+      ratio(1.f),
+      level(1.f),
+      attack(0.002f),
+      decay(0.5f),
+      sustain(0.5f),
+      release(0.2f)
+    { }
+  } FmOperatorParams;
+
+  /**
+   * Operator envelope, evaluated once per block.
+   */
+  struct FmEnvelope {
+
+    enum {
+      k_idle = 0,
+      k_attack,
+      k_decay,
+      k_release,
+    };
+
+    FmEnvelope(void) : mLevel(0), mStage(k_idle) { }
+
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void gateOn(void) {
+      mStage = k_attack;
+    }
+
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void gateOff(void) {
+      if (mStage != k_idle)
+        mStage = k_release;
+    }
+
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void reset(void) {
+      mLevel = 0;
+      mStage = k_idle;
+    }
+
+    /**
+     * Advance by dt seconds.
+     *
+     * @return Level at the end of the block
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    float process(const FmOperatorParams &p, const float dt) {
+      switch (mStage) {
+        case k_attack:
+          mLevel += (p.attack > dt) ? dt / p.attack : 1.f;
+          if (mLevel >= 1.f) {
+            mLevel = 1.f;
+            mStage = k_decay;
+          }
+          break;
+        case k_decay:
+          mLevel = p.sustain + (mLevel - p.sustain) * expf(-6.9077553f * dt / (p.decay + 1e-4f));
+          break;
+        case k_release:
+          mLevel *= expf(-6.9077553f * dt / (p.release + 1e-4f));
+          if (mLevel < 1e-4f) {
+            mLevel = 0;
+            mStage = k_idle;
+          }
+          break;
+        default:
+          break;
+      }
+      return mLevel;
+    }
+
+    float   mLevel;
+    uint8_t mStage;
+  };
+
+  /**
+   * 4 operator FM voice.
+   */
+  struct Fm4OpVoice {
+
+    /*===========================================================================*/
+    /* Constructor / Destructor.                                                 */
+    /*===========================================================================*/
+
+    Fm4OpVoice(void) :
+      mFsRecip(1.f / 48000.f),
+      mW0(0),
+      mFeedback(0),
+      mFbZ0(0),
+      mFbZ1(0),
+      mGain(1.f),
+      mUsed(0),
+      mCarriers(0),
+      mActive(false)
+    {
+      for (int i = 0; i < 4; ++i) {
+        mPhase[i] = mInc[i] = 0;
+        mLevel[i] = 0;
+      }
+      setAlgorithm(k_fm_algorithms[0]);
+    }
+
+    /*===========================================================================*/
+    /* Public Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * @param samplerate Sampling frequency in Hz
+     */
+    inline void init(const float samplerate) {
+      mFsRecip = 1.f / samplerate;
+      reset();
+    }
+
+    /**
+     * Silence the voice.
+     */
+    inline void reset(void) {
+      for (int i = 0; i < 4; ++i) {
+        mEnv[i].reset();
+        mPhase[i] = 0;
+        mLevel[i] = 0;
+      }
+      mFbZ0 = mFbZ1 = 0;
+      mActive = false;
+    }
+
+    /**
+     * Set connections from an algorithm, with unity modulation depths.
+     */
+    inline void setAlgorithm(const FmAlgorithm &algo) {
+      for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j)
+          mMatrix[i][j] = (j > i && (algo.mods[i] & (1U << j))) ? 1.f : 0.f;
+      }
+      mCarriers = algo.carriers & 0xF;
+      const int count = __builtin_popcount(mCarriers);
+      const float mix = (count > 1) ? 1.f / count : 1.f;
+      for (int i = 0; i < 4; ++i)
+        mMix[i] = (mCarriers & (1U << i)) ? mix : 0.f;
+      updateUsed();
+    }
+
+    /**
+     * Set a single entry of the modulation matrix, for connections or depths beyond the algorithm presets.
+     *
+     * @param dst Modulated operator
+     * @param src Modulating operator, must be greater than dst
+     * @param depth Modulation depth, scales the modulator level
+     */
+    inline void setModulation(const uint8_t dst, const uint8_t src, const float depth) {
+      if (src > 3 || dst >= src)
+        return;
+      mMatrix[dst][src] = depth;
+      updateUsed();
+    }
+
+    /**
+     * @param amount Self feedback of operator 3 in cycles, 0 for none
+     */
+    inline void setFeedback(const float amount) {
+      mFeedback = 0.5f * amount;
+    }
+
+    inline void setOperator(const uint8_t i, const FmOperatorParams &p) {
+      if (i > 3)
+        return;
+      mOps[i] = p;
+      updateIncrement(i);
+    }
+
+    inline const FmOperatorParams &getOperator(const uint8_t i) const {
+      return mOps[i & 3];
+    }
+
+    /**
+     * @param w0 Voice frequency normalized to the sampling frequency, i.e.: hz / samplerate
+     */
+    inline void setPitch(const float w0) {
+      mW0 = w0;
+      for (uint8_t i = 0; i < 4; ++i)
+        updateIncrement(i);
+    }
+
+    /**
+     * @param velocity Output gain in [0, 1]
+     */
+    inline void noteOn(const float velocity) {
+      // Note: phases restart only if silent, avoids clicks on legato retriggers
+      if (!mActive) {
+        for (int i = 0; i < 4; ++i)
+          mPhase[i] = 0;
+        mFbZ0 = mFbZ1 = 0;
+      }
+      mGain = velocity;
+      for (int i = 0; i < 4; ++i)
+        mEnv[i].gateOn();
+      mActive = true;
+    }
+
+    inline void noteOff(void) {
+      for (int i = 0; i < 4; ++i)
+        mEnv[i].gateOff();
+    }
+
+    inline bool isActive(void) const { return mActive; }
+
+    /**
+     * Render a block, mixed into the output. Envelopes are evaluated at the
+     * end of the block, and operator levels ramp linearly across it.
+     *
+     * @param out Mono output buffer, the voice output is added to its content
+     * @param frames Number of frames to render
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void process(float * __restrict out, const size_t frames) {
+      if (!mActive || !frames)
+        return;
+
+      const float dt = frames * mFsRecip;
+      const float frames_recip = 1.f / frames;
+
+      float l[4], dl[4];
+      uint32_t active = 0;
+      bool sounding = false;
+      for (int i = 0; i < 4; ++i) {
+        const float target = mEnv[i].process(mOps[i], dt) * mOps[i].level;
+        l[i] = mLevel[i];
+        dl[i] = (target - l[i]) * frames_recip;
+        mLevel[i] = target;
+        // Note: silent or unused operators are not evaluated, saves their table lookups
+        if ((mUsed & (1U << i)) && (l[i] != 0.f || target != 0.f))
+          active |= 1U << i;
+        // Note: carriers held at a zero sustain level count as silent once below -100dB
+        if ((mCarriers & (1U << i))
+            && (mEnv[i].mStage == FmEnvelope::k_attack || l[i] > 1e-5f || target > 1e-5f))
+          sounding = true;
+      }
+
+      const float m01 = mMatrix[0][1], m02 = mMatrix[0][2], m03 = mMatrix[0][3];
+      const float m12 = mMatrix[1][2], m13 = mMatrix[1][3];
+      const float m23 = mMatrix[2][3];
+      const float mix0 = mMix[0] * mGain, mix1 = mMix[1] * mGain;
+      const float mix2 = mMix[2] * mGain, mix3 = mMix[3] * mGain;
+      const float fb = mFeedback;
+      uint32_t p0 = mPhase[0], p1 = mPhase[1], p2 = mPhase[2], p3 = mPhase[3];
+      const uint32_t i0 = mInc[0], i1 = mInc[1], i2 = mInc[2], i3 = mInc[3];
+      float z0 = mFbZ0, z1 = mFbZ1;
+
+      for (const float *out_e = out + frames; out != out_e; ++out) {
+        float o0 = 0, o1 = 0, o2 = 0, o3 = 0;
+        if (active & 0x8) {
+          o3 = l[3] * sinu(p3 + cycles_to_u32(fb * (z0 + z1)));
+          z1 = z0;
+          z0 = o3;
+        }
+        if (active & 0x4)
+          o2 = l[2] * sinu(p2 + cycles_to_u32(m23 * o3));
+        if (active & 0x2)
+          o1 = l[1] * sinu(p1 + cycles_to_u32(m12 * o2 + m13 * o3));
+        if (active & 0x1)
+          o0 = l[0] * sinu(p0 + cycles_to_u32(m01 * o1 + m02 * o2 + m03 * o3));
+        *out += mix0 * o0 + mix1 * o1 + mix2 * o2 + mix3 * o3;
+
+        p0 += i0; p1 += i1; p2 += i2; p3 += i3;
+        l[0] += dl[0]; l[1] += dl[1]; l[2] += dl[2]; l[3] += dl[3];
+      }
+
+      mPhase[0] = p0; mPhase[1] = p1; mPhase[2] = p2; mPhase[3] = p3;
+      mFbZ0 = z0;
+      mFbZ1 = z1;
+      if (!sounding)
+        reset();
+    }
+
+    /*===========================================================================*/
+    /* Static Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * sin(2 pi x / 2^32), x being a phase over the full uint32_t range.
+     */
+    static inline __attribute__((optimize("Ofast"),always_inline))
+    float sinu(const uint32_t x) {
+      // Note: half period stored, upper bit selects the sign
+      const uint32_t i = (x >> 24) & 0x7F;
+      const float f = (x & 0xFFFFFF) * 5.96046448e-8f;
+      const float y0 = wt_sine_lut_f[i];
+      const float y = y0 + f * (wt_sine_lut_f[i + 1] - y0);
+      return (x & 0x80000000U) ? -y : y;
+    }
+
+    /**
+     * Phase offset in cycles to a uint32_t phase increment. Offsets are clamped
+     * to [-127, 127], beyond which the conversion to int32_t would overflow.
+     */
+    static inline __attribute__((optimize("Ofast"),always_inline))
+    uint32_t cycles_to_u32(const float c) {
+      const float x = (c > 127.f) ? 127.f : (c < -127.f) ? -127.f : c;
+      return ((uint32_t)(int32_t)(x * 16777216.f)) << 8;
+    }
+
+   private:
+
+    /*===========================================================================*/
+    /* Private Methods.                                                          */
+    /*===========================================================================*/
+
+    inline void updateIncrement(const uint8_t i) {
+      float w = mW0 * mOps[i].ratio;
+      w = (w < 0.f) ? 0.f : (w > 0.499f) ? 0.499f : w;
+      mInc[i] = (uint32_t)(w * 4294967296.f);
+    }
+
+    inline void updateUsed(void) {
+      mUsed = mCarriers;
+      for (int i = 0; i < 4; ++i) {
+        for (int j = i + 1; j < 4; ++j) {
+          if (mMatrix[i][j] != 0.f)
+            mUsed |= 1U << j;
+        }
+      }
+    }
+
+    /*===========================================================================*/
+    /* Member Variables.                                                         */
+    /*===========================================================================*/
+
+    FmOperatorParams mOps[4];
+    FmEnvelope mEnv[4];
+    float    mMatrix[4][4];
+    float    mMix[4];
+    float    mLevel[4];
+    uint32_t mPhase[4];
+    uint32_t mInc[4];
+    float    mFsRecip;
+    float    mW0;
+    float    mFeedback;
+    float    mFbZ0;
+    float    mFbZ1;
+    float    mGain;
+    uint32_t mUsed;
+    uint32_t mCarriers;
+    bool     mActive;
+  };
+
+}
+
+/** @} */
@@ -0,0 +1,323 @@
+#pragma once
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018-2023, KORG INC.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//*/
+
+#include <stdint.h>
+
+#include "utils/float_math.h"
+#include "utils/buffer_ops.h"
+
+/**
+ * @file    stepmod.hpp
+ * @brief   Step modulator locked to 4PPQN clock ticks.
+ *
+ * @addtogroup dsp DSP
+ * @{
+ */
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /**
+   * Step sequencer for modulation, locked to the tempo and 4PPQN clock ticks
+   * of the runtime, e.g.: for rhythmic filter or level patterns in effects.
+   *
+   * Step boundaries are placed at sample positions predicted from the tempo,
+   * and ticks correct the prediction (drift, clock jitter, transport jumps).
+   * Between boundaries, the output is a constant fill or a linear ramp while
+   * slewing towards the new step value, there is no per sample step logic.
+   *
+   * @code
+   * __unit_callback void unit_set_tempo(uint32_t tempo) { s_steps.setTempo(tempo); }
+   * __unit_callback void unit_tempo_4ppqn_tick(uint32_t counter) { s_steps.tick(counter); }
+   *
+   * // unit_render()
+   * s_steps.process(s_mod, frames);
+   * @endcode
+   *
+   * Note: ticks are notified between render calls, so they are only used to
+   *       correct the prediction when it is off by more than a block.
+   *       The corrected boundary then lands on the first frame of the next
+   *       block.
+   */
+  struct StepModulator {
+
+    /*===========================================================================*/
+    /* Types and Data Structures.                                                */
+    /*===========================================================================*/
+
+    enum {
+      k_max_steps = 16,
+    };
+
+    /*===========================================================================*/
+    /* Constructor / Destructor.                                                 */
+    /*===========================================================================*/
+
+    /**
+     * Default constructor
+     */
+    StepModulator(void) :
+      mFs(48000.f),
+      mTickSamples(6000.f),
+      mStepSamples(6000.f),
+      mToBoundary(6000.f),
+      mSlew(0.f),
+      mValue(0.f),
+      mInc(0.f),
+      mTarget(0.f),
+      mSlewLeft(0),
+      mBlockFrames(64),
+      mTicksPerStep(1),
+      mLength(k_max_steps),
+      mStep(0),
+      mPending(-1)
+    {
+      buf_clr_f32(mValues, k_max_steps);
+    }
+
+    /*===========================================================================*/
+    /* Public Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * @param samplerate Sampling frequency in Hz
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void init(const float samplerate) {
+      mFs = samplerate;
+      setTempo(120U << 16);
+      reset();
+    }
+
+    /**
+     * Restart from the first step.
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void reset(void) {
+      mPending = 0;
+      mToBoundary = mStepSamples;
+    }
+
+    /**
+     * @param tempo Tempo as passed to unit_set_tempo(), BPM in 16.16 fixed point
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setTempo(const uint32_t tempo) {
+      if (tempo == 0)
+        return;
+      // 4 ticks per beat: fs * 60 / (bpm * 4)
+      const float tick_samples = mFs * 15.f * 65536.f / (float)tempo;
+      // Note: keep the position within the current step
+      mToBoundary *= tick_samples / mTickSamples;
+      mTickSamples = tick_samples;
+      mStepSamples = tick_samples * mTicksPerStep;
+    }
+
+    /**
+     * @param counter Tick counter as passed to unit_tempo_4ppqn_tick()
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void tick(const uint32_t counter) {
+      const uint32_t pos = counter % mTicksPerStep;
+      const uint32_t step = (counter / mTicksPerStep) % mLength;
+      const float to_boundary = (mTicksPerStep - pos) * mTickSamples;
+      // Note: ticks are only known to the block, keep the sample accurate prediction while it agrees
+      const float tolerance = (float)(mBlockFrames + 1);
+      const uint32_t next = (mStep + 1 < mLength) ? mStep + 1 : 0;
+      if (step == mStep && si_fabsf(mToBoundary - to_boundary) < tolerance)
+        return;
+      if (step == next && pos == 0 && mPending < 0 && mToBoundary < tolerance)
+        return;
+      // Drift or transport jump, resynchronize at the next block
+      if (step != mStep)
+        mPending = step;
+      mToBoundary = to_boundary;
+    }
+
+    /**
+     * @param ticks Step length in ticks, 1 for 16th notes
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setTicksPerStep(const uint32_t ticks) {
+      const uint32_t t = (ticks) ? ticks : 1;
+      mToBoundary *= (float)t / mTicksPerStep;
+      mTicksPerStep = t;
+      mStepSamples = mTickSamples * t;
+    }
+
+    /**
+     * @param length Number of steps in the pattern, in [1, k_max_steps]
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setLength(const uint32_t length) {
+      mLength = (length < 1) ? 1 : (length > k_max_steps) ? (uint32_t)k_max_steps : length;
+    }
+
+    /**
+     * @param step Step index
+     * @param value Modulation value of the step
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setStep(const uint32_t step, const float value) {
+      if (step < k_max_steps)
+        mValues[step] = value;
+    }
+
+    /**
+     * @param slew Transition time as a fraction of the step length in [0, 1], 0 for hard steps
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setSlew(const float slew) {
+      mSlew = clip01f(slew);
+    }
+
+    /**
+     * @return Current modulation value
+     */
+    inline __attribute__((always_inline))
+    float value(void) const {
+      return mValue;
+    }
+
+    /**
+     * @return Current step index
+     */
+    inline __attribute__((always_inline))
+    uint32_t step(void) const {
+      return mStep;
+    }
+
+    /**
+     * Render a block of modulation values.
+     *
+     * @param out Output buffer, one value per frame
+     * @param frames Number of frames
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void process(float * __restrict__ out, const uint32_t frames) {
+      if (mPending >= 0) {
+        startStep(mPending);
+        mPending = -1;
+      }
+
+      mBlockFrames = frames;
+      uint32_t left = frames;
+      while (left) {
+        if (mToBoundary <= 0.f) {
+          // Note: fractional remainder carried over, so boundaries do not drift
+          mToBoundary += mStepSamples;
+          startStep((mStep + 1 < mLength) ? mStep + 1 : 0);
+        }
+
+        // Frames before the next boundary, i.e.: ceil(mToBoundary)
+        uint32_t n = (uint32_t)mToBoundary;
+        n += ((float)n < mToBoundary) ? 1 : 0;
+        n = (n < left) ? n : left;
+        mToBoundary -= n;
+        left -= n;
+
+        uint32_t ramp = (n < mSlewLeft) ? n : mSlewLeft;
+        if (ramp) {
+          mSlewLeft -= ramp;
+          n -= ramp;
+          float v = mValue;
+          const float inc = mInc;
+          for (const float *out_e = out + ramp; out != out_e; ) {
+            v += inc;
+            *(out++) = v;
+          }
+          mValue = (mSlewLeft) ? v : mTarget;
+        }
+        fill(out, mValue, n);
+        out += n;
+      }
+    }
+
+  private:
+
+    /*===========================================================================*/
+    /* Private Methods.                                                          */
+    /*===========================================================================*/
+
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void startStep(const uint32_t step) {
+      mStep = step;
+      mTarget = mValues[step];
+      const uint32_t slew_len = (uint32_t)(mSlew * mStepSamples);
+      if (slew_len) {
+        mInc = (mTarget - mValue) / slew_len;
+        mSlewLeft = slew_len;
+      } else {
+        mValue = mTarget;
+        mSlewLeft = 0;
+      }
+    }
+
+    static inline __attribute__((optimize("Ofast"),always_inline))
+    void fill(float * __restrict__ ptr, const float v, const uint32_t len) {
+      const float *end = ptr + ((len>>2)<<2);
+      for (; ptr != end; ) {
+        REP4(*(ptr++) = v);
+      }
+      end += len & 0x3;
+      for (; ptr != end; ) {
+        *(ptr++) = v;
+      }
+    }
+
+    /*===========================================================================*/
+    /* Member Variables.                                                         */
+    /*===========================================================================*/
+
+    float    mValues[k_max_steps];
+    float    mFs;
+    float    mTickSamples;
+    float    mStepSamples;
+    float    mToBoundary;
+    float    mSlew;
+    float    mValue;
+    float    mInc;
+    float    mTarget;
+    uint32_t mSlewLeft;
+    uint32_t mBlockFrames;
+    uint32_t mTicksPerStep;
+    uint32_t mLength;
+    uint32_t mStep;
+    int32_t  mPending;
+  };
+}
+
+/** @} */
@@ -0,0 +1,216 @@
+#pragma once
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018-2023, KORG INC.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//*/
+
+/**
+ * @file    wavefolder.hpp
+ * @brief   Antialiased wavefolder.
+ *
+ * Triangle wavefolder with first order antiderivative antialiasing (ADAA):
+ * instead of folding each sample, the output is the average of the folding
+ * function between consecutive inputs, computed from its antiderivative,
+ * which strongly attenuates aliasing without oversampling.
+ *
+ * Both the folding function and its antiderivative are periodic and
+ * evaluated in closed form, so the cost per sample is the same whatever the
+ * fold depth.
+ *
+ * @addtogroup dsp DSP
+ * @{
+ *
+ */
+
+#include "utils/float_math.h"
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /**
+   * Triangle wavefolder with first order ADAA.
+   */
+  struct WaveFolder {
+
+    /*===========================================================================*/
+    /* Constructor / Destructor.                                                 */
+    /*===========================================================================*/
+
+    /**
+     * Default constructor
+     */
+    WaveFolder(void) :
+      mGain(1.f),
+      mBias(0.f),
+      mGainTarget(1.f),
+      mBiasTarget(0.f),
+      mX1(0.f),
+      mF1(antiderivative(0.f))
+    { }
+
+    /*===========================================================================*/
+    /* Public Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * Reset filter state.
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void flush(void) {
+      mX1 = 0.f;
+      mF1 = antiderivative(0.f);
+      mGain = mGainTarget;
+      mBias = mBiasTarget;
+    }
+
+    /**
+     * Set fold amount, reached by a linear ramp over the next processed block.
+     *
+     * @param fold Fold amount in [0, 1], input gain from 1 to 8, i.e.: up to 4 folds on each side
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setFold(const float fold) {
+      mGainTarget = 1.f + 7.f * clip01f(fold);
+    }
+
+    /**
+     * Set symmetry, reached by a linear ramp over the next processed block.
+     *
+     * @param sym Offset added to the input before folding in [-1, 1], 0 for symmetric folding
+     *
+     * @note Asymmetric folding adds DC.
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void setSymmetry(const float sym) {
+      mBiasTarget = clip1m1f(sym);
+    }
+
+    /**
+     * Fold a single sample, at the current fold amount and symmetry.
+     *
+     * @param x Input sample
+     * @return Output sample in [-1, 1]
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    float process(const float x) {
+      return fold(x * mGain + mBias);
+    }
+
+    /**
+     * Fold a block, ramping fold amount and symmetry to their targets.
+     *
+     * @param in Input samples
+     * @param out Output samples, may be in
+     * @param frames Number of samples
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void process(const float * in, float * out, const uint32_t frames) {
+      if (!frames)
+        return;
+      const float frames_recip = 1.f / frames;
+      const float gain_inc = (mGainTarget - mGain) * frames_recip;
+      const float bias_inc = (mBiasTarget - mBias) * frames_recip;
+      float gain = mGain;
+      float bias = mBias;
+      for (const float * in_e = in + frames; in != in_e; ++in, ++out) {
+        gain += gain_inc;
+        bias += bias_inc;
+        *out = fold(*in * gain + bias);
+      }
+      mGain = mGainTarget;
+      mBias = mBiasTarget;
+    }
+
+    /*===========================================================================*/
+    /* Static Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * Position within the fold period, in [-2, 2), for |x| < 15.
+     */
+    static inline __attribute__((optimize("Ofast"),always_inline))
+    float wrap(const float x) {
+      // Note: offset by a multiple of the period so that truncation floors
+      const float u = x + 17.f;
+      return u - 4.f * (float)(uint32_t)(u * 0.25f) - 2.f;
+    }
+
+    /**
+     * Triangle folding function, identity in [-1, 1] and period 4.
+     */
+    static inline __attribute__((optimize("Ofast"),always_inline))
+    float folder(const float x) {
+      return 1.f - si_fabsf(wrap(x));
+    }
+
+    /**
+     * Antiderivative of folder(), also of period 4.
+     */
+    static inline __attribute__((optimize("Ofast"),always_inline))
+    float antiderivative(const float x) {
+      const float v = wrap(x);
+      return v - 0.5f * v * si_fabsf(v);
+    }
+
+  private:
+
+    /*===========================================================================*/
+    /* Private Methods.                                                          */
+    /*===========================================================================*/
+
+    inline __attribute__((optimize("Ofast"),always_inline))
+    float fold(float x) {
+      x = clipminmaxf(-15.f, x, 15.f);
+      const float f = antiderivative(x);
+      const float dx = x - mX1;
+      // Note: fall back to the midpoint when the difference quotient is ill-conditioned
+      const float y = (si_fabsf(dx) > 1e-3f) ? (f - mF1) / dx : folder(0.5f * (x + mX1));
+      mX1 = x;
+      mF1 = f;
+      return y;
+    }
+
+    /*===========================================================================*/
+    /* Member Variables.                                                         */
+    /*===========================================================================*/
+
+    float mGain;
+    float mBias;
+    float mGainTarget;
+    float mBiasTarget;
+    float mX1;
+    float mF1;
+  };
+}
+
+/** @} */
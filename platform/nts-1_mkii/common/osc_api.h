@@ -657,6 +657,65 @@ extern "C" {
     return x - c * (x*x*x);
   }
 
+  /**
+   * Saturation through a table of size + 1 points over [0, 1], odd symmetric.
+   *
+   * @private
+   */
+  static fast_inline float osc_sat_lutf(const float * __restrict__ lut, const float size, const float x) {
+    // Note: clamping |x| * size just below size keeps lut[xi + 1] in the table for any x
+    const float xf = clipmaxf(si_fabsf(x) * size, size - 1e-4f);
+    const uint32_t xi = (uint32_t)xf;
+    return si_copysignf(linintf(xf - xi, lut[xi], lut[xi + 1]), x);
+  }
+
+  /** @private */
+  static fast_inline void osc_sat_lutf_loop(const float * __restrict__ lut, const float size,
+                                            const float * x, const float * drive, const float * bias,
+                                            float * y, const uint32_t len) {
+    const float * end = y + (len & ~3U);
+    for (; y != end; x += 4, y += 4) {
+      // Note: all loads first, lets the compiler interleave table lookups
+      float v0 = x[0], v1 = x[1], v2 = x[2], v3 = x[3];
+      if (drive) {
+        v0 *= drive[0]; v1 *= drive[1]; v2 *= drive[2]; v3 *= drive[3];
+        drive += 4;
+      }
+      if (bias) {
+        v0 += bias[0]; v1 += bias[1]; v2 += bias[2]; v3 += bias[3];
+        bias += 4;
+      }
+      y[0] = osc_sat_lutf(lut, size, v0);
+      y[1] = osc_sat_lutf(lut, size, v1);
+      y[2] = osc_sat_lutf(lut, size, v2);
+      y[3] = osc_sat_lutf(lut, size, v3);
+    }
+    end += len & 3U;
+    for (; y != end; ++x, ++y) {
+      float v = *x;
+      if (drive)
+        v *= *(drive++);
+      if (bias)
+        v += *(bias++);
+      *y = osc_sat_lutf(lut, size, v);
+    }
+  }
+
+  /** @private */
+  static fast_inline void osc_sat_lutf_buf(const float * __restrict__ lut, const float size,
+                                           const float * x, const float * drive, const float * bias,
+                                           float * y, const uint32_t len) {
+    // Note: one loop per combination, keeps pointer checks out of the loop
+    if (drive && bias)
+      osc_sat_lutf_loop(lut, size, x, drive, bias, y, len);
+    else if (drive)
+      osc_sat_lutf_loop(lut, size, x, drive, 0, y, len);
+    else if (bias)
+      osc_sat_lutf_loop(lut, size, x, 0, bias, y, len);
+    else
+      osc_sat_lutf_loop(lut, size, x, 0, 0, y, len);
+  }
+
 #define k_cubicsat_size_exp  (7)
 #define k_cubicsat_size      (1U<<k_cubicsat_size_exp)
 #define k_cubicsat_mask      (k_cubicsat_size-1)
@@ -667,15 +726,11 @@ extern "C" {
   /**
    * Cubic saturation.
    *
-   * @param   x  Value in [-1.0, 1.0].
+   * @param   x  Value in [-1.0, 1.0], clipped beyond.
    * @return     Cubic curve above 0.42264973081, gain: 1.2383127573
    */
   static fast_inline float osc_sat_cubicf(float x) {
-    const float xf = si_fabsf(clip1f(x)) * k_cubicsat_size;
-    const uint32_t xi = (uint32_t)x;
-    const float y0 = cubicsat_lut_f[xi];
-    const float y1 = cubicsat_lut_f[xi+1];
-    return si_copysignf(linintf(xf - xi, y0, y1), x);
+    return osc_sat_lutf(cubicsat_lut_f, k_cubicsat_size, x);
   }
 
 #define k_schetzen_size_exp  (7)
@@ -688,15 +743,41 @@ extern "C" {
   /**
    * Schetzen saturation.
    *
-   * @param   x  Value in [-1.0, 1.0].
+   * @param   x  Value in [-1.0, 1.0], clipped beyond.
    * @return     Saturated value.
    */
   static fast_inline float osc_sat_schetzenf(float x) {
-    const float xf = si_fabsf(clip1f(x)) * k_schetzen_size;
-    const uint32_t xi = (uint32_t)x;
-    const float y0 = schetzen_lut_f[xi];
-    const float y1 = schetzen_lut_f[xi+1];
-    return si_copysignf(linintf(xf - xi, y0, y1), x);
+    return osc_sat_lutf(schetzen_lut_f, k_schetzen_size, x);
+  }
+
+  /**
+   * Cubic saturation of a buffer, see osc_sat_cubicf().
+   *
+   * Computes y[i] = osc_sat_cubicf(x[i] * drive[i] + bias[i]).
+   *
+   * @param   x      Input samples.
+   * @param   drive  Gain applied to each input sample, e.g.: a ramp smoothing drive changes. NULL for unity gain.
+   * @param   bias   Offset added to each sample after drive, for asymmetric saturation. NULL for none.
+   * @param   y      Output samples, may be x.
+   * @param   len    Number of samples.
+   */
+  static fast_inline void osc_sat_cubicf_buf(const float * x, const float * drive, const float * bias, float * y, const uint32_t len) {
+    osc_sat_lutf_buf(cubicsat_lut_f, k_cubicsat_size, x, drive, bias, y, len);
+  }
+
+  /**
+   * Schetzen saturation of a buffer, see osc_sat_schetzenf().
+   *
+   * Computes y[i] = osc_sat_schetzenf(x[i] * drive[i] + bias[i]).
+   *
+   * @param   x      Input samples.
+   * @param   drive  Gain applied to each input sample, e.g.: a ramp smoothing drive changes. NULL for unity gain.
+   * @param   bias   Offset added to each sample after drive, for asymmetric saturation. NULL for none.
+   * @param   y      Output samples, may be x.
+   * @param   len    Number of samples.
+   */
+  static fast_inline void osc_sat_schetzenf_buf(const float * x, const float * drive, const float * bias, float * y, const uint32_t len) {
+    osc_sat_lutf_buf(schetzen_lut_f, k_schetzen_size, x, drive, bias, y, len);
   }
 
   /** @} */
@@ -62,6 +62,7 @@ void unit_render(const float *, float *, uint32_t);
 int32_t unit_get_param_value(uint8_t);
 const char * unit_get_param_str_value(uint8_t, int32_t);
 void unit_set_param_value(uint8_t, int32_t);
+void unit_set_param_values(const int32_t *, uint32_t);
 void unit_set_tempo(uint32_t);
 void unit_tempo_4ppqn_tick(uint32_t);
 void unit_note_on(uint8_t, uint8_t);
@@ -776,6 +776,61 @@ float fastertanh2f(float x) {
 
 /** @} */
 
+/*===========================================================================*/
+/* Reciprocal Approximations.                                                */
+/*===========================================================================*/
+
+/**
+ * @name    Reciprocal approximations
+ * @note    Integer bit tricks plus Newton-Raphson steps, for FPUs where VDIV and VSQRT take 14 cycles (Cortex-M4/M7).
+ *          Maximum relative errors are given over all normal inputs in the stated ranges. Each extra step,
+ *          y *= 2.f - x * y for reciprocals, y *= 1.5f - 0.5f * x * y * y for reciprocal square roots, brings the error
+ *          down to ~1e-5.
+ * @{
+ */
+
+/** "Fast" reciprocal approximation, for normal x with |x| < 2^125, one Newton-Raphson step
+ * @note Maximum relative error 2.6e-3. Beyond, results go subnormal, then NaN or infinite above ~1.6e38.
+ */
+static inline __attribute__((optimize("Ofast"), always_inline))
+float fastrcpf(float x) {
+  union { float f; uint32_t i; } v = { x };
+  v.i = 0x7EF311C3 - v.i;  // Note: keeps the sign bit
+  return v.f * (2.f - x * v.f);
+}
+
+/** "Faster" reciprocal approximation, for normal x with |x| < 2^125, bit trick only
+ * @note Maximum relative error 5.1e-2. Beyond, results go subnormal, then NaN or infinite above ~1.6e38.
+ */
+static inline __attribute__((optimize("Ofast"), always_inline))
+float fasterrcpf(float x) {
+  union { float f; uint32_t i; } v = { x };
+  v.i = 0x7EF311C3 - v.i;
+  return v.f;
+}
+
+/** "Fast" reciprocal square root approximation, for finite positive x, one Newton-Raphson step
+ * @note Maximum relative error 1.8e-3
+ */
+static inline __attribute__((optimize("Ofast"), always_inline))
+float fastrsqrtf(float x) {
+  union { float f; uint32_t i; } v = { x };
+  v.i = 0x5F3759DF - (v.i >> 1);
+  return v.f * (1.5f - 0.5f * x * v.f * v.f);
+}
+
+/** "Faster" reciprocal square root approximation, for finite positive x, bit trick only
+ * @note Maximum relative error 3.4e-2
+ */
+static inline __attribute__((optimize("Ofast"), always_inline))
+float fasterrsqrtf(float x) {
+  union { float f; uint32_t i; } v = { x };
+  v.i = 0x5F3759DF - (v.i >> 1);
+  return v.f;
+}
+
+/** @} */
+
 /*===========================================================================*/
 /* Useful Conversions.                                                       */
 /*===========================================================================*/
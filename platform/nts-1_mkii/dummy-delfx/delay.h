@@ -166,8 +166,10 @@ class Delay {
   /*===========================================================================*/
 
   fast_inline void Process(const float * in, float * out, size_t frames) {
-    const float * __restrict in_p = in;
-    float * __restrict out_p = out;
+    // Note: in and out may point to the same buffer as this unit declares k_unit_flag_inplace_render (see header.c).
+    //       Pointers must thus not be __restrict qualified, and input samples of a frame must be read before writing its output.
+    const float * in_p = in;
+    float * out_p = out;
     const float * out_e = out_p + (frames << 1);  // assuming stereo output
 
     // Caching current parameter values. Consider interpolating sensitive parameters.
@@ -175,10 +177,12 @@ class Delay {
     
     for (; out_p != out_e; in_p += 2, out_p += 2) {
       // Process samples here
+      const float in_l = in_p[0];
+      const float in_r = in_p[1];
       
       // Note: this is a dummy unit only to demonstrate APIs, only passing through audio
-      out_p[0] = in_p[0]; // left sample
-      out_p[1] = in_p[1]; // right sample
+      out_p[0] = in_l; // left sample
+      out_p[1] = in_r; // right sample
     }
   }
 
@@ -213,6 +217,15 @@ class Delay {
     }
   }
 
+  inline void setParameters(const int32_t * values, uint32_t mask) {
+    // Batched update (e.g.: preset restore). Apply all values first, then
+    // recompute state derived from several parameters only once, here.
+    for (; mask; mask &= mask - 1) {
+      const uint8_t index = __builtin_ctz(mask);
+      setParameter(index, values[index]);
+    }
+  }
+
   inline int32_t getParameterValue(uint8_t index) const {
     switch (index) {
     case TIME:
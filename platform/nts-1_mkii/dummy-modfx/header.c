@@ -50,6 +50,7 @@ const __unit_header unit_header_t unit_header = {
     .unit_id = 0x0U,                                       // ID for this unit. Scoped within the context of a given dev_id.
     .version = 0x00010000U,                                // This unit's version: major.minor.patch (major<<16 minor<<8 patch).
     .name = "dummy",                                       // Name for this unit, will be displayed on device
+    .flags = k_unit_flag_inplace_render,                   // Capability flags, see k_unit_flag_* in runtime.h
     .num_params = 3,                                       // Number of valid parameter descriptors. (max. 10)
     
     .params = {
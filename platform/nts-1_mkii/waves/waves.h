@@ -49,6 +49,7 @@
 #include "waves_common.h"
 
 #include "dsp/biquad.hpp"
+#include "dsp/blocksize.hpp"
 
 class Waves {
 public:
@@ -91,6 +92,49 @@ public:
     }
   };
   
+  /**
+   * Render state accessed for every sample, kept within two cache lines and apart from
+   * configuration and flags written from other threads.
+   */
+  struct hot_state HotState {
+    const float *wave_a;        // selected wave a data
+    const float *wave_b;        // selected wave b data
+    const float *sub_wave;      // selected sub wave data
+    float        phi_a;         // wave a phase
+    float        phi_b;         // wave b phase
+    float        phi_sub;       // sub wave phase
+    float        w0_a;          // wave a phase increment
+    float        w0_b;          // wave b phase increment
+    float        w0_sub;        // sub wave phase increment
+    float        lfoz;          // current interpolated lfo value
+    float        dither;        // dithering amount before bit reduction
+    float        bit_res;       // bit depth scaling factor
+    float        bit_res_recip; // bit depth scaling reciprocal, returns signal to 0.-1.f after scaling/rounding
+
+    HotState(void) :
+      wave_a(wavesA[0]),
+      wave_b(wavesD[0]),
+      sub_wave(wavesA[0]),
+      w0_a(440.f * k_samplerate_recipf),
+      w0_b(440.f * k_samplerate_recipf),
+      w0_sub(220.f * k_samplerate_recipf),
+      lfoz(0.f),
+      dither(0.f),
+      bit_res(1.f),
+      bit_res_recip(1.f)
+    {
+      Reset();
+    }
+
+    inline void Reset(void) {
+      phi_a = 0;
+      phi_b = 0;
+      phi_sub = 0;
+    }
+  };
+
+  HOT_STATE_CHECK(HotState, 2);
+
   struct State {
 
     enum {
@@ -103,47 +147,16 @@ public:
       k_flag_reset    = 1<<6
     };
     
-    const float              *wave_a;        // selected wave a data
-    const float              *wave_b;        // selected wave b data
-    const float              *sub_wave;      // selected sub wave data
-    float                     phi_a;         // wave a phase
-    float                     phi_b;         // wave b phase
-    float                     phi_sub;       // sub wave phase
-    float                     w0_a;          // wave a phase increment
-    float                     w0_b;          // wave b phase increment
-    float                     w0_sub;        // sub wave phase increment
     float                     lfo;           // target lfo value
-    float                     lfoz;          // current interpolated lfo value
-    float                     dither;        // dithering amount before bit reduction
-    float                     bit_res;       // bit depth scaling factor
-    float                     bit_res_recip; // bit depth scaling reciprocal, returns signal to 0.-1.f after scaling/rounding
     float                     imperfection;  // tuning imperfection
     std::atomic_uint_fast32_t flags;         // flags passed to audio processing thread
     
     State(void) :
-      wave_a(wavesA[0]),
-      wave_b(wavesD[0]),
-      sub_wave(wavesA[0]),
-      w0_a(440.f * k_samplerate_recipf),
-      w0_b(440.f * k_samplerate_recipf),
-      w0_sub(220.f * k_samplerate_recipf),
       lfo(0.f),
-      lfoz(0.f),
-      dither(0.f),
-      bit_res(1.f),
-      bit_res_recip(1.f),
       flags{k_flags_none}
     {
-      Reset();
       imperfection = osc_white() * 1.0417e-006f; // +/- 0.05Hz@48KHz
     }
-    
-    inline void Reset(void) {
-      phi_a = 0;
-      phi_b = 0;
-      phi_sub = 0;
-      lfo = lfoz;
-    }
   };
 
 
@@ -183,6 +196,14 @@ public:
     
     // Make sure parameters are reset to default values
     params_.reset();
+
+    // Note: no-op unless built with UNIT_PROFILE, see profile.h
+    PROFILE_INIT();
+
+    // Note: no-op unless built with UNIT_FPCHECK, see fp_check.h
+    FPCHECK_RESET();
+    FPCHECK_REGISTER(prelpf_z, &prelpf_.mZ1, 2);
+    FPCHECK_REGISTER(postlpf_z, &postlpf_.mZ1, 2);
     
     return k_unit_err_none;
   }
@@ -193,13 +214,13 @@ public:
   
   inline void Reset() {
     // Note: Reset effect state, excluding exposed parameter values.
-    state_.Reset();
+    resetState();
   }
 
   inline void Resume() {
     // Unit will resume and exit suspend state.
     // Unit was selected and the render callback will start being called again
-    state_.Reset();
+    resetState();
   }
 
   inline void Suspend() {
@@ -212,144 +233,117 @@ public:
   /*===========================================================================*/
 
   fast_inline void Process(const float * in, float * out, size_t frames) {
+    // Use the variant specialized for the platform's block size whenever possible
+    if (dsp::is_native_block(frames))
+      ProcessBlock<dsp::k_native_frames>(in, out, frames);
+    else
+      ProcessBlock<0>(in, out, frames);
+  }
+
+  template <size_t N>
+  fast_inline void ProcessBlock(const float * in, float * out, size_t frames) {
     (void)in; // Note: not using input
+
+    // Note: for N > 0 frames is known at compile time, see dsp::BlockSize
+    typedef dsp::BlockSize<N> block_t;
     
+    HotState &h = hot_;
     State &s = state_;
     const Waves::Params &p = params_;
     const unit_runtime_osc_context_t *ctxt = static_cast<const unit_runtime_osc_context_t *>(runtime_desc_.hooks.runtime_context);
     
     // Handle events.
     {      
+      PROFILE_SCOPE(events);
+
       updatePitch(osc_w0f_for_note((ctxt->pitch)>>8, ctxt->pitch & 0xFF));
 
       const uint32_t flags = s.flags.exchange(State::k_flags_none, std::memory_order_relaxed);
       updateWaves(flags);
       
       if (flags & State::k_flag_reset)
-        s.Reset();
+        resetState();
       
       s.lfo = q31_to_f32(ctxt->shape_lfo);
       
       if (flags & State::k_flag_bit_crush) {
-        s.dither = p.bit_crush * 2e-008f;
-        s.bit_res = osc_bitresf(p.bit_crush);
-        s.bit_res_recip = 1.f / s.bit_res;
+        h.dither = p.bit_crush * 2e-008f;
+        h.bit_res = osc_bitresf(p.bit_crush);
+        h.bit_res_recip = 1.f / h.bit_res;
       }
     }
     
+    PROFILE_SCOPE(samples);
+
     // Temporaries.
-    float phi_a = s.phi_a;
-    float phi_b = s.phi_b;
-    float phi_sub = s.phi_sub;
+    float phi_a = h.phi_a;
+    float phi_b = h.phi_b;
+    float phi_sub = h.phi_sub;
     
-    float lfoz = s.lfoz;
-    const float lfo_inc = (s.lfo - lfoz) / frames;
+    float lfoz = h.lfoz;
+    const float lfo_inc = (s.lfo - lfoz) * block_t::recip(frames);
     
     const float ditheramt = p.bit_crush * 2e-008f;
         
     const float sub_mix = p.sub_mix * 0.5011872336272722f;
     const float ring_mix = p.ring_mix;
+    const float shape = p.shape;
     
     float * __restrict y = out;
-    const float * y_e = y + frames;
+    const size_t n = block_t::frames(frames);
   
-    for (; y != y_e; ) {
-      const float wave_mix = clip01f(p.shape+lfoz);
+    for (size_t i = 0; i < n; ++i) {
+      const float wave_mix = clip01f(shape+lfoz);
       
-      float sig = (1.f - wave_mix) * osc_wave_scanf(s.wave_a, phi_a);
-      sig += wave_mix * osc_wave_scanf(s.wave_b, phi_b);
+      float sig = (1.f - wave_mix) * osc_wave_scanf(h.wave_a, phi_a);
+      sig += wave_mix * osc_wave_scanf(h.wave_b, phi_b);
     
-      const float sub_sig = osc_wave_scanf(s.sub_wave, phi_sub);
+      const float sub_sig = osc_wave_scanf(h.sub_wave, phi_sub);
       sig = (1.f - ring_mix) * sig + ring_mix * 1.4125375446227544f * (sub_sig * sig);
       sig += sub_mix * sub_sig;
       sig *= 1.4125375446227544f;
       sig = clip1m1f(fastertanh2f(sig));
     
       sig = prelpf_.process_fo(sig);
-      sig += s.dither * osc_white();
-      sig = si_roundf(sig * s.bit_res) * s.bit_res_recip;
+      sig += h.dither * osc_white();
+      sig = si_roundf(sig * h.bit_res) * h.bit_res_recip;
       sig = postlpf_.process_fo(sig);
       
-      *(y++) = sig;
+      y[i] = sig;
     
-      phi_a += s.w0_a;
+      phi_a += h.w0_a;
       phi_a -= (uint32_t)phi_a;
-      phi_b += s.w0_b;
+      phi_b += h.w0_b;
       phi_b -= (uint32_t)phi_b;
-      phi_sub += s.w0_sub;
+      phi_sub += h.w0_sub;
       phi_sub -= (uint32_t)phi_sub;
       lfoz += lfo_inc;
     }
 
     // Update state
-    s.phi_a = phi_a;
-    s.phi_b = phi_b;
-    s.phi_sub = phi_sub;
-    s.lfoz = lfoz;
+    h.phi_a = phi_a;
+    h.phi_b = phi_b;
+    h.phi_sub = phi_sub;
+    h.lfoz = lfoz;
+
+    FPCHECK_BLOCK(out, n);
   }
 
   inline void setParameter(uint8_t index, int32_t value) {
-    Params &p = params_;
-    State &s = state_;
-    
-    switch (index) {
-    case Params::k_shape:
-      //  min, max,  center, default, type,                   frac, frac. mode, <reserved>, name
-      // {0,   1023, 0,      0,       k_unit_param_type_none, 0,    0,          0,          {"SHAPE"}},
-      p.shape = 0.005f + param_10bit_to_f32(value) * 0.99f;
-      break;
-
-    case Params::k_sub_mix:
-      //  min, max,  center, default, type,                   frac, frac. mode, <reserved>, name
-      // {0,   1023, 0,      0,       k_unit_param_type_none, 0,    0,          0,          {"SUB"}},
-      p.sub_mix = 0.05f + param_10bit_to_f32(value) * 0.90f;
-      break;
-            
-    case Params::k_wave_a: {
-      //  min, max,          center, default, type,                   frac, frac. mode, <reserved>, name
-      // {0,   WAVE_A_CNT-1, 0,      0,       k_unit_param_type_enum, 0,    0,          0,          {"WAVE A"}},
-      p.wave_a = value % WAVE_A_CNT;
-      s.flags.fetch_or(State::k_flag_wave_a);
-    }
-    break;
-    
-    case Params::k_wave_b: {
-      //  min, max,          center, default, type,                   frac, frac. mode, <reserved>, name
-      // {0,   WAVE_B_CNT-1, 0,      0,       k_unit_param_type_enum, 0,    0,          0,          {"WAVE B"}},
-      p.wave_b = value % WAVE_B_CNT;
-      s.flags.fetch_or(State::k_flag_wave_b);
-    }
-    break;
-    
-    case Params::k_sub_wave:
-      //  min, max,            center, default, type,                   frac, frac. mode, <reserved>, name
-      // {0,   SUB_WAVE_CNT-1, 0,      0,       k_unit_param_type_enum, 0,    0,          0,          {"SUB WAVE"}},
-      p.sub_wave = value % SUB_WAVE_CNT;
-      s.flags.fetch_or(State::k_flag_sub_wave);
-      break;
-        
-    case Params::k_ring_mix:
-      //  min, max,  center, default, type,                      frac, frac. mode, <reserved>, name
-      // {0,   1000,  0,      0,       k_unit_param_type_percent, 1,    1,          0,          {"RING MIX"}},
-      p.ring_mix = clip01f(value * 0.001f);
-      break;
-    
-    case Params::k_bit_crush:
-      //  min, max,  center, default, type,                      frac, frac. mode, <reserved>, name
-      // {0,   1000,  0,      0,       k_unit_param_type_percent, 1,    1,          0,          {"BIT CRUSH"}},
-      p.bit_crush = clip01f(value * 0.001f);
-      s.flags.fetch_or(State::k_flag_bit_crush);
-      break;
+    const uint32_t flags = applyParameter(index, value);
+    if (flags)
+      state_.flags.fetch_or(flags);
+  }
 
-    case Params::k_drift:
-      //  min, max,  center, default, type,                      frac, frac. mode, <reserved>, name
-      // {0,   1000,  0,      250,     k_unit_param_type_percent, 1,    1,          0,          {"DRIFT"}},
-      p.drift = 1.f + value * 0.001f;
-      break;
-      
-    default:
-      break;
+  inline void setParameters(const int32_t * values, uint32_t mask) {
+    // Apply the whole batch first so that the audio thread recomputes derived state only once
+    uint32_t flags = State::k_flags_none;
+    for (; mask; mask &= mask - 1) {
+      const uint8_t index = __builtin_ctz(mask);
+      flags |= applyParameter(index, values[index]);
     }
+    if (flags)
+      state_.flags.fetch_or(flags);
   }
 
   inline int32_t getParameterValue(uint8_t index) const {
@@ -359,7 +353,7 @@ public:
     case Params::k_shape:
       //  min, max,  center, default, type,                   frac, frac. mode, <reserved>, name
       // {0,   1023, 0,      0,       k_unit_param_type_none, 0,    0,          0,          {"SHAPE"}},
-      return param_f32_to_10bit((p.shape - 0.05) / 0.99f);
+      return param_f32_to_10bit((p.shape - 0.005f) / 0.99f);
 
     case Params::k_sub_mix:
       //  min, max,  center, default, type,                   frac, frac. mode, <reserved>, name
@@ -457,23 +451,97 @@ public:
   /* Private Member Variables. */
   /*===========================================================================*/
   
+  // Note: per sample state first, configuration after
+  HotState    hot_;
+  dsp::BiQuad prelpf_, postlpf_;
   State       state_;
   Params      params_;
-  dsp::BiQuad prelpf_, postlpf_;
   unit_runtime_desc_t runtime_desc_;
   
   /*===========================================================================*/
   /* Private Methods. */
   /*===========================================================================*/
 
+  fast_inline void resetState(void) {
+    hot_.Reset();
+    state_.lfo = hot_.lfoz;
+  }
+
+  // Updates parameter storage and returns the state flags to raise for the audio thread
+  fast_inline uint32_t applyParameter(uint8_t index, int32_t value) {
+    Params &p = params_;
+    uint32_t flags = State::k_flags_none;
+    
+    switch (index) {
+    case Params::k_shape:
+      //  min, max,  center, default, type,                   frac, frac. mode, <reserved>, name
+      // {0,   1023, 0,      0,       k_unit_param_type_none, 0,    0,          0,          {"SHAPE"}},
+      p.shape = 0.005f + param_10bit_to_f32(value) * 0.99f;
+      break;
+
+    case Params::k_sub_mix:
+      //  min, max,  center, default, type,                   frac, frac. mode, <reserved>, name
+      // {0,   1023, 0,      0,       k_unit_param_type_none, 0,    0,          0,          {"SUB"}},
+      p.sub_mix = 0.05f + param_10bit_to_f32(value) * 0.90f;
+      break;
+            
+    case Params::k_wave_a: {
+      //  min, max,          center, default, type,                   frac, frac. mode, <reserved>, name
+      // {0,   WAVE_A_CNT-1, 0,      0,       k_unit_param_type_enum, 0,    0,          0,          {"WAVE A"}},
+      p.wave_a = value % WAVE_A_CNT;
+      flags |= State::k_flag_wave_a;
+    }
+    break;
+    
+    case Params::k_wave_b: {
+      //  min, max,          center, default, type,                   frac, frac. mode, <reserved>, name
+      // {0,   WAVE_B_CNT-1, 0,      0,       k_unit_param_type_enum, 0,    0,          0,          {"WAVE B"}},
+      p.wave_b = value % WAVE_B_CNT;
+      flags |= State::k_flag_wave_b;
+    }
+    break;
+    
+    case Params::k_sub_wave:
+      //  min, max,            center, default, type,                   frac, frac. mode, <reserved>, name
+      // {0,   SUB_WAVE_CNT-1, 0,      0,       k_unit_param_type_enum, 0,    0,          0,          {"SUB WAVE"}},
+      p.sub_wave = value % SUB_WAVE_CNT;
+      flags |= State::k_flag_sub_wave;
+      break;
+        
+    case Params::k_ring_mix:
+      //  min, max,  center, default, type,                      frac, frac. mode, <reserved>, name
+      // {0,   1000,  0,      0,       k_unit_param_type_percent, 1,    1,          0,          {"RING MIX"}},
+      p.ring_mix = clip01f(value * 0.001f);
+      break;
+    
+    case Params::k_bit_crush:
+      //  min, max,  center, default, type,                      frac, frac. mode, <reserved>, name
+      // {0,   1000,  0,      0,       k_unit_param_type_percent, 1,    1,          0,          {"BIT CRUSH"}},
+      p.bit_crush = clip01f(value * 0.001f);
+      flags |= State::k_flag_bit_crush;
+      break;
+
+    case Params::k_drift:
+      //  min, max,  center, default, type,                      frac, frac. mode, <reserved>, name
+      // {0,   1000,  0,      250,     k_unit_param_type_percent, 1,    1,          0,          {"DRIFT"}},
+      p.drift = 1.f + value * 0.001f;
+      break;
+      
+    default:
+      break;
+    }
+
+    return flags;
+  }
+
   fast_inline void updatePitch(float w0) {
     w0 += state_.imperfection;
     const float drift = params_.drift;
-    state_.w0_a = w0;
+    hot_.w0_a = w0;
     // Alt. osc with slight phase drift (0.25Hz@48KHz)
-    state_.w0_b = w0 + drift * 5.20833333333333e-006f;
+    hot_.w0_b = w0 + drift * 5.20833333333333e-006f;
     // Sub one octave down, with a phase drift (0.15Hz@48KHz)
-    state_.w0_sub = 0.5f * w0 + drift * 3.125e-006f;
+    hot_.w0_sub = 0.5f * w0 + drift * 3.125e-006f;
   }
     
   fast_inline void updateWaves(const uint32_t flags) {
@@ -496,7 +564,7 @@ public:
         table = wavesC;
         idx -= k_b_thr;
       }
-      state_.wave_a = table[idx];
+      hot_.wave_a = table[idx];
     }
     if (flags & State::k_flag_wave_b) {
       static const uint8_t k_d_thr = k_waves_d_cnt;
@@ -518,11 +586,11 @@ public:
         idx -= k_e_thr;
       }
       
-      state_.wave_b = table[idx];
+      hot_.wave_b = table[idx];
     }
     if (flags & State::k_flag_sub_wave) {
       const uint8_t idx = params_.sub_wave;
-      state_.sub_wave = wavesA[params_.sub_wave];
+      hot_.sub_wave = wavesA[params_.sub_wave];
     }
   }
   
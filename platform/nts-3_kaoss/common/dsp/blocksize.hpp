@@ -0,0 +1,123 @@
+#pragma once
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018-2023, KORG INC.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//*/
+
+#include <stddef.h>
+
+/**
+ * @file    blocksize.hpp
+ * @brief   Compile-time block size specialization helpers.
+ *
+ * @addtogroup dsp DSP
+ * @{
+ */
+
+/**
+ * Block size processing loops are specialized for. Runtimes normally call unit_render() with
+ * unit_runtime_desc_t::frames_per_buffer frames, which is fixed for a given platform. Can be
+ * overridden from a project's config.mk, e.g.: UDEFS = -DDSP_NATIVE_FRAMES_PER_BUFFER=32
+ */
+#ifndef DSP_NATIVE_FRAMES_PER_BUFFER
+#define DSP_NATIVE_FRAMES_PER_BUFFER 64
+#endif
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /** Native block size, see DSP_NATIVE_FRAMES_PER_BUFFER. */
+  constexpr size_t k_native_frames = DSP_NATIVE_FRAMES_PER_BUFFER;
+
+  /**
+   * Block size descriptor for processing methods templated on frame count.
+   *
+   * Processing code obtains its loop count and per-block reciprocal through this descriptor,
+   * so that for a fixed N the loop trip count is a constant (no end pointer, unrollable) and
+   * the reciprocal folds into a constant multiply instead of a division.
+   *
+   * @tparam N Frames per block, 0 for a frame count only known at runtime.
+   */
+  template <size_t N>
+  struct BlockSize {
+    /** True when the frame count is known at compile time. */
+    static constexpr bool is_fixed = true;
+
+    /**
+     * @return Frames per block, the frame count passed to the render callback is ignored.
+     */
+    static constexpr size_t frames(size_t) {
+      return N;
+    }
+
+    /**
+     * @return Reciprocal of the frames per block, the frame count passed to the render callback is ignored.
+     */
+    static constexpr float recip(size_t) {
+      return 1.f / N;
+    }
+  };
+
+  /**
+   * Generic fallback, frame count known at runtime only.
+   */
+  template <>
+  struct BlockSize<0> {
+    static constexpr bool is_fixed = false;
+
+    static constexpr size_t frames(size_t frames) {
+      return frames;
+    }
+
+    static constexpr float recip(size_t frames) {
+      return 1.f / frames;
+    }
+  };
+
+  /**
+   * Check whether the specialized variant of a processing method can be used.
+   *
+   * Evaluated per render call rather than once in Init(), since runtimes may pass blocks shorter
+   * than unit_runtime_desc_t::frames_per_buffer. A compare also keeps both variants inlinable,
+   * unlike a method pointer selected at init time.
+   *
+   * @param frames Frame count to check.
+   * @return True if frames matches the native block size.
+   */
+  inline __attribute__((always_inline))
+  bool is_native_block(size_t frames) {
+    return frames == k_native_frames;
+  }
+}
+
+/** @} */
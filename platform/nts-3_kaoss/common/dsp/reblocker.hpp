@@ -0,0 +1,165 @@
+#pragma once
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018-2023, KORG INC.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//*/
+
+#include <stddef.h>
+
+#include "utils/buffer_ops.h"
+
+/**
+ * @file    reblocker.hpp
+ * @brief   Fixed-size sub-block adapter for variable render block sizes.
+ *
+ * @addtogroup dsp DSP
+ * @{
+ */
+
+/**
+ * Common DSP Utilities
+ */
+namespace dsp {
+
+  /**
+   * Splits or accumulates render callback blocks into fixed-size sub-blocks, so that
+   * processing kernels always see exactly B frames and never need scalar tails.
+   *
+   * Two modes of operation:
+   *  - Direct: while frame counts are multiples of B, the kernel is called on the
+   *    caller's buffers, one sub-block at a time. No copies, no added latency.
+   *  - Buffered: on the first frame count that is not a multiple of B, input is
+   *    accumulated in an internal sub-block and output is read back one sub-block
+   *    later, adding B frames of latency. Buffered mode persists until reset(),
+   *    as returning to direct mode would drop B frames of output.
+   *
+   * Kernels are callables with signature void(const float * in, float * out),
+   * processing B interleaved frames of IC input and OC output channels.
+   * In direct mode in == out is passed through when the caller renders in place.
+   *
+   * @tparam B  Sub-block size in frames, a multiple of 4 is recommended for vector kernels.
+   * @tparam IC Input channels per frame.
+   * @tparam OC Output channels per frame.
+   */
+  template <size_t B, size_t IC = 2, size_t OC = 2>
+  struct Reblocker {
+
+    /*===========================================================================*/
+    /* Constructor / Destructor.                                                 */
+    /*===========================================================================*/
+
+    /**
+     * Default constructor
+     */
+    Reblocker(void) {
+      reset();
+    }
+
+    /*===========================================================================*/
+    /* Public Methods.                                                           */
+    /*===========================================================================*/
+
+    /**
+     * Clear internal buffers and return to direct mode.
+     */
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void reset(void) {
+      buf_clr_f32(mIn, B * IC);
+      buf_clr_f32(mOut, B * OC);
+      mPos = 0;
+      mBuffered = false;
+    }
+
+    /**
+     * @return Latency in frames currently added by the adapter, 0 or B.
+     */
+    inline __attribute__((always_inline))
+    size_t latency(void) const {
+      return mBuffered ? B : 0;
+    }
+
+    /**
+     * Process a render block of arbitrary length.
+     *
+     * @param in     Interleaved input buffer, frames * IC samples.
+     * @param out    Interleaved output buffer, frames * OC samples.
+     * @param frames Number of frames to process.
+     * @param kernel Callable processing exactly B frames.
+     */
+    template <typename Kernel>
+    inline __attribute__((optimize("Ofast"),always_inline))
+    void process(const float * in, float * out, size_t frames, Kernel &kernel) {
+      if (!mBuffered) {
+        if (frames % B == 0) {
+          // Zero-latency path: hand the caller's buffers to the kernel directly
+          for (; frames; frames -= B, in += B * IC, out += B * OC)
+            kernel(in, out);
+          return;
+        }
+        // Switch to buffered mode, first B output frames will be silence
+        mBuffered = true;
+      }
+
+      while (frames) {
+        const size_t n = (frames < B - mPos) ? frames : B - mPos;
+
+        // Note: read input chunk before writing output chunk, supports in == out
+        buf_cpy_f32(in, mIn + mPos * IC, n * IC);
+        buf_cpy_f32(mOut + mPos * OC, out, n * OC);
+
+        mPos += n;
+        frames -= n;
+        in += n * IC;
+        out += n * OC;
+
+        if (mPos == B) {
+          kernel(static_cast<const float *>(mIn), static_cast<float *>(mOut));
+          mPos = 0;
+        }
+      }
+    }
+
+    /*===========================================================================*/
+    /* Member Variables.                                                         */
+    /*===========================================================================*/
+
+    /** Input accumulation sub-block, interleaved */
+    float mIn[B * IC] __attribute__((aligned(16)));
+    /** Output sub-block read back one sub-block later, interleaved */
+    float mOut[B * OC] __attribute__((aligned(16)));
+    /** Write/read position within the current sub-block, in frames */
+    size_t mPos;
+    /** True once a block size not multiple of B was seen */
+    bool mBuffered;
+  };
+}
+
+/** @} */
@@ -0,0 +1,236 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018-2023, KORG INC.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//*/
+
+
+/**
+ *  @file fp_check.h
+ *
+ *  @brief Subnormal, NaN and infinity detection in outputs and unit state
+ *
+ *  Subnormal values left in filter or delay feedback state slow rendering
+ *  down without any audible sign, and a single NaN in a feedback path
+ *  silences a unit for good. In diagnostic builds, FPCHECK_BLOCK() scans the
+ *  output buffer and every registered state buffer after each block, counts
+ *  non-normal values, and logs the first offending block of each buffer:
+ *
+ *  @code
+ *  int8_t Init(const unit_runtime_desc_t * desc) {
+ *    FPCHECK_RESET();
+ *    FPCHECK_REGISTER(filter_z, filter_state_, 4);
+ *    FPCHECK_REGISTER(delay, delay_buffer_, kDelaySize);
+ *    ...
+ *  }
+ *
+ *  void Process(const float * in, float * out, size_t frames) {
+ *    ...
+ *    FPCHECK_BLOCK(out, frames * 2);
+ *  }
+ *  @endcode
+ *
+ *  Macros expand to nothing unless UNIT_FPCHECK is defined, e.g.: add
+ *  UDEFS = -DUNIT_FPCHECK to a project's config.mk. Results live in the
+ *  unit_fpcheck_table[] and unit_fpcheck_log[] arrays, which can be inspected
+ *  from a debugger, or are reported by host tools (see tools/unit-host), which
+ *  also scan outputs of units not calling FPCHECK_BLOCK() themselves.
+ *
+ *  Note: values are classified from their bit patterns, so that checks are
+ *        not optimized away by -ffast-math.
+ *  Note: zero is not subnormal. Subnormals already flushed to zero by the FPU
+ *        (FTZ) cannot be seen, but neither do they cost cycles.
+ *  Note: scanning is not thread safe, only scan from the render thread.
+ */
+
+#ifndef FP_CHECK_H_
+#define FP_CHECK_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/** Maximum number of registered buffers, including the output */
+#ifndef UNIT_FPCHECK_MAX_BUFFERS
+#define UNIT_FPCHECK_MAX_BUFFERS 16
+#endif
+
+/** Index of the output buffer entry */
+#define UNIT_FPCHECK_OUTPUT 0
+
+/** No offending block yet */
+#define UNIT_FPCHECK_NONE 0xFFFFFFFFU
+
+enum {
+  k_unit_fpcheck_subnormal = 1U << 0,
+  k_unit_fpcheck_nan = 1U << 1,
+  k_unit_fpcheck_inf = 1U << 2,
+};
+
+/** Counts of non-normal values found in a buffer, over all scanned blocks */
+typedef struct unit_fpcheck_entry {
+  const char * name;
+  const float * data;
+  uint32_t size;         // In floats
+  uint32_t subnormals;
+  uint32_t nans;
+  uint32_t infs;
+} unit_fpcheck_entry_t;
+
+/** Compact log record of the first offending block of a buffer */
+typedef struct unit_fpcheck_record {
+  uint32_t block;   // Block counter, from 0
+  uint8_t entry;    // Index in unit_fpcheck_table[]
+  uint8_t kinds;    // k_unit_fpcheck_* found in that block
+  uint16_t index;   // First offending value in the buffer, saturated
+  float value;      // Its value
+} unit_fpcheck_record_t;  // 12 bytes
+
+#if defined(UNIT_FPCHECK)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Note: weak definitions, a single instance is shared by all translation units of a unit
+__attribute__((weak)) unit_fpcheck_entry_t unit_fpcheck_table[UNIT_FPCHECK_MAX_BUFFERS];
+__attribute__((weak)) uint32_t unit_fpcheck_count;
+__attribute__((weak)) unit_fpcheck_record_t unit_fpcheck_log[UNIT_FPCHECK_MAX_BUFFERS];
+__attribute__((weak)) uint32_t unit_fpcheck_log_count;
+__attribute__((weak)) uint32_t unit_fpcheck_blocks;       // Scanned blocks
+__attribute__((weak)) uint32_t unit_fpcheck_first_block = UNIT_FPCHECK_NONE;
+
+/** Clear counts and the log, and unregister state buffers. Call from unit_init(). */
+static inline void unit_fpcheck_reset(void) {
+  unit_fpcheck_table[UNIT_FPCHECK_OUTPUT].name = "output";
+  unit_fpcheck_table[UNIT_FPCHECK_OUTPUT].data = 0;
+  unit_fpcheck_table[UNIT_FPCHECK_OUTPUT].size = 0;
+  unit_fpcheck_count = 1;
+  for (uint32_t i = 0; i < UNIT_FPCHECK_MAX_BUFFERS; ++i) {
+    unit_fpcheck_table[i].subnormals = 0;
+    unit_fpcheck_table[i].nans = 0;
+    unit_fpcheck_table[i].infs = 0;
+  }
+  unit_fpcheck_log_count = 0;
+  unit_fpcheck_blocks = 0;
+  unit_fpcheck_first_block = UNIT_FPCHECK_NONE;
+}
+
+/** Register a state buffer to scan after each block, ignored once the table is full */
+static inline void unit_fpcheck_register(const char * name, const float * data, uint32_t size) {
+  if (unit_fpcheck_count == 0)
+    unit_fpcheck_reset();
+  if (unit_fpcheck_count >= UNIT_FPCHECK_MAX_BUFFERS)
+    return;
+  unit_fpcheck_entry_t * e = &unit_fpcheck_table[unit_fpcheck_count++];
+  e->name = name;
+  e->data = data;
+  e->size = size;
+  e->subnormals = 0;
+  e->nans = 0;
+  e->infs = 0;
+}
+
+static inline void unit_fpcheck_scan_entry(uint32_t entry) {
+  unit_fpcheck_entry_t * e = &unit_fpcheck_table[entry];
+  uint32_t subnormals = 0, nans = 0, infs = 0;
+  uint32_t first = UNIT_FPCHECK_NONE;
+  for (uint32_t i = 0; i < e->size; ++i) {
+    uint32_t bits;
+    memcpy(&bits, &e->data[i], sizeof(bits));  // Note: no type punning through pointers, see -fstrict-aliasing
+    const uint32_t exponent = bits & 0x7F800000U;
+    const uint32_t mantissa = bits & 0x007FFFFFU;
+    if (exponent == 0x7F800000U) {
+      nans += (mantissa != 0);
+      infs += (mantissa == 0);
+    } else if (exponent == 0 && mantissa != 0) {
+      ++subnormals;
+    } else {
+      continue;
+    }
+    first = (first == UNIT_FPCHECK_NONE) ? i : first;
+  }
+  if (first == UNIT_FPCHECK_NONE)
+    return;
+
+  // Note: only the first offending block of each buffer is logged
+  if (!e->subnormals && !e->nans && !e->infs && unit_fpcheck_log_count < UNIT_FPCHECK_MAX_BUFFERS) {
+    unit_fpcheck_record_t * r = &unit_fpcheck_log[unit_fpcheck_log_count++];
+    r->block = unit_fpcheck_blocks;
+    r->entry = (uint8_t)entry;
+    r->kinds = (subnormals ? k_unit_fpcheck_subnormal : 0) | (nans ? k_unit_fpcheck_nan : 0)
+               | (infs ? k_unit_fpcheck_inf : 0);
+    r->index = (first > 0xFFFFU) ? 0xFFFFU : (uint16_t)first;
+    r->value = e->data[first];
+  }
+  if (unit_fpcheck_first_block == UNIT_FPCHECK_NONE)
+    unit_fpcheck_first_block = unit_fpcheck_blocks;
+  e->subnormals += subnormals;
+  e->nans += nans;
+  e->infs += infs;
+}
+
+/**
+ * Scan an output buffer and all registered state buffers, then advance the block counter.
+ *
+ * Note: weak and externally visible, so that host tools can scan outputs after
+ *       each unit_render() call, see tools/unit-host.
+ */
+__attribute__((weak, used, noinline)) void unit_fpcheck_scan(const float * out, uint32_t size) {
+  if (unit_fpcheck_count == 0)
+    unit_fpcheck_reset();
+  unit_fpcheck_table[UNIT_FPCHECK_OUTPUT].data = out;
+  unit_fpcheck_table[UNIT_FPCHECK_OUTPUT].size = out ? size : 0;
+  for (uint32_t i = 0; i < unit_fpcheck_count; ++i)
+    unit_fpcheck_scan_entry(i);
+  unit_fpcheck_table[UNIT_FPCHECK_OUTPUT].data = 0;
+  ++unit_fpcheck_blocks;
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#define FPCHECK_RESET() unit_fpcheck_reset()
+
+/** Register an array of floats, e.g.: filter state or a delay line, under the given name */
+#define FPCHECK_REGISTER(name, data, size) unit_fpcheck_register(#name, (const float *)(data), (uint32_t)(size))
+
+/** Scan the output buffer of a block and all registered buffers */
+#define FPCHECK_BLOCK(out, size) unit_fpcheck_scan((out), (uint32_t)(size))
+
+#else  // UNIT_FPCHECK
+
+#define FPCHECK_RESET() ((void)0)
+#define FPCHECK_REGISTER(name, data, size) ((void)0)
+#define FPCHECK_BLOCK(out, size) ((void)0)
+
+#endif  // UNIT_FPCHECK
+
+#endif  // FP_CHECK_H_
@@ -0,0 +1,233 @@
+/*
+    BSD 3-Clause License
+
+    Copyright (c) 2018-2023, KORG INC.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//*/
+
+/**
+ *  @file profile.h
+ *
+ *  @brief Scoped cycle counter instrumentation
+ *
+ *  Measures the time spent in named sections of code, e.g. the oscillator,
+ *  filter and bit crusher stages of a render loop:
+ *
+ *  @code
+ *  void Process(const float * in, float * out, size_t frames) {
+ *    {
+ *      PROFILE_SCOPE(osc);
+ *      ...
+ *    }
+ *    {
+ *      PROFILE_SCOPE(filter);
+ *      ...
+ *    }
+ *  }
+ *  @endcode
+ *
+ *  Macros expand to nothing unless UNIT_PROFILE is defined, e.g.: add
+ *  UDEFS = -DUNIT_PROFILE to a project's config.mk. When enabled, each scope
+ *  accumulates elapsed cycles, pass count and worst pass into the
+ *  unit_profile_table[] array, which a unit can expose through a string
+ *  parameter or inspect from a debugger. Scopes sharing a name share an entry.
+ *
+ *  Cycle sources:
+ *   - Cortex-M4/M7: DWT->CYCCNT, enabled by PROFILE_INIT().
+ *   - Cortex-A7: PMCCNTR. User space access must have been enabled by the
+ *     kernel (PMUSERENR.EN), otherwise define UNIT_PROFILE_USE_CLOCK to fall
+ *     back to clock_gettime().
+ *   - x86 hosts: time stamp counter. Other hosts: clock_gettime(), nanoseconds.
+ *
+ *  Note: counts are 32-bit per pass, scopes must be shorter than 2^32 cycles.
+ *  Note: entries are registered on first use and not thread safe, only use
+ *        scopes from the render thread.
+ *
+ *  PROFILE_SCOPE() requires C++. C code can use PROFILE_BEGIN()/PROFILE_END()
+ *  pairs within a same block.
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+
+/** Maximum number of distinct scope names, further scopes accumulate into unit_profile_overflow */
+#ifndef UNIT_PROFILE_MAX_SCOPES
+#define UNIT_PROFILE_MAX_SCOPES 16
+#endif
+
+/** Accumulated cycles of a named scope */
+typedef struct unit_profile_entry {
+  const char * name;
+  uint64_t cycles;      // Total over all passes
+  uint32_t passes;
+  uint32_t max_cycles;  // Most expensive single pass
+} unit_profile_entry_t;
+
+#if defined(UNIT_PROFILE)
+
+#if !(defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__) || defined(__x86_64__) || defined(__i386__)) \
+    && (!defined(__ARM_ARCH_7A__) || defined(UNIT_PROFILE_USE_CLOCK))
+#define UNIT_PROFILE_CLOCK_GETTIME
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Note: weak definitions, a single instance is shared by all translation units of a unit
+__attribute__((weak)) unit_profile_entry_t unit_profile_table[UNIT_PROFILE_MAX_SCOPES];
+__attribute__((weak)) uint32_t unit_profile_count;
+__attribute__((weak)) unit_profile_entry_t unit_profile_overflow;  // Sink for scopes beyond the table size
+
+static inline __attribute__((always_inline)) uint32_t unit_profile_now(void) {
+#if defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+  return *(volatile uint32_t *)0xE0001004U;  // DWT->CYCCNT
+#elif defined(UNIT_PROFILE_CLOCK_GETTIME)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)ts.tv_sec * 1000000000U + (uint32_t)ts.tv_nsec;
+#elif defined(__ARM_ARCH_7A__)
+  uint32_t c;
+  __asm__ volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(c));  // PMCCNTR
+  return c;
+#else
+  return (uint32_t)__builtin_ia32_rdtsc();
+#endif
+}
+
+/** Clear accumulated counts, keeping registered names */
+static inline void unit_profile_reset(void) {
+  for (uint32_t i = 0; i < unit_profile_count; ++i) {
+    unit_profile_table[i].cycles = 0;
+    unit_profile_table[i].passes = 0;
+    unit_profile_table[i].max_cycles = 0;
+  }
+  unit_profile_overflow.cycles = 0;
+  unit_profile_overflow.passes = 0;
+  unit_profile_overflow.max_cycles = 0;
+}
+
+/**
+ * Enable the cycle counter if needed, and clear accumulated counts. Call from unit_init().
+ *
+ * Note: registered names are kept, call sites cache their entry and may have
+ *       run before a second unit_init().
+ */
+static inline void unit_profile_init(void) {
+#if defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+  *(volatile uint32_t *)0xE000EDFCU |= (1U << 24);  // CoreDebug->DEMCR.TRCENA
+  *(volatile uint32_t *)0xE0001FB0U = 0xC5ACCE55U;  // DWT->LAR, unlock (Cortex-M7)
+  *(volatile uint32_t *)0xE0001000U |= 1U;          // DWT->CTRL.CYCCNTENA
+#endif
+  unit_profile_reset();
+}
+
+/** Find or create the entry for a name */
+static inline unit_profile_entry_t * unit_profile_lookup(const char * name) {
+  for (uint32_t i = 0; i < unit_profile_count; ++i) {
+    const char * a = unit_profile_table[i].name;
+    const char * b = name;
+    while (*a && *a == *b) {
+      ++a;
+      ++b;
+    }
+    if (*a == *b)
+      return &unit_profile_table[i];
+  }
+  if (unit_profile_count >= UNIT_PROFILE_MAX_SCOPES)
+    return &unit_profile_overflow;
+  unit_profile_entry_t * e = &unit_profile_table[unit_profile_count++];
+  e->name = name;
+  e->cycles = 0;
+  e->passes = 0;
+  e->max_cycles = 0;
+  return e;
+}
+
+static inline __attribute__((always_inline)) void unit_profile_add(unit_profile_entry_t * e, uint32_t t0) {
+  const uint32_t dt = unit_profile_now() - t0;
+  e->cycles += dt;
+  e->passes++;
+  e->max_cycles = (dt > e->max_cycles) ? dt : e->max_cycles;
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+
+/** Adds the cycles elapsed between construction and destruction to an entry */
+class UnitProfileScope {
+ public:
+  inline __attribute__((always_inline)) explicit UnitProfileScope(unit_profile_entry_t * e)
+      : entry_(e), t0_(unit_profile_now()) {}
+  inline __attribute__((always_inline)) ~UnitProfileScope() { unit_profile_add(entry_, t0_); }
+
+ private:
+  UnitProfileScope(const UnitProfileScope &);
+  UnitProfileScope & operator=(const UnitProfileScope &);
+
+  unit_profile_entry_t * entry_;
+  const uint32_t t0_;
+};
+#endif
+
+// Note: the entry pointer is cached per call site
+#define UNIT_PROFILE_ENTRY(name)                                                \
+  static unit_profile_entry_t * unit_profile_site_##name = 0;                   \
+  if (!unit_profile_site_##name)                                                \
+    unit_profile_site_##name = unit_profile_lookup(#name);
+
+#define PROFILE_INIT() unit_profile_init()
+#define PROFILE_RESET() unit_profile_reset()
+
+/** Profile the rest of the enclosing block under the given name (C++ only) */
+#define PROFILE_SCOPE(name)                                                     \
+  UNIT_PROFILE_ENTRY(name)                                                      \
+  const UnitProfileScope unit_profile_scope_##name(unit_profile_site_##name)
+
+/** Start a section profiled under the given name, closed by PROFILE_END(name) */
+#define PROFILE_BEGIN(name)                                                     \
+  UNIT_PROFILE_ENTRY(name)                                                      \
+  const uint32_t unit_profile_t0_##name = unit_profile_now()
+
+#define PROFILE_END(name) unit_profile_add(unit_profile_site_##name, unit_profile_t0_##name)
+
+#else  // UNIT_PROFILE
+
+#define PROFILE_INIT() ((void)0)
+#define PROFILE_RESET() ((void)0)
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END(name) ((void)0)
+
+#endif  // UNIT_PROFILE
+
+#endif  // PROFILE_H_
@@ -371,6 +371,7 @@ extern "C" {
    *
    * After initialization, and after exiting suspended state, the render callback is called at each audio processing cycle.
    * Note that input and output buffers either overlap completely or not at all.
+   * Units declaring k_unit_flag_inplace_render in their header allow runtimes to render them in place (in == out) and skip an intermediate buffer.
    * Input/output channel geometry is determined by the runtime descriptor passed via the initialization callback.
    * @see unit_init_func
    * @see unit_runtime_desc_t
@@ -413,6 +414,18 @@ extern "C" {
    */  
   typedef void (*unit_set_param_value_func)(uint8_t param_id, int32_t value);
 
+  /**
+   * Unit set parameter values callback type (optional)
+   *
+   * After initialization, the callback may be called at any time to set several parameters at once, for instance when
+   * restoring a preset. Allows units to update derived state only once for the whole batch.
+   * Runtimes may still fall back to individual unit_set_param_value() calls.
+   *
+   * \param values Array of parameter values indexed by parameter identifier, only entries selected by mask are valid.
+   * \param mask   Bit mask of parameters to set, bit n corresponding to parameter identifier n.
+   */
+  typedef void (*unit_set_param_values_func)(const int32_t * values, uint32_t mask);
+
   /**
    * Unit set tempo callback type
    *
@@ -460,6 +473,16 @@ extern "C" {
    */    
   typedef void (*unit_touch_event_func)(uint8_t, uint8_t, uint32_t, uint32_t);
   
+  /**
+   * Unit capability flags.
+   * Declared via the flags field of unit_header_t. Runtimes ignore flags they do not know about.
+   */
+  enum {
+    k_unit_flags_none = 0U,
+    /** unit_render() produces correct output when called with in == out. Only meaningful when input and output channel counts match. */
+    k_unit_flag_inplace_render = (1U<<0),
+  };
+
   /**
    * Header units must provide to the runtime.
    * Each unit must define and expose an instance of unit_header_t to the runtime.
@@ -473,7 +496,10 @@ extern "C" {
     uint32_t unit_id;                          /** ID for this unit. Scoped within the context of a given dev_id. */
     uint32_t version;                          /** The unit's version following the same major.minor.patch format and rules as the API version */
     char     name[UNIT_NAME_SIZE];             /** Unit name. */
-    uint32_t reserved0;                        /** Reserved for future use. */
+    union {
+      uint32_t flags;                          /** Unit capability flags. See k_unit_flag_* above. */
+      uint32_t reserved0;                      /** Former name of the flags field, kept for source compatibility. */
+    };
     uint32_t reserved1;                        /** Reserved for future use. */
     uint32_t num_params;                       /** Number of valid parameter descriptors. */
     unit_param_t params[UNIT_MAX_PARAM_COUNT]; /** Parameter descriptors. */
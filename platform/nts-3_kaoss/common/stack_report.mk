@@ -0,0 +1,20 @@
+##############################################################################
+# Stack usage analysis, included by unit Makefiles
+#
+# Note: call graphs require GCC 10 or later, older toolchains only get
+#       per-frame checks from the .su files. See stack_report.awk
+#
+
+# Worst-case stack depth allowed for any unit callback in bytes, 0 to disable the check
+STACK_LIMIT ?= 2048
+
+SOPT := -fstack-usage
+SOPT += $(shell $(CC) -fcallgraph-info=su -E -x c /dev/null >/dev/null 2>&1 && echo -fcallgraph-info=su)
+
+STACK_INFO = $(or $(wildcard $(OBJDIR)/*.ci),$(wildcard $(OBJDIR)/*.su),/dev/null)
+
+%.stack: %.elf
+	@echo Creating $@
+	@awk -v limit=$(STACK_LIMIT) -f $(COMMON_SRC_PATH)/stack_report.awk $(STACK_INFO) > $@.tmp \
+	  || { cat $@.tmp; rm -f $@.tmp; exit 1; }
+	@mv $@.tmp $@
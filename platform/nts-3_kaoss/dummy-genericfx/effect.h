@@ -48,6 +48,7 @@
 
 #include "utils/buffer_ops.h" // for buf_clr_f32()
 #include "utils/int_math.h"   // for clipminmaxi32()
+#include "dsp/blocksize.hpp"  // for dsp::BlockSize
 
 class Effect {
  public:
@@ -166,19 +167,35 @@ class Effect {
   /*===========================================================================*/
 
   fast_inline void Process(const float * in, float * out, size_t frames) {
-    const float * __restrict in_p = in;
-    float * __restrict out_p = out;
-    const float * out_e = out_p + (frames << 1);  // assuming stereo output
+    // Use the variant specialized for the platform's block size whenever possible
+    if (dsp::is_native_block(frames))
+      ProcessBlock<dsp::k_native_frames>(in, out, frames);
+    else
+      ProcessBlock<0>(in, out, frames);
+  }
+
+  template <size_t N>
+  fast_inline void ProcessBlock(const float * in, float * out, size_t frames) {
+    // Note: in and out may point to the same buffer as this unit declares k_unit_flag_inplace_render (see header.c).
+    //       Pointers must thus not be __restrict qualified, and input samples of a frame must be read before writing its output.
+    // Note: for N > 0 frames is known at compile time, see dsp::BlockSize
+    typedef dsp::BlockSize<N> block_t;
+
+    const float * in_p = in;
+    float * out_p = out;
+    const size_t n = block_t::frames(frames);
 
     // Caching current parameter values. Consider interpolating sensitive parameters.
     // const Params p = params_;
     
-    for (; out_p != out_e; in_p += 2, out_p += 2) {
+    for (size_t i = 0; i < n; ++i, in_p += 2, out_p += 2) {  // assuming stereo output
       // Process samples here
+      const float in_l = in_p[0];
+      const float in_r = in_p[1];
       
       // Note: this is a dummy unit only to demonstrate APIs, only passing through audio
-      out_p[0] = in_p[0]; // left sample
-      out_p[1] = in_p[1]; // right sample
+      out_p[0] = in_l; // left sample
+      out_p[1] = in_r; // right sample
     }
   }
 
@@ -213,6 +230,15 @@ class Effect {
     }
   }
 
+  inline void setParameters(const int32_t * values, uint32_t mask) {
+    // Batched update (e.g.: preset restore). Apply all values first, then
+    // recompute state derived from several parameters only once, here.
+    for (; mask; mask &= mask - 1) {
+      const uint8_t index = __builtin_ctz(mask);
+      setParameter(index, values[index]);
+    }
+  }
+
   inline int32_t getParameterValue(uint8_t index) const {
     switch (index) {
     case PARAM1:
@@ -0,0 +1,172 @@
+#
+# Double precision usage report for unit callbacks
+#
+# Reads the disassembly of a unit (objdump -d -l -C), and lists the double
+# precision operations reachable from each unit callback, i.e. each defined
+# function matching roots (default: unit_*): calls to soft-float helpers
+# (__aeabi_d*, __aeabi_f2d...), to double precision math functions (sin(),
+# pow()...), and double precision VFP instructions (*.f64). Each is reported
+# with the source location of the call, inlined code included.
+#
+# Usage: objdump -d -l -C unit.elf | awk [-v roots=<regex>] -f double_report.awk > report
+#
+# The full report is written to the standard output, a summary to the
+# standard error. The report has a line reading "none" if no callback
+# reaches double precision code, for use by packaging checks.
+#
+# Not accounted for, and listed in the report:
+#  - calls through function pointers or virtual functions, code only
+#    reachable this way is listed as not reachable
+#
+
+function strip_target(t) {
+  sub(/@plt$/, "", t)
+  return t
+}
+
+# Soft-float helpers and double precision math functions. Their bodies are
+# not scanned, calls to them are the offenders.
+function is_double_func(f) {
+  if (f ~ /^__aeabi_(d[a-z0-9]+|cd[a-z]+|cfcmp[a-z]*|f2d|i2d|ui2d|l2d|ul2d)$/)
+    return 1
+  if (f ~ /^__(add|sub|mul|div|neg|cmp|eq|ne|lt|le|gt|ge|unord)df[23]$/ \
+      || f ~ /^__(extendsfdf2|truncdfsf2|float(un)?[sd]idf|fixuns?dfs?[id])$/)
+    return 1
+  return (f in double_math)
+}
+
+function add_offender(what,    key) {
+  if (cur == "" || is_double_func(cur))
+    return
+  key = cur SUBSEP loc SUBSEP what
+  if (key in offender_seen)
+    return
+  offender_seen[key] = 1
+  offenders[cur] = offenders[cur] sprintf("    %-40s %s\n", loc, what)
+  offender_count[cur]++
+}
+
+BEGIN {
+  if (roots == "")
+    roots = "^unit_[a-z_]+$"
+  n = split("sin cos tan asin acos atan atan2 sinh cosh tanh exp exp2 expm1 log log2 log10 log1p " \
+            "pow sqrt cbrt hypot fmod floor ceil round trunc fabs modf frexp ldexp", list, " ")
+  for (i = 1; i <= n; ++i)
+    double_math[list[i]] = 1
+  cur = ""
+  loc = "?"
+}
+
+# Function start, e.g.: "00000128 <unit_render>:"
+/^[0-9a-f]+ <.*>:$/ {
+  cur = $0
+  sub(/^[0-9a-f]+ </, "", cur)
+  sub(/>:$/, "", cur)
+  defined[cur] = 1
+  loc = "?"
+  next
+}
+
+# Source locations from -l, e.g.: "/path/waves.h:349 (discriminator 2)"
+/^[^ \t].*:[0-9]+( \(discriminator [0-9]+\))?$/ {
+  loc = $0
+  sub(/ \(discriminator [0-9]+\)$/, "", loc)
+  sub(/^.*\//, "", loc)
+  next
+}
+
+# Instructions, e.g.: " 12a:	f000 f8a1 	bl	270 <__aeabi_f2d>"
+/^ *[0-9a-f]+:\t/ {
+  if (cur == "")
+    next
+  n = split($0, cols, "\t")
+  mnemonic = cols[3]
+  operands = cols[4]
+  sub(/ +$/, "", mnemonic)
+
+  if (mnemonic ~ /\.f64/) {
+    add_offender(mnemonic)
+    next
+  }
+  if (mnemonic !~ /^(bl|blx|b|b\.w|b\.n)(\.w)?$/ || !match(operands, /<[^>]+>/))
+    next
+  target = substr(operands, RSTART + 1, RLENGTH - 2)
+  # Note: branches within a function carry an offset
+  if (target ~ /\+0x[0-9a-f]+$/)
+    next
+  target = strip_target(target)
+  if (target == cur)
+    next
+  if (is_double_func(target))
+    add_offender(target)
+  if (!((cur, target) in has_edge)) {
+    has_edge[cur, target] = 1
+    callees[cur] = callees[cur] SUBSEP target
+  }
+  next
+}
+
+END {
+  # Roots: defined unit callbacks
+  root_count = 0
+  for (f in defined) {
+    if (f ~ roots)
+      root[++root_count] = f
+  }
+  # Note: insertion sort, for a stable report
+  for (i = 2; i <= root_count; ++i) {
+    r = root[i]
+    for (j = i - 1; j >= 1 && root[j] > r; --j)
+      root[j + 1] = root[j]
+    root[j + 1] = r
+  }
+
+  print "Double precision operations reachable from unit callbacks"
+
+  failed = 0
+  for (i = 1; i <= root_count; ++i) {
+    # Depth first walk, not entering soft-float helpers
+    delete visited
+    top = 0
+    stack[++top] = root[i]
+    visited[root[i]] = 1
+    found = ""
+    count = 0
+    while (top > 0) {
+      f = stack[top--]
+      if (f in offender_count) {
+        found = found sprintf("  %s\n%s", f, offenders[f])
+        count += offender_count[f]
+        reached[f] = 1
+      }
+      m = split(callees[f], list, SUBSEP)
+      for (k = 1; k <= m; ++k) {
+        c = list[k]
+        if (c == "" || (c in visited) || is_double_func(c))
+          continue
+        visited[c] = 1
+        stack[++top] = c
+      }
+    }
+    if (count == 0)
+      continue
+    failed = 1
+    printf "\n%s: %d\n%s", root[i], count, found
+    summary = summary sprintf("  %-32s %d\n", root[i], count)
+  }
+  if (!failed)
+    print "\nnone"
+
+  total = 0
+  for (f in offender_count) {
+    if (f in reached)
+      total += offender_count[f]
+    else
+      notes = notes sprintf("  %s\n%s", f, offenders[f])
+  }
+  if (notes != "")
+    printf "\nnot reachable from a callback through direct calls:\n%s", notes
+
+  printf("double: %d operations reachable from %d callbacks\n%s", total, root_count,
+         failed ? summary : "") > "/dev/stderr"
+}
@@ -0,0 +1,178 @@
+/**
+ * @file arm_math.h
+ * @brief Host replacement for the CMSIS header included by utils/cortexm.h
+ *
+ * Generic C implementations of the core and SIMD intrinsics used by the
+ * common headers and units, so that unit sources can be compiled for the
+ * host without modification. Results match the Cortex-M instructions, except
+ * for the Q (saturation) flag which is not modeled.
+ *
+ * Intrinsics without a meaningful host equivalent (barriers, exclusive
+ * accesses, ...) are either no-ops or left undefined so that units relying on
+ * them fail to build rather than silently misbehaving.
+ *
+ */
+
+#ifndef UNIT_HOST_ARM_MATH_H_
+#define UNIT_HOST_ARM_MATH_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __SIMD32_TYPE int32_t
+
+#define __host_intrinsic static inline __attribute__((always_inline))
+
+/*===========================================================================*/
+/* Core */
+/*===========================================================================*/
+
+#define __NOP()
+#define __DMB() __sync_synchronize()
+#define __DSB() __sync_synchronize()
+#define __ISB() __sync_synchronize()
+
+__host_intrinsic uint32_t __CLZ(uint32_t x) {
+  return x ? (uint32_t)__builtin_clz(x) : 32U;
+}
+
+__host_intrinsic uint32_t __RBIT(uint32_t x) {
+  uint32_t r = 0;
+  for (int i = 0; i < 32; ++i, x >>= 1)
+    r = (r << 1) | (x & 1U);
+  return r;
+}
+
+__host_intrinsic uint32_t __REV(uint32_t x) {
+  return __builtin_bswap32(x);
+}
+
+__host_intrinsic uint32_t __REV16(uint32_t x) {
+  return ((x & 0xFF00FF00U) >> 8) | ((x & 0x00FF00FFU) << 8);
+}
+
+__host_intrinsic int16_t __REVSH(int16_t x) {
+  return (int16_t)__builtin_bswap16((uint16_t)x);
+}
+
+__host_intrinsic uint32_t __ROR(uint32_t x, uint32_t n) {
+  n &= 31U;
+  return n ? (x >> n) | (x << (32U - n)) : x;
+}
+
+/*===========================================================================*/
+/* Saturation */
+/*===========================================================================*/
+
+__host_intrinsic int32_t __host_ssat(int64_t x, uint32_t bits) {
+  const int64_t max = ((int64_t)1 << (bits - 1)) - 1;
+  const int64_t min = -max - 1;
+  return (int32_t)(x > max ? max : (x < min ? min : x));
+}
+
+__host_intrinsic uint32_t __host_usat(int64_t x, uint32_t bits) {
+  const int64_t max = ((int64_t)1 << bits) - 1;
+  return (uint32_t)(x > max ? max : (x < 0 ? 0 : x));
+}
+
+#define __SSAT(x, bits) __host_ssat((int32_t)(x), (bits))
+#define __USAT(x, bits) __host_usat((int32_t)(x), (bits))
+
+__host_intrinsic int32_t __QADD(int32_t a, int32_t b) {
+  return __host_ssat((int64_t)a + b, 32);
+}
+
+__host_intrinsic int32_t __QSUB(int32_t a, int32_t b) {
+  return __host_ssat((int64_t)a - b, 32);
+}
+
+/*===========================================================================*/
+/* SIMD */
+/*===========================================================================*/
+
+#define __host_lo16(x) ((int32_t)(int16_t)((uint32_t)(x) & 0xFFFFU))
+#define __host_hi16(x) ((int32_t)(int16_t)((uint32_t)(x) >> 16))
+#define __host_pack16(lo, hi) ((int32_t)(((uint32_t)(lo) & 0xFFFFU) | ((uint32_t)(hi) << 16)))
+
+// Note: __SEL() relies on GE flags set by the previous parallel add/subtract, emulated with a thread local
+extern __thread uint32_t __host_apsr_ge;
+
+__host_intrinsic uint32_t __host_ge16(int32_t lo, int32_t hi) {
+  return (lo >= 0 ? 0x3U : 0U) | (hi >= 0 ? 0xCU : 0U);
+}
+
+__host_intrinsic int32_t __SADD16(int32_t a, int32_t b) {
+  const int32_t lo = __host_lo16(a) + __host_lo16(b);
+  const int32_t hi = __host_hi16(a) + __host_hi16(b);
+  __host_apsr_ge = __host_ge16(lo, hi);
+  return __host_pack16(lo, hi);
+}
+
+__host_intrinsic int32_t __SSUB16(int32_t a, int32_t b) {
+  const int32_t lo = __host_lo16(a) - __host_lo16(b);
+  const int32_t hi = __host_hi16(a) - __host_hi16(b);
+  __host_apsr_ge = __host_ge16(lo, hi);
+  return __host_pack16(lo, hi);
+}
+
+__host_intrinsic int32_t __QADD16(int32_t a, int32_t b) {
+  return __host_pack16(__host_ssat(__host_lo16(a) + __host_lo16(b), 16),
+                       __host_ssat(__host_hi16(a) + __host_hi16(b), 16));
+}
+
+__host_intrinsic int32_t __QSUB16(int32_t a, int32_t b) {
+  return __host_pack16(__host_ssat(__host_lo16(a) - __host_lo16(b), 16),
+                       __host_ssat(__host_hi16(a) - __host_hi16(b), 16));
+}
+
+__host_intrinsic int32_t __SHADD16(int32_t a, int32_t b) {
+  return __host_pack16((__host_lo16(a) + __host_lo16(b)) >> 1, (__host_hi16(a) + __host_hi16(b)) >> 1);
+}
+
+__host_intrinsic int32_t __SHSUB16(int32_t a, int32_t b) {
+  return __host_pack16((__host_lo16(a) - __host_lo16(b)) >> 1, (__host_hi16(a) - __host_hi16(b)) >> 1);
+}
+
+__host_intrinsic int32_t __SSAT16(int32_t x, uint32_t bits) {
+  return __host_pack16(__host_ssat(__host_lo16(x), bits), __host_ssat(__host_hi16(x), bits));
+}
+
+__host_intrinsic int32_t __SMUAD(int32_t a, int32_t b) {
+  return __host_lo16(a) * __host_lo16(b) + __host_hi16(a) * __host_hi16(b);
+}
+
+__host_intrinsic int32_t __SMUSD(int32_t a, int32_t b) {
+  return __host_lo16(a) * __host_lo16(b) - __host_hi16(a) * __host_hi16(b);
+}
+
+__host_intrinsic int32_t __SMLAD(int32_t a, int32_t b, int32_t acc) {
+  return acc + __SMUAD(a, b);
+}
+
+__host_intrinsic int32_t __SEL(int32_t a, int32_t b) {
+  uint32_t r = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    const uint32_t mask = 0xFFU << (8 * i);
+    r |= ((__host_apsr_ge >> i) & 1U) ? ((uint32_t)a & mask) : ((uint32_t)b & mask);
+  }
+  return (int32_t)r;
+}
+
+__host_intrinsic int32_t __PKHBT(int32_t a, int32_t b, uint32_t shift) {
+  return (int32_t)(((uint32_t)a & 0xFFFFU) | (((uint32_t)b << shift) & 0xFFFF0000U));
+}
+
+__host_intrinsic int32_t __PKHTB(int32_t a, int32_t b, uint32_t shift) {
+  return (int32_t)(((uint32_t)a & 0xFFFF0000U) | (((uint32_t)((int32_t)b >> shift)) & 0xFFFFU));
+}
+
+#undef __host_intrinsic
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // UNIT_HOST_ARM_MATH_H_
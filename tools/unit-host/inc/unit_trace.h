@@ -0,0 +1,127 @@
+/**
+ * @file unit_trace.h
+ * @brief Render trace binary format
+ *
+ * A trace captures the exact sequence of callbacks a runtime issued to a unit,
+ * so that the session can be replayed deterministically for profiling.
+ *
+ * Layout (little endian, all offsets multiple of 16 bytes):
+ *
+ *   unit_trace_header_t
+ *   unit_trace_record_t [payload, padded to 16 bytes]
+ *   unit_trace_record_t [payload, padded to 16 bytes]
+ *   ...
+ *
+ * Records are timestamped with the sample clock, i.e.: the number of frames
+ * rendered before the callback was issued. Records carrying a payload have the
+ * k_unit_trace_rec_payload bit set in their type, the payload size in bytes is
+ * then found in the value1 field. Payloads start 16-byte aligned, which allows
+ * audio payloads to be passed in place from a memory mapped trace.
+ *
+ */
+
+#ifndef UNIT_TRACE_H_
+#define UNIT_TRACE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UNIT_TRACE_MAGIC   (0x5254474CU)  // "LGTR"
+#define UNIT_TRACE_VERSION (1U)
+
+#define UNIT_TRACE_ALIGN          (16U)
+#define UNIT_TRACE_PAD(size)      (((size) + UNIT_TRACE_ALIGN - 1) & ~(UNIT_TRACE_ALIGN - 1))
+#define UNIT_TRACE_NAME_SIZE      (20)
+
+/**
+ * Trace capability flags.
+ */
+enum {
+  k_unit_trace_flags_none = 0U,
+  /** Render records carry the input buffer passed to unit_render() */
+  k_unit_trace_flag_input_audio = (1U << 0),
+};
+
+/**
+ * Trace header. Carries the non-pointer fields of unit_runtime_desc_t the unit was
+ * initialized with, and the identity of the traced unit.
+ */
+#pragma pack(push, 1)
+typedef struct unit_trace_header {
+  uint32_t magic;              /** UNIT_TRACE_MAGIC */
+  uint16_t version;            /** UNIT_TRACE_VERSION */
+  uint16_t header_size;        /** Size of this header, offset of the first record */
+  uint32_t flags;              /** See k_unit_trace_flag_* */
+  uint32_t target;             /** unit_runtime_desc_t::target */
+  uint32_t api;                /** unit_runtime_desc_t::api */
+  uint32_t samplerate;         /** unit_runtime_desc_t::samplerate */
+  uint16_t frames_per_buffer;  /** unit_runtime_desc_t::frames_per_buffer */
+  uint8_t  input_channels;     /** unit_runtime_desc_t::input_channels */
+  uint8_t  output_channels;    /** unit_runtime_desc_t::output_channels */
+  uint32_t dev_id;             /** unit_header_t::dev_id of the traced unit */
+  uint32_t unit_id;            /** unit_header_t::unit_id of the traced unit */
+  uint32_t unit_version;       /** unit_header_t::version of the traced unit */
+  uint32_t context_size;       /** Size of runtime context snapshots, 0 if none */
+  char     unit_name[UNIT_TRACE_NAME_SIZE]; /** unit_header_t::name of the traced unit */
+  uint8_t  reserved[16];       /** Keep to zero */
+} unit_trace_header_t;  // 80 bytes
+
+/**
+ * Callback record.
+ */
+typedef struct unit_trace_record {
+  uint32_t frame;   /** Sample clock: frames rendered before this callback */
+  uint8_t  type;    /** See k_unit_trace_rec_* */
+  uint8_t  arg0;    /** 8-bit argument (parameter index, note, velocity...) */
+  uint16_t arg1;    /** 16-bit argument (velocity, bend...) */
+  uint32_t value0;  /** 32-bit argument (parameter value, frames, tempo...) */
+  uint32_t value1;  /** 32-bit argument, or payload size for k_unit_trace_rec_payload records */
+} unit_trace_record_t;  // 16 bytes
+#pragma pack(pop)
+
+#ifdef __cplusplus
+static_assert(sizeof(unit_trace_header_t) % UNIT_TRACE_ALIGN == 0, "Header size must preserve record alignment");
+static_assert(sizeof(unit_trace_record_t) == UNIT_TRACE_ALIGN, "Record size must preserve payload alignment");
+#else
+_Static_assert(sizeof(unit_trace_header_t) % UNIT_TRACE_ALIGN == 0, "Header size must preserve record alignment");
+_Static_assert(sizeof(unit_trace_record_t) == UNIT_TRACE_ALIGN, "Record size must preserve payload alignment");
+#endif
+
+/**
+ * Record types.
+ */
+enum {
+  k_unit_trace_rec_payload = 0x80U,                                          /** Flag: record followed by a payload */
+
+  k_unit_trace_rec_init = 0x01U,                                             /** value0: unit_init() result */
+  k_unit_trace_rec_teardown,
+  k_unit_trace_rec_reset,
+  k_unit_trace_rec_resume,
+  k_unit_trace_rec_suspend,
+  k_unit_trace_rec_set_param_value,                                          /** arg0: index, value0: value */
+  k_unit_trace_rec_set_tempo,                                                /** value0: tempo */
+  k_unit_trace_rec_tempo_4ppqn_tick,                                         /** value0: counter */
+  k_unit_trace_rec_note_on,                                                  /** arg0: note, arg1: velocity */
+  k_unit_trace_rec_note_off,                                                 /** arg0: note */
+  k_unit_trace_rec_gate_on,                                                  /** arg0: velocity */
+  k_unit_trace_rec_gate_off,
+  k_unit_trace_rec_all_note_off,
+  k_unit_trace_rec_pitch_bend,                                               /** arg1: bend */
+  k_unit_trace_rec_channel_pressure,                                         /** arg0: pressure */
+  k_unit_trace_rec_aftertouch,                                               /** arg0: note, arg1: aftertouch */
+  k_unit_trace_rec_load_preset,                                              /** arg0: preset index */
+  k_unit_trace_rec_touch_event,                                              /** arg0: id, arg1: phase, value0: x, value1: y */
+
+  k_unit_trace_rec_render = k_unit_trace_rec_payload | 0x01U,                /** value0: frames, payload: input audio (optional) */
+  k_unit_trace_rec_set_param_values = k_unit_trace_rec_payload | 0x02U,      /** value0: mask, payload: values[] up to the highest index in mask */
+  k_unit_trace_rec_context = k_unit_trace_rec_payload | 0x03U,               /** payload: runtime context snapshot */
+};
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // UNIT_TRACE_H_
@@ -0,0 +1,50 @@
+/**
+ * @file unit_trace_shim.h
+ * @brief Callback renaming for trace recording builds
+ *
+ * Force-included (-include) in every translation unit of a unit built with
+ * TRACE=1, including _unit_base.c. The unit's callbacks are thus compiled
+ * under a prefixed name, and unit_trace_recorder.c provides the exported
+ * unit_* symbols the runtime resolves, recording each call before
+ * forwarding it.
+ *
+ * unit_header and unit_flags are left untouched.
+ *
+ */
+
+#ifndef UNIT_TRACE_SHIM_H_
+#define UNIT_TRACE_SHIM_H_
+
+#define UNIT_TRACE_TRACED(name) unit_traced_##name
+
+#ifndef UNIT_TRACE_RECORDER
+
+#define unit_init                 UNIT_TRACE_TRACED(unit_init)
+#define unit_teardown             UNIT_TRACE_TRACED(unit_teardown)
+#define unit_reset                UNIT_TRACE_TRACED(unit_reset)
+#define unit_resume               UNIT_TRACE_TRACED(unit_resume)
+#define unit_suspend              UNIT_TRACE_TRACED(unit_suspend)
+#define unit_render               UNIT_TRACE_TRACED(unit_render)
+#define unit_get_preset_index     UNIT_TRACE_TRACED(unit_get_preset_index)
+#define unit_get_preset_name      UNIT_TRACE_TRACED(unit_get_preset_name)
+#define unit_load_preset          UNIT_TRACE_TRACED(unit_load_preset)
+#define unit_get_param_value      UNIT_TRACE_TRACED(unit_get_param_value)
+#define unit_get_param_str_value  UNIT_TRACE_TRACED(unit_get_param_str_value)
+#define unit_get_param_bmp_value  UNIT_TRACE_TRACED(unit_get_param_bmp_value)
+#define unit_set_param_value      UNIT_TRACE_TRACED(unit_set_param_value)
+#define unit_set_param_values     UNIT_TRACE_TRACED(unit_set_param_values)
+#define unit_set_tempo            UNIT_TRACE_TRACED(unit_set_tempo)
+#define unit_tempo_4ppqn_tick     UNIT_TRACE_TRACED(unit_tempo_4ppqn_tick)
+#define unit_note_on              UNIT_TRACE_TRACED(unit_note_on)
+#define unit_note_off             UNIT_TRACE_TRACED(unit_note_off)
+#define unit_gate_on              UNIT_TRACE_TRACED(unit_gate_on)
+#define unit_gate_off             UNIT_TRACE_TRACED(unit_gate_off)
+#define unit_all_note_off         UNIT_TRACE_TRACED(unit_all_note_off)
+#define unit_pitch_bend           UNIT_TRACE_TRACED(unit_pitch_bend)
+#define unit_channel_pressure     UNIT_TRACE_TRACED(unit_channel_pressure)
+#define unit_aftertouch           UNIT_TRACE_TRACED(unit_aftertouch)
+#define unit_touch_event          UNIT_TRACE_TRACED(unit_touch_event)
+
+#endif  // UNIT_TRACE_RECORDER
+
+#endif  // UNIT_TRACE_SHIM_H_
@@ -0,0 +1,240 @@
+/**
+ * @file nts_api_stubs.c
+ * @brief Host implementations of the firmware symbols exported to NTS units
+ *
+ * Provides the lookup tables, wavetables and helper functions declared in
+ * osc_api.h and fx_api.h, so that units can be linked as host shared objects.
+ *
+ * Note: tables are generated at load time from their documented definitions
+ *       and are close to, but not bit-identical with, the firmware's. Output
+ *       of host renders is thus representative, not a reference; timings and
+ *       call sequences are what matters here.
+ *
+ * Note: linked into each unit shared object rather than the host, so that
+ *       separately loaded copies of a unit also get separate noise generator
+ *       states and remain deterministic.
+ *
+ */
+
+#include <math.h>
+#include <stdint.h>
+
+#include "runtime.h"
+
+#define STUB_PI (3.14159265358979323846)
+
+/*===========================================================================*/
+/* Emulated core state, see inc/arm_math.h */
+/*===========================================================================*/
+
+__thread uint32_t __host_apsr_ge = 0;
+
+/*===========================================================================*/
+/* Runtime environment */
+/*===========================================================================*/
+
+const uint32_t k_osc_api_platform = UNIT_TARGET_PLATFORM;
+const uint32_t k_osc_api_version = UNIT_API_VERSION;
+const uint32_t k_fx_api_platform = UNIT_TARGET_PLATFORM;
+const uint32_t k_fx_api_version = UNIT_API_VERSION;
+
+uint32_t osc_mcu_hash(void) { return 0x484F5354U; }  // "HOST"
+uint32_t fx_mcu_hash(void) { return 0x484F5354U; }
+
+static uint16_t s_bpm = 1200;
+
+/**
+ * Set the tempo reported by fx_get_bpm()/fx_get_bpmf().
+ *
+ * @param bpm Tempo in BPM multiplied by 10, as returned by fx_get_bpm().
+ */
+__attribute__((visibility("default"))) void unit_host_stub_set_bpm(uint16_t bpm) { s_bpm = bpm; }
+
+uint16_t fx_get_bpm(void) { return s_bpm; }
+float fx_get_bpmf(void) { return s_bpm * 0.1f; }
+
+/*===========================================================================*/
+/* Lookup tables */
+/*===========================================================================*/
+
+#define STUB_WT_SIZE       (128)
+#define STUB_WT_LUT_SIZE   (STUB_WT_SIZE + 1)
+#define STUB_WT_NOTES_CNT  (7)
+#define STUB_FUNC_LUT_SIZE (257)
+
+float midi_to_hz_lut_f[152];
+float wt_sine_lut_f[STUB_WT_LUT_SIZE];
+
+const uint8_t wt_saw_notes[STUB_WT_NOTES_CNT] = {54, 66, 78, 90, 102, 114, 126};
+const uint8_t wt_sqr_notes[STUB_WT_NOTES_CNT] = {54, 66, 78, 90, 102, 114, 126};
+const uint8_t wt_par_notes[STUB_WT_NOTES_CNT] = {54, 66, 78, 90, 102, 114, 126};
+float wt_saw_lut_f[STUB_WT_NOTES_CNT * STUB_WT_LUT_SIZE];
+float wt_sqr_lut_f[STUB_WT_NOTES_CNT * STUB_WT_LUT_SIZE];
+float wt_par_lut_f[STUB_WT_NOTES_CNT * STUB_WT_LUT_SIZE];
+
+float log_lut_f[STUB_FUNC_LUT_SIZE];
+float tanpi_lut_f[STUB_FUNC_LUT_SIZE];
+float sqrtm2log_lut_f[STUB_FUNC_LUT_SIZE];
+float pow2_lut_f[STUB_FUNC_LUT_SIZE];
+float cubicsat_lut_f[STUB_WT_LUT_SIZE];
+float schetzen_lut_f[STUB_WT_LUT_SIZE];
+float bitres_lut_f[STUB_WT_LUT_SIZE];
+
+/*===========================================================================*/
+/* Waves wavetables */
+/*===========================================================================*/
+
+#define STUB_WAVES_CNT (16 + 16 + 14 + 13 + 15 + 16)
+
+static float s_waves[STUB_WAVES_CNT][STUB_WT_LUT_SIZE];
+
+#define W(i) s_waves[i]
+const float * const wavesA[16] = {W(0), W(1), W(2), W(3), W(4), W(5), W(6), W(7),
+                                  W(8), W(9), W(10), W(11), W(12), W(13), W(14), W(15)};
+const float * const wavesB[16] = {W(16), W(17), W(18), W(19), W(20), W(21), W(22), W(23),
+                                  W(24), W(25), W(26), W(27), W(28), W(29), W(30), W(31)};
+const float * const wavesC[14] = {W(32), W(33), W(34), W(35), W(36), W(37), W(38),
+                                  W(39), W(40), W(41), W(42), W(43), W(44), W(45)};
+const float * const wavesD[13] = {W(46), W(47), W(48), W(49), W(50), W(51), W(52),
+                                  W(53), W(54), W(55), W(56), W(57), W(58)};
+const float * const wavesE[15] = {W(59), W(60), W(61), W(62), W(63), W(64), W(65), W(66),
+                                  W(67), W(68), W(69), W(70), W(71), W(72), W(73)};
+const float * const wavesF[16] = {W(74), W(75), W(76), W(77), W(78), W(79), W(80), W(81),
+                                  W(82), W(83), W(84), W(85), W(86), W(87), W(88), W(89)};
+#undef W
+
+/*===========================================================================*/
+/* Table generation */
+/*===========================================================================*/
+
+static uint32_t stub_hash(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7FEB352DU;
+  x ^= x >> 15;
+  x *= 0x846CA68BU;
+  x ^= x >> 16;
+  return x;
+}
+
+// Half-wave additive tables, the API negates and mirrors them for the second half period
+static void stub_fill_half_waves(float * lut, uint32_t kind) {
+  for (uint32_t t = 0; t < STUB_WT_NOTES_CNT; ++t) {
+    const uint32_t harmonics = 64U >> t;
+    float * wt = lut + t * STUB_WT_LUT_SIZE;
+    for (uint32_t i = 0; i < STUB_WT_LUT_SIZE; ++i) {
+      const double p = 0.5 * i / STUB_WT_SIZE;
+      double y = 0.;
+      for (uint32_t k = 1; k <= harmonics; ++k) {
+        const double s = sin(2. * STUB_PI * k * p);
+        switch (kind) {
+        case 0: y += s / k * (2. / STUB_PI); break;
+        case 1: if (k & 1) y += s / k * (4. / STUB_PI); break;
+        default: y += s / ((double)k * k) * (6. / (STUB_PI * STUB_PI)); break;
+        }
+      }
+      wt[i] = (float)y;
+    }
+  }
+}
+
+static void stub_fill_waves(void) {
+  for (uint32_t w = 0; w < STUB_WAVES_CNT; ++w) {
+    double amp[8];
+    for (uint32_t k = 0; k < 8; ++k)
+      amp[k] = (k == 0) ? 1. : (double)(stub_hash(w * 8 + k) & 0xFFFFU) / (65535. * (k + 1));
+
+    double peak = 0.;
+    for (uint32_t i = 0; i < STUB_WT_SIZE; ++i) {
+      double y = 0.;
+      for (uint32_t k = 0; k < 8; ++k)
+        y += amp[k] * sin(2. * STUB_PI * (k + 1) * i / STUB_WT_SIZE);
+      s_waves[w][i] = (float)y;
+      peak = fabs(y) > peak ? fabs(y) : peak;
+    }
+    for (uint32_t i = 0; i < STUB_WT_SIZE; ++i)
+      s_waves[w][i] = (float)(s_waves[w][i] / peak);
+    s_waves[w][STUB_WT_SIZE] = s_waves[w][0];
+  }
+}
+
+__attribute__((constructor)) static void stub_init_tables(void) {
+  for (uint32_t i = 0; i < 152; ++i) {
+    const double hz = 440. * pow(2., ((double)i - 69.) / 12.);
+    midi_to_hz_lut_f[i] = (float)(hz < 23679.643054 ? hz : 23679.643054);
+  }
+
+  for (uint32_t i = 0; i < STUB_WT_LUT_SIZE; ++i)
+    wt_sine_lut_f[i] = (float)sin(STUB_PI * i / STUB_WT_SIZE);
+
+  stub_fill_half_waves(wt_saw_lut_f, 0);
+  stub_fill_half_waves(wt_sqr_lut_f, 1);
+  stub_fill_half_waves(wt_par_lut_f, 2);
+  stub_fill_waves();
+
+  for (uint32_t i = 0; i < STUB_FUNC_LUT_SIZE; ++i) {
+    const double x = (double)i / (STUB_FUNC_LUT_SIZE - 1);
+    log_lut_f[i] = (float)log(x > 0.00001 ? x : 0.00001);
+    tanpi_lut_f[i] = (float)tan(STUB_PI * x * 0.49);
+    sqrtm2log_lut_f[i] = (float)sqrt(-2. * log(0.005 + x * 0.995));
+    pow2_lut_f[i] = (float)pow(2., x * 3.);
+  }
+
+  for (uint32_t i = 0; i < STUB_WT_LUT_SIZE; ++i) {
+    const double x = (double)i / STUB_WT_SIZE;
+    cubicsat_lut_f[i] = (float)(1.5 * x - 0.5 * x * x * x);
+    schetzen_lut_f[i] = (float)(2. * x / (1. + x));
+    bitres_lut_f[i] = (float)pow(2., pow(24., x));
+  }
+}
+
+/*===========================================================================*/
+/* Band-limited wave index */
+/*===========================================================================*/
+
+static float stub_bl_idx(float note) {
+  const float idx = (note - 54.f) * (1.f / 12.f);
+  return idx < 0.f ? 0.f : (idx > 6.f ? 6.f : idx);
+}
+
+float osc_bl_saw_idx(float note) { return stub_bl_idx(note); }
+float osc_bl_sqr_idx(float note) { return stub_bl_idx(note); }
+float osc_bl_par_idx(float note) { return stub_bl_idx(note); }
+
+/*===========================================================================*/
+/* Noise sources */
+/*===========================================================================*/
+
+static uint32_t s_rand_state = 1;
+
+// Park-Miller-Carta, as documented in osc_api.h
+static uint32_t stub_rand(void) {
+  uint32_t lo = 16807 * (s_rand_state & 0xFFFFU);
+  const uint32_t hi = 16807 * (s_rand_state >> 16);
+  lo += (hi & 0x7FFFU) << 16;
+  lo += hi >> 15;
+  lo = (lo & 0x7FFFFFFFU) + (lo >> 31);
+  s_rand_state = lo;
+  return lo;
+}
+
+static float stub_white(void) {
+  // Note: Irwin-Hall approximation of a gaussian, clipped to [-1, 1]
+  float sum = 0.f;
+  for (uint32_t i = 0; i < 4; ++i)
+    sum += stub_rand() * (1.f / 0x7FFFFFFF);
+  const float y = (sum - 2.f) * 0.5f;
+  return y < -1.f ? -1.f : (y > 1.f ? 1.f : y);
+}
+
+/**
+ * Restore noise generator and tempo to their initial state, for repeatable renders.
+ */
+__attribute__((visibility("default"))) void unit_host_stub_reset(void) {
+  s_rand_state = 1;
+  s_bpm = 1200;
+}
+
+uint32_t osc_rand(void) { return stub_rand(); }
+float osc_white(void) { return stub_white(); }
+uint32_t fx_rand(void) { return stub_rand(); }
+float fx_white(void) { return stub_white(); }
@@ -0,0 +1,673 @@
+/**
+ * @file payload_prof.cc
+ * @brief Instruction count profiler for legacy payloads
+ *
+ * Runs the payload.bin of a prologue, minilogue xd or NTS-1 unit (osc,
+ * modfx, delfx, revfx) under a Thumb-2 emulator, mapped at the link address
+ * of its linker script, and counts the instructions executed and memory
+ * accesses made by each call to its cycle/process hook.
+ *
+ * Firmware API symbols are resolved from the project's .syms file. Lookup
+ * tables are mapped zero filled, wave pointer tables pointing into them, and
+ * API functions (noise, band-limited indices, tempo...) are served by host
+ * implementations matching src/nts_api_stubs.c. Counts thus reflect the
+ * code paths taken with these inputs, not the content of firmware tables.
+ *
+ * Requires the unicorn engine library (2.x), which is not bundled: build
+ * with UNICORN=1, see README.md.
+ *
+ * Usage: payload-prof [options] <payload.bin>
+ *   -L <dir>        Project ld/ directory (default: ../ld or ./ld next to the payload)
+ *   -n <calls>      Number of cycle/process calls (default: 100)
+ *   -b <frames>     Frames per call (default: 64)
+ *   -N <note>       Oscillator note (default: 60)
+ *   -p <id>=<value> Set a parameter after initialization, can be repeated
+ *   -x <count>      Instruction limit per call (default: 10000000)
+ *
+ * Note: Emulation uses an A-profile core in Thumb state with VFP enabled, as
+ *       unicorn's M-profile support lacks a simple way to enable the FPU.
+ *       Units only use instructions common to both profiles. Counts are
+ *       instructions, not cycles: flash wait states, pipeline stalls and
+ *       FPU latencies of the Cortex-M4 are not modeled.
+ *
+ */
+
+#include <dirent.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#include <unicorn/unicorn.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+  /*===========================================================================*/
+  /* Legacy payload layout, see inc/userprg.h and inc/user*.h of each platform */
+  /*===========================================================================*/
+
+  enum Module { k_module_osc = 0, k_module_modfx, k_module_delfx, k_module_revfx, k_num_modules };
+
+  struct ModuleInfo {
+    char magic[5];
+    uint32_t module_id;  // k_user_module_*
+    const char * ld_name;
+    const char * syms_name;
+    uint32_t sram_org;  // Defaults, used without linker script
+    uint32_t sram_len;
+  };
+
+  constexpr ModuleInfo k_modules[k_num_modules] = {
+    {"UOSC", 4, "userosc.ld", "osc_api.syms", 0x20000000, 32 * 1024},
+    {"UMOD", 1, "usermodfx.ld", "main_api.syms", 0x20017800, 6 * 1024},
+    {"UDEL", 2, "userdelfx.ld", "main_api.syms", 0x20019000, 12 * 1024},
+    {"UREV", 3, "userrevfx.ld", "main_api.syms", 0x20019000, 12 * 1024},
+  };
+
+  // Hook table: magic[4], api, platform, reserved0[7], then function pointers
+  constexpr uint32_t k_hooks_api_offset = 4;
+  constexpr uint32_t k_hooks_platform_offset = 8;
+  constexpr uint32_t k_hooks_func_offset = 16;
+
+  // Function pointer slots after k_hooks_func_offset
+  enum { k_osc_entry = 0, k_osc_cycle, k_osc_on, k_osc_off, k_osc_mute, k_osc_value, k_osc_param };
+  enum { k_fx_entry = 0, k_fx_process, k_fx_suspend, k_fx_resume, k_fx_param };
+
+  constexpr uint32_t k_max_frames = 64;
+
+  // Wave pointer tables, see k_waves_*_cnt in inc/osc_api.h
+  struct WaveTable {
+    const char * name;
+    uint32_t count;
+  };
+
+  constexpr WaveTable k_wave_tables[] = {
+    {"wavesA", 16}, {"wavesB", 16}, {"wavesC", 14}, {"wavesD", 13}, {"wavesE", 15}, {"wavesF", 16},
+  };
+
+  /*===========================================================================*/
+  /* Emulator memory map */
+  /*===========================================================================*/
+
+  constexpr uint64_t k_page = 0x1000;
+
+  // Note: stands in for the firmware's stack, clear of SRAM, SDRAM and flash
+  constexpr uint32_t k_stack_base = 0x10000000;
+  constexpr uint32_t k_stack_size = 0x10000;
+
+  // Call arguments and buffers. Calls return to k_exit_addr, where emulation stops
+  constexpr uint32_t k_io_base = 0x30000000;
+  constexpr uint32_t k_io_size = 0x4000;
+  constexpr uint32_t k_exit_addr = k_io_base;
+  constexpr uint32_t k_params_addr = k_io_base + 0x100;
+  constexpr uint32_t k_main_in_addr = k_io_base + 0x1000;
+  constexpr uint32_t k_main_out_addr = k_io_base + 0x1800;
+  constexpr uint32_t k_sub_in_addr = k_io_base + 0x2000;
+  constexpr uint32_t k_sub_out_addr = k_io_base + 0x2800;
+
+  constexpr uint16_t k_thumb_bx_lr = 0x4770;
+
+  inline uint64_t page_floor(uint64_t addr) { return addr & ~(k_page - 1); }
+  inline uint64_t page_ceil(uint64_t addr) { return (addr + k_page - 1) & ~(k_page - 1); }
+
+  /*===========================================================================*/
+  /* Linker script and symbols */
+  /*===========================================================================*/
+
+  struct Region {
+    uint32_t org = 0;
+    uint32_t len = 0;
+  };
+
+  struct Symbol {
+    std::string name;
+    uint32_t addr;
+  };
+
+  struct LinkInfo {
+    Region sram;
+    Region sdram;
+    std::vector<Symbol> syms;
+
+    const Symbol * Find(const char * name) const {
+      for (const Symbol & s : syms) {
+        if (s.name == name)
+          return &s;
+      }
+      return nullptr;
+    }
+  };
+
+  /**
+   * Read the memory areas of a linker script, e.g.: "SRAM (rx) : org = 0x20000000, len = 32K".
+   */
+  bool read_linker_script(const std::string & path, LinkInfo & info) {
+    std::ifstream in(path);
+    if (!in)
+      return false;
+    std::string line;
+    while (std::getline(in, line)) {
+      char name[16];
+      uint32_t org, len;
+      char unit = 0;
+      if (std::sscanf(line.c_str(), " %15s (%*[^)]) : org = %" SCNx32 ", len = %" SCNu32 "%c", name, &org, &len, &unit) < 3)
+        continue;
+      if (unit == 'K')
+        len *= 1024;
+      else if (unit == 'M')
+        len *= 1024 * 1024;
+      if (std::strcmp(name, "SRAM") == 0)
+        info.sram = {org, len};
+      else if (std::strcmp(name, "SDRAM") == 0)
+        info.sdram = {org, len};
+    }
+    return info.sram.len != 0;
+  }
+
+  /**
+   * Read firmware API symbols, e.g.: "k_osc_api_version = 0x0800f000;".
+   */
+  bool read_syms(const std::string & path, LinkInfo & info) {
+    std::ifstream in(path);
+    if (!in)
+      return false;
+    std::string line;
+    while (std::getline(in, line)) {
+      char name[64];
+      uint32_t addr;
+      if (std::sscanf(line.c_str(), " %63s = 0x%" SCNx32, name, &addr) == 2)
+        info.syms.push_back({name, addr});
+    }
+    std::sort(info.syms.begin(), info.syms.end(), [](const Symbol & a, const Symbol & b) { return a.addr < b.addr; });
+    return !info.syms.empty();
+  }
+
+  /*===========================================================================*/
+  /* Counters */
+  /*===========================================================================*/
+
+  struct Counts {
+    uint64_t insns = 0;
+    uint64_t loads = 0;
+    uint64_t stores = 0;
+    uint64_t load_bytes = 0;
+    uint64_t store_bytes = 0;
+    uint64_t lut_loads = 0;    // Firmware tables
+    uint64_t stack_loads = 0;  // Stack, incl. spills
+    uint64_t stack_stores = 0;
+    uint64_t api_calls = 0;
+  };
+
+  struct CallStats {
+    const char * name;
+    uint32_t calls = 0;
+    uint64_t min_insns = UINT64_MAX;
+    uint64_t max_insns = 0;
+    Counts total;
+
+    explicit CallStats(const char * n) : name(n) {}
+
+    void Add(const Counts & c) {
+      ++calls;
+      min_insns = std::min(min_insns, c.insns);
+      max_insns = std::max(max_insns, c.insns);
+      total.insns += c.insns;
+      total.loads += c.loads;
+      total.stores += c.stores;
+      total.load_bytes += c.load_bytes;
+      total.store_bytes += c.store_bytes;
+      total.lut_loads += c.lut_loads;
+      total.stack_loads += c.stack_loads;
+      total.stack_stores += c.stack_stores;
+      total.api_calls += c.api_calls;
+    }
+  };
+
+  /*===========================================================================*/
+  /* Firmware API functions */
+  /*===========================================================================*/
+
+  struct Emulator;
+
+  struct Stub {
+    const char * name;
+    void (*fn)(Emulator &);
+    uint32_t addr;
+    uint64_t calls;
+  };
+
+  struct Emulator {
+    uc_engine * uc = nullptr;
+    Counts counts;
+    std::vector<Stub> stubs;
+    uint32_t api_begin = 0;
+    uint32_t api_end = 0;
+    uint32_t rand_state = 1;
+    uint16_t bpm = 1200;
+    bool faulted = false;
+
+    void WriteReg(int reg, uint32_t v) { uc_reg_write(uc, reg, &v); }
+
+    float ReadFloatArg() {
+      uint32_t bits = 0;
+      uc_reg_read(uc, UC_ARM_REG_S0, &bits);
+      float f;
+      std::memcpy(&f, &bits, sizeof(f));
+      return f;
+    }
+
+    void ReturnFloat(float f) {
+      uint32_t bits;
+      std::memcpy(&bits, &f, sizeof(bits));
+      uc_reg_write(uc, UC_ARM_REG_S0, &bits);
+    }
+
+    void ReturnInt(uint32_t v) { uc_reg_write(uc, UC_ARM_REG_R0, &v); }
+
+    // Park-Miller-Carta, as documented in osc_api.h and src/nts_api_stubs.c
+    uint32_t Rand() {
+      uint32_t lo = 16807 * (rand_state & 0xFFFFU);
+      const uint32_t hi = 16807 * (rand_state >> 16);
+      lo += (hi & 0x7FFFU) << 16;
+      lo += hi >> 15;
+      lo = (lo & 0x7FFFFFFFU) + (lo >> 31);
+      rand_state = lo;
+      return lo;
+    }
+
+    float White() {
+      float sum = 0.f;
+      for (uint32_t i = 0; i < 4; ++i)
+        sum += Rand() * (1.f / 0x7FFFFFFF);
+      const float y = (sum - 2.f) * 0.5f;
+      return y < -1.f ? -1.f : (y > 1.f ? 1.f : y);
+    }
+  };
+
+  void stub_mcu_hash(Emulator & emu) { emu.ReturnInt(0x484F5354U); }  // "HOST"
+  void stub_rand(Emulator & emu) { emu.ReturnInt(emu.Rand()); }
+  void stub_white(Emulator & emu) { emu.ReturnFloat(emu.White()); }
+  void stub_get_bpm(Emulator & emu) { emu.ReturnInt(emu.bpm); }
+  void stub_get_bpmf(Emulator & emu) { emu.ReturnFloat(emu.bpm * 0.1f); }
+
+  void stub_bl_idx(Emulator & emu) {
+    const float idx = (emu.ReadFloatArg() - 54.f) * (1.f / 12.f);
+    emu.ReturnFloat(idx < 0.f ? 0.f : (idx > 6.f ? 6.f : idx));
+  }
+
+  struct StubDef {
+    const char * name;
+    void (*fn)(Emulator &);
+  };
+
+  constexpr StubDef k_stub_defs[] = {
+    {"_osc_mcu_hash", stub_mcu_hash},     {"_osc_rand", stub_rand},         {"_osc_white", stub_white},
+    {"_osc_bl_saw_idx", stub_bl_idx},     {"_osc_bl_sqr_idx", stub_bl_idx}, {"_osc_bl_par_idx", stub_bl_idx},
+    {"_fx_mcu_hash", stub_mcu_hash},      {"_fx_rand", stub_rand},          {"_fx_white", stub_white},
+    {"_fx_get_bpm", stub_get_bpm},        {"_fx_get_bpmf", stub_get_bpmf},
+  };
+
+  /*===========================================================================*/
+  /* Hooks */
+  /*===========================================================================*/
+
+  void on_code(uc_engine * uc, uint64_t address, uint32_t size, void * user) {
+    Emulator & emu = *static_cast<Emulator *>(user);
+    ++emu.counts.insns;
+  }
+
+  // Note: only registered over the firmware API range
+  void on_api_code(uc_engine * uc, uint64_t address, uint32_t size, void * user) {
+    Emulator & emu = *static_cast<Emulator *>(user);
+    for (Stub & s : emu.stubs) {
+      if (s.addr == address) {
+        ++s.calls;
+        ++emu.counts.api_calls;
+        s.fn(emu);
+        return;
+      }
+    }
+    std::fprintf(stderr, "error: call to unsupported firmware address 0x%08" PRIx64 "\n", address);
+    emu.faulted = true;
+    uc_emu_stop(uc);
+  }
+
+  void on_mem(uc_engine * uc, uc_mem_type type, uint64_t address, int size, int64_t value, void * user) {
+    Emulator & emu = *static_cast<Emulator *>(user);
+    const bool stack = address >= k_stack_base && address < k_stack_base + k_stack_size;
+    if (type == UC_MEM_READ) {
+      ++emu.counts.loads;
+      emu.counts.load_bytes += size;
+      if (address >= emu.api_begin && address < emu.api_end)
+        ++emu.counts.lut_loads;
+      else if (stack)
+        ++emu.counts.stack_loads;
+    } else {
+      ++emu.counts.stores;
+      emu.counts.store_bytes += size;
+      if (stack)
+        ++emu.counts.stack_stores;
+    }
+  }
+
+  bool on_invalid(uc_engine * uc, uc_mem_type type, uint64_t address, int size, int64_t value, void * user) {
+    Emulator & emu = *static_cast<Emulator *>(user);
+    uint32_t pc = 0;
+    uc_reg_read(uc, UC_ARM_REG_PC, &pc);
+    const char * what = (type == UC_MEM_WRITE_UNMAPPED || type == UC_MEM_WRITE_PROT) ? "write"
+                        : (type == UC_MEM_FETCH_UNMAPPED || type == UC_MEM_FETCH_PROT) ? "fetch"
+                                                                                      : "read";
+    std::fprintf(stderr, "error: invalid %d byte %s at 0x%08" PRIx64 ", pc 0x%08" PRIx32 "\n", size, what, address, pc);
+    emu.faulted = true;
+    return false;
+  }
+
+  /*===========================================================================*/
+  /* Calls */
+  /*===========================================================================*/
+
+  struct Config {
+    const char * payload_path = nullptr;
+    const char * ld_path = nullptr;
+    uint32_t calls = 100;
+    uint32_t frames = 64;
+    int note = 60;
+    uint64_t insn_limit = 10000000;
+    std::vector<std::pair<uint32_t, int32_t>> params;
+  };
+
+  /**
+   * Call a payload function with up to 4 register arguments and optional stack arguments.
+   *
+   * @return False on emulation error, fault or instruction limit.
+   */
+  bool call(Emulator & emu, const Config & cfg, uint32_t func, std::initializer_list<uint32_t> args,
+            std::initializer_list<uint32_t> stack_args, Counts & counts) {
+    static const int k_arg_regs[] = {UC_ARM_REG_R0, UC_ARM_REG_R1, UC_ARM_REG_R2, UC_ARM_REG_R3};
+    size_t i = 0;
+    for (uint32_t a : args)
+      emu.WriteReg(k_arg_regs[i++], a);
+
+    uint32_t sp = k_stack_base + k_stack_size - 64;
+    uint32_t offset = 0;
+    for (uint32_t a : stack_args) {
+      uc_mem_write(emu.uc, sp + offset, &a, sizeof(a));
+      offset += sizeof(a);
+    }
+    emu.WriteReg(UC_ARM_REG_SP, sp);
+    emu.WriteReg(UC_ARM_REG_LR, k_exit_addr | 1);
+
+    emu.counts = Counts();
+    emu.faulted = false;
+    const uc_err err = uc_emu_start(emu.uc, func | 1, k_exit_addr, 0, cfg.insn_limit);
+    counts = emu.counts;
+    if (err != UC_ERR_OK) {
+      std::fprintf(stderr, "error: emulation of 0x%08" PRIx32 " failed: %s\n", func, uc_strerror(err));
+      return false;
+    }
+    if (emu.faulted)
+      return false;
+
+    uint32_t pc = 0;
+    uc_reg_read(emu.uc, UC_ARM_REG_PC, &pc);
+    if ((pc & ~1U) != k_exit_addr) {
+      std::fprintf(stderr, "error: 0x%08" PRIx32 " did not return within %" PRIu64 " instructions\n", func,
+                   cfg.insn_limit);
+      return false;
+    }
+    return true;
+  }
+
+  void print_stats(const CallStats & s, uint32_t frames) {
+    if (s.calls == 0)
+      return;
+    const double n = s.calls;
+    const Counts & t = s.total;
+    std::printf("%-8s %6u calls  insns min %" PRIu64 " mean %.0f max %" PRIu64, s.name, s.calls, s.min_insns,
+                t.insns / n, s.max_insns);
+    if (frames)
+      std::printf(" (%.1f/frame)", t.insns / n / frames);
+    std::printf("\n");
+    std::printf("%-8s %6s        loads %.0f (%.0f B, %.0f table, %.0f stack)  stores %.0f (%.0f B, %.0f stack)",
+                "", "", t.loads / n, t.load_bytes / n, t.lut_loads / n, t.stack_loads / n, t.stores / n,
+                t.store_bytes / n, t.stack_stores / n);
+    if (t.api_calls)
+      std::printf("  api calls %.1f", t.api_calls / n);
+    std::printf("\n");
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "usage: payload-prof [-L ld/] [-n calls] [-b frames] [-N note] [-p id=value]... [-x insns] "
+                 "<payload.bin>\n");
+  }
+
+  std::string default_ld_dir(const char * payload_path) {
+    std::vector<char> path(payload_path, payload_path + std::strlen(payload_path) + 1);
+    const std::string dir = dirname(path.data());
+    for (const char * rel : {"/../ld", "/ld"}) {
+      const std::string candidate = dir + rel;
+      DIR * d = opendir(candidate.c_str());
+      if (d) {
+        closedir(d);
+        return candidate;
+      }
+    }
+    return std::string();
+  }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+  Config cfg;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "L:n:b:N:p:x:")) != -1) {
+    switch (opt) {
+    case 'L': cfg.ld_path = optarg; break;
+    case 'n': cfg.calls = (uint32_t)std::atoi(optarg); break;
+    case 'b': cfg.frames = (uint32_t)std::atoi(optarg); break;
+    case 'N': cfg.note = std::atoi(optarg); break;
+    case 'x': cfg.insn_limit = std::strtoull(optarg, nullptr, 0); break;
+    case 'p': {
+      unsigned id;
+      int value;
+      if (std::sscanf(optarg, "%u=%d", &id, &value) != 2) {
+        usage();
+        return 1;
+      }
+      cfg.params.emplace_back(id, (int32_t)value);
+    } break;
+    default: usage(); return 1;
+    }
+  }
+  if (argc - optind != 1 || cfg.frames == 0 || cfg.frames > k_max_frames || cfg.note < 0 || cfg.note > 151) {
+    usage();
+    return 1;
+  }
+  cfg.payload_path = argv[optind];
+
+  // Payload
+  std::ifstream in(cfg.payload_path, std::ios::binary);
+  std::vector<uint8_t> payload((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (payload.size() < k_hooks_func_offset + 8 * sizeof(uint32_t)) {
+    std::fprintf(stderr, "error: %s: not a payload\n", cfg.payload_path);
+    return 1;
+  }
+  int module = -1;
+  for (int m = 0; m < k_num_modules; ++m) {
+    if (std::memcmp(payload.data(), k_modules[m].magic, 4) == 0)
+      module = m;
+  }
+  if (module < 0) {
+    std::fprintf(stderr, "error: %s: unknown hook table magic, expected a payload.bin or <project>.bin\n",
+                 cfg.payload_path);
+    return 1;
+  }
+  const ModuleInfo & info = k_modules[module];
+  auto hook = [&](uint32_t slot) {
+    uint32_t addr;
+    std::memcpy(&addr, payload.data() + k_hooks_func_offset + slot * sizeof(uint32_t), sizeof(addr));
+    return addr;
+  };
+  uint32_t api;
+  std::memcpy(&api, payload.data() + k_hooks_api_offset, sizeof(api));
+  const uint32_t platform = (uint32_t)payload[k_hooks_platform_offset] << 8 | info.module_id;
+
+  // Link address and firmware API
+  LinkInfo link;
+  const std::string ld_dir = cfg.ld_path ? std::string(cfg.ld_path) : default_ld_dir(cfg.payload_path);
+  if (ld_dir.empty() || !read_linker_script(ld_dir + "/" + info.ld_name, link)) {
+    std::fprintf(stderr, "warning: no %s found, using default link address\n", info.ld_name);
+    link.sram = {info.sram_org, info.sram_len};
+  }
+  if (ld_dir.empty() || !read_syms(ld_dir + "/" + info.syms_name, link))
+    std::fprintf(stderr, "warning: no %s found, firmware API calls will fault\n", info.syms_name);
+  if (payload.size() > link.sram.len) {
+    std::fprintf(stderr, "error: payload is %zu bytes, exceeds %u bytes of SRAM\n", payload.size(), link.sram.len);
+    return 1;
+  }
+
+  Emulator emu;
+  uc_err err = uc_open(UC_ARCH_ARM, UC_MODE_THUMB, &emu.uc);
+  if (err != UC_ERR_OK) {
+    std::fprintf(stderr, "error: uc_open: %s\n", uc_strerror(err));
+    return 1;
+  }
+
+  // Enable VFP: full access to cp10/cp11, FPEXC.EN
+  emu.WriteReg(UC_ARM_REG_C1_C0_2, 0xFU << 20);
+  emu.WriteReg(UC_ARM_REG_FPEXC, 1U << 30);
+
+  const uint64_t sram_base = page_floor(link.sram.org);
+  uc_mem_map(emu.uc, sram_base, page_ceil(link.sram.org + link.sram.len) - sram_base, UC_PROT_ALL);
+  uc_mem_write(emu.uc, link.sram.org, payload.data(), payload.size());
+  if (link.sdram.len) {
+    const uint64_t sdram_base = page_floor(link.sdram.org);
+    uc_mem_map(emu.uc, sdram_base, page_ceil(link.sdram.org + link.sdram.len) - sdram_base,
+               UC_PROT_READ | UC_PROT_WRITE);
+  }
+  uc_mem_map(emu.uc, k_stack_base, k_stack_size, UC_PROT_READ | UC_PROT_WRITE);
+  uc_mem_map(emu.uc, k_io_base, k_io_size, UC_PROT_ALL);
+
+  if (!link.syms.empty()) {
+    emu.api_begin = (uint32_t)page_floor(link.syms.front().addr);
+    emu.api_end = (uint32_t)page_ceil(link.syms.back().addr + 4);
+    uc_mem_map(emu.uc, emu.api_begin, emu.api_end - emu.api_begin, UC_PROT_READ | UC_PROT_EXEC);
+
+    for (const StubDef & def : k_stub_defs) {
+      const Symbol * s = link.Find(def.name);
+      if (!s)
+        continue;
+      const uint32_t addr = s->addr & ~1U;
+      uc_mem_write(emu.uc, addr, &k_thumb_bx_lr, sizeof(k_thumb_bx_lr));
+      emu.stubs.push_back({def.name, def.fn, addr, 0});
+    }
+    for (const WaveTable & t : k_wave_tables) {
+      const Symbol * s = link.Find(t.name);
+      if (!s)
+        continue;
+      // Note: entries point past the table, at zero filled (or unrelated) table data
+      const uint32_t data = s->addr + t.count * sizeof(uint32_t);
+      for (uint32_t i = 0; i < t.count; ++i)
+        uc_mem_write(emu.uc, s->addr + i * sizeof(uint32_t), &data, sizeof(data));
+    }
+    uint32_t version = api;
+    for (const char * name : {"k_osc_api_version", "k_fx_api_version"}) {
+      if (const Symbol * s = link.Find(name))
+        uc_mem_write(emu.uc, s->addr, &version, sizeof(version));
+    }
+    for (const char * name : {"k_osc_api_platform", "k_fx_api_platform"}) {
+      if (const Symbol * s = link.Find(name))
+        uc_mem_write(emu.uc, s->addr, &platform, sizeof(platform));
+    }
+  }
+
+  uc_hook code_hook, api_hook, mem_hook, invalid_hook;
+  uc_hook_add(emu.uc, &code_hook, UC_HOOK_CODE, (void *)on_code, &emu, 1, 0);
+  if (emu.api_end > emu.api_begin)
+    uc_hook_add(emu.uc, &api_hook, UC_HOOK_CODE, (void *)on_api_code, &emu, emu.api_begin, emu.api_end - 1);
+  uc_hook_add(emu.uc, &mem_hook, UC_HOOK_MEM_READ | UC_HOOK_MEM_WRITE, (void *)on_mem, &emu, 1, 0);
+  uc_hook_add(emu.uc, &invalid_hook, UC_HOOK_MEM_INVALID, (void *)on_invalid, &emu, 1, 0);
+
+  std::printf("payload: %s, %zu bytes at 0x%08" PRIx32 ", %s, platform 0x%04" PRIx32 ", api 0x%06" PRIx32 "\n",
+              cfg.payload_path, payload.size(), link.sram.org, info.magic, platform, api);
+  std::printf("firmware api: %zu symbols, %zu host functions\n", link.syms.size(), emu.stubs.size());
+
+  CallStats init_stats("entry");
+  CallStats param_stats("param");
+  CallStats render_stats(module == k_module_osc ? "cycle" : "process");
+  Counts counts;
+  bool ok = call(emu, cfg, hook(k_osc_entry), {platform, api}, {}, counts);
+  init_stats.Add(counts);
+
+  if (module == k_module_osc) {
+    // user_osc_param_t: shape_lfo, pitch, cutoff, resonance, reserved0[3]
+    uint8_t osc_params[16] = {0};
+    const uint16_t pitch = (uint16_t)(cfg.note << 8), cutoff = 0x1fff, resonance = 0;
+    std::memcpy(osc_params + 4, &pitch, 2);
+    std::memcpy(osc_params + 6, &cutoff, 2);
+    std::memcpy(osc_params + 8, &resonance, 2);
+    uc_mem_write(emu.uc, k_params_addr, osc_params, sizeof(osc_params));
+
+    // Note: shape (6) and shift-shape (7) are set through func_param too
+    for (const auto & p : cfg.params) {
+      ok = ok && call(emu, cfg, hook(k_osc_param), {p.first & 0xFFFF, (uint32_t)p.second & 0xFFFF}, {}, counts);
+      param_stats.Add(counts);
+    }
+    ok = ok && call(emu, cfg, hook(k_osc_on), {k_params_addr}, {}, counts);
+    for (uint32_t i = 0; ok && i < cfg.calls; ++i) {
+      ok = call(emu, cfg, hook(k_osc_cycle), {k_params_addr, k_main_out_addr, cfg.frames}, {}, counts);
+      render_stats.Add(counts);
+    }
+  } else {
+    for (const auto & p : cfg.params) {
+      ok = ok && call(emu, cfg, hook(k_fx_param), {p.first, (uint32_t)p.second}, {}, counts);
+      param_stats.Add(counts);
+    }
+    ok = ok && call(emu, cfg, hook(k_fx_resume), {}, {}, counts);
+
+    // Interleaved stereo input, white noise as a stand-in for audio
+    std::vector<float> input(2 * k_max_frames);
+    for (float & x : input)
+      x = emu.White() * 0.5f;
+    for (uint32_t i = 0; ok && i < cfg.calls; ++i) {
+      if (module == k_module_modfx) {
+        uc_mem_write(emu.uc, k_main_in_addr, input.data(), input.size() * sizeof(float));
+        uc_mem_write(emu.uc, k_sub_in_addr, input.data(), input.size() * sizeof(float));
+        ok = call(emu, cfg, hook(k_fx_process), {k_main_in_addr, k_main_out_addr, k_sub_in_addr, k_sub_out_addr},
+                  {cfg.frames}, counts);
+      } else {
+        // Note: delfx and revfx process in place
+        uc_mem_write(emu.uc, k_main_in_addr, input.data(), input.size() * sizeof(float));
+        ok = call(emu, cfg, hook(k_fx_process), {k_main_in_addr, cfg.frames}, {}, counts);
+      }
+      render_stats.Add(counts);
+    }
+  }
+
+  std::printf("\n");
+  print_stats(init_stats, 0);
+  print_stats(param_stats, 0);
+  print_stats(render_stats, cfg.frames);
+
+  bool listed = false;
+  for (const Stub & s : emu.stubs) {
+    if (s.calls == 0)
+      continue;
+    if (!listed)
+      std::printf("\napi calls:\n");
+    listed = true;
+    std::printf("  %-16s %10" PRIu64 "\n", s.name, s.calls);
+  }
+
+  uc_close(emu.uc);
+  return ok ? 0 : 1;
+}
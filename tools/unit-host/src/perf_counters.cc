@@ -0,0 +1,150 @@
+/**
+ * @file perf_counters.cc
+ * @brief Hardware performance counters around unit callbacks (Linux perf_event)
+ *
+ */
+
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace unit_host {
+
+  namespace {
+
+    struct CounterDesc {
+      uint32_t type;
+      uint64_t config;
+      const char * name;
+    };
+
+    constexpr CounterDesc k_counters[k_perf_counter_count] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+      {PERF_TYPE_HW_CACHE,
+       PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+       "l1d_misses"},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch_misses"},
+    };
+
+    int perf_event_open(const CounterDesc & desc, int group_fd) {
+      struct perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = desc.type;
+      attr.config = desc.config;
+      attr.disabled = (group_fd < 0) ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      return (int)syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1, group_fd, 0);
+    }
+
+  }  // namespace
+
+  bool PerfCounters::Open(std::string & error) {
+    Close();
+
+    // Note: first counter that opens leads the group, e.g.: cycles are often missing in virtual machines
+    int err = 0;
+    for (int c = 0; c < k_perf_counter_count; ++c) {
+      fds_[c] = perf_event_open(k_counters[c], leader_);
+      if (fds_[c] < 0) {
+        err = err ? err : errno;
+        continue;
+      }
+      if (leader_ < 0)
+        leader_ = fds_[c];
+      slot_[c] = count_++;
+    }
+
+    if (leader_ < 0) {
+      // Note: no counter at all is not an error on hosts without a PMU, all counters then read n/a
+      if (err != EACCES && err != EPERM)
+        return true;
+      error = std::string("perf_event_open: ") + std::strerror(err)
+              + " (check /proc/sys/kernel/perf_event_paranoid)";
+      return false;
+    }
+
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+  }
+
+  void PerfCounters::Close() {
+    for (int c = k_perf_counter_count; c-- > 0;) {
+      if (fds_[c] >= 0)
+        close(fds_[c]);
+      fds_[c] = -1;
+      slot_[c] = -1;
+    }
+    leader_ = -1;
+    count_ = 0;
+    multiplexed_ = false;
+  }
+
+  void PerfCounters::Read(PerfSample & sample) const {
+    // Note: layout is { nr, time_enabled, time_running, values[nr] }
+    uint64_t buf[3 + k_perf_counter_count] = {0};
+    if (leader_ < 0 || read(leader_, buf, sizeof(uint64_t) * (3 + count_)) <= 0) {
+      sample = PerfSample();
+      return;
+    }
+    sample.enabled = buf[1];
+    sample.running = buf[2];
+    for (int c = 0; c < k_perf_counter_count; ++c)
+      sample.values[c] = (slot_[c] >= 0) ? buf[3 + slot_[c]] : 0;
+  }
+
+  void PerfCounters::Delta(const PerfSample & from, const PerfSample & to,
+                           uint64_t (&delta)[k_perf_counter_count]) const {
+    // Note: raw deltas first, scaling cumulative counts by a ratio that changes between reads
+    //       can make a later read smaller than an earlier one
+    const uint64_t enabled = to.enabled - from.enabled;
+    const uint64_t running = to.running - from.running;
+    // Note: group was not always scheduled on the PMU in between, scale counts to the enabled time
+    const bool scaled = running && running < enabled;
+    multiplexed_ |= scaled;
+    for (int c = 0; c < k_perf_counter_count; ++c) {
+      const uint64_t d = (to.values[c] > from.values[c]) ? to.values[c] - from.values[c] : 0;
+      delta[c] = scaled ? (uint64_t)((double)d * enabled / running) : d;
+    }
+  }
+
+  const char * PerfCounters::Name(PerfCounter c) {
+    return k_counters[c].name;
+  }
+
+  /*===========================================================================*/
+  /* Distribution */
+  /*===========================================================================*/
+
+  void PerfDistribution::Add(const uint64_t (&delta)[k_perf_counter_count]) {
+    for (int c = 0; c < k_perf_counter_count; ++c) {
+      samples_[c].push_back(delta[c]);
+      sums_[c] += delta[c];
+    }
+  }
+
+  uint64_t PerfDistribution::Quantile(PerfCounter c, double q) {
+    std::vector<uint64_t> & s = samples_[c];
+    if (s.empty())
+      return 0;
+    const size_t k = std::min(s.size() - 1, (size_t)(q * (s.size() - 1) + 0.5));
+    std::nth_element(s.begin(), s.begin() + k, s.end());
+    return s[k];
+  }
+
+  double PerfDistribution::Mean(PerfCounter c) const {
+    return samples_[c].empty() ? 0. : (double)sums_[c] / samples_[c].size();
+  }
+
+}  // namespace unit_host
@@ -0,0 +1,103 @@
+/**
+ * @file perf_counters.h
+ * @brief Hardware performance counters around unit callbacks (Linux perf_event)
+ *
+ * Counts user space events of the calling thread only. Counters the host does
+ * not support (e.g.: in virtual machines) are skipped, see available(). When
+ * the kernel multiplexes the group with other events, counts are scaled to the
+ * time the group was enabled, see multiplexed().
+ * Requires /proc/sys/kernel/perf_event_paranoid <= 2, or CAP_PERFMON.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace unit_host {
+
+  enum PerfCounter {
+    k_perf_cycles = 0,
+    k_perf_instructions,
+    k_perf_l1d_misses,
+    k_perf_branch_misses,
+    k_perf_counter_count,
+  };
+
+  /**
+   * Raw group read: cumulative counts, and times the group was enabled and running.
+   */
+  struct PerfSample {
+    uint64_t values[k_perf_counter_count] = {0};
+    uint64_t enabled = 0;
+    uint64_t running = 0;
+  };
+
+  class PerfCounters {
+   public:
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters & operator=(const PerfCounters &) = delete;
+    ~PerfCounters() { Close(); }
+
+    /**
+     * Open and enable counters for the calling thread.
+     *
+     * @return False if counters are not permitted, true otherwise even if the host supports none.
+     */
+    bool Open(std::string & error);
+
+    void Close();
+
+    inline bool is_open() const { return leader_ >= 0; }
+    inline bool available(PerfCounter c) const { return slot_[c] >= 0; }
+
+    /**
+     * @return True if a read found the group multiplexed, i.e.: counts are estimates.
+     */
+    inline bool multiplexed() const { return multiplexed_; }
+
+    /**
+     * Read current raw counts. Unavailable counters read as zero.
+     */
+    void Read(PerfSample & sample) const;
+
+    /**
+     * Counts between two reads, scaled to the enabled time if the group was multiplexed in between.
+     */
+    void Delta(const PerfSample & from, const PerfSample & to, uint64_t (&delta)[k_perf_counter_count]) const;
+
+    static const char * Name(PerfCounter c);
+
+   private:
+    int leader_ = -1;
+    int fds_[k_perf_counter_count] = {-1, -1, -1, -1};
+    int slot_[k_perf_counter_count] = {-1, -1, -1, -1};  // Position in group reads, -1 if unavailable
+    int count_ = 0;
+    mutable bool multiplexed_ = false;
+  };
+
+  /**
+   * Per-block distribution of counter deltas.
+   */
+  class PerfDistribution {
+   public:
+    void Add(const uint64_t (&delta)[k_perf_counter_count]);
+
+    inline size_t blocks() const { return samples_[0].size(); }
+
+    /**
+     * @param q Quantile in [0, 1], e.g.: 0.99.
+     */
+    uint64_t Quantile(PerfCounter c, double q);
+    double Mean(PerfCounter c) const;
+
+   private:
+    std::vector<uint64_t> samples_[k_perf_counter_count];
+    uint64_t sums_[k_perf_counter_count] = {0};
+  };
+
+}  // namespace unit_host
@@ -0,0 +1,490 @@
+/**
+ * @file rt_check.c
+ * @brief Realtime safety checker, preloaded into host tools
+ *
+ * Interposes memory allocation, locking and blocking system calls, and
+ * reports calls issued while a realtime unit callback (unit_render(), note
+ * and gate callbacks...) is on the calling thread's stack, with a backtrace.
+ * Each distinct call site is reported once.
+ *
+ * Usage: LD_PRELOAD=build/<platform>/librtcheck.so <tool> [args]
+ *
+ * Environment:
+ *   UNIT_RTCHECK_FUNCS  Comma separated callbacks to check (default: see k_default_funcs)
+ *   UNIT_RTCHECK_MAX    Maximum number of distinct call sites reported (default: 20)
+ *   UNIT_RTCHECK_ABORT  If set to 1, abort() on the first violation, e.g.: under a debugger
+ *
+ * Note: callbacks are recognized by walking the stack and matching return
+ *       addresses against the unit's exported symbols, so the unit must be
+ *       built with unwind information (default on Linux targets) and export
+ *       its callbacks (which runtimes require anyway). Calls a callback
+ *       makes in tail position leave no trace of it on the stack, and are
+ *       missed. C++ operator new and delete are caught through the allocator
+ *       functions they call.
+ *
+ * Note: allocation wrappers forward to glibc's __libc_* entry points, so
+ *       that no allocation is ever needed to resolve them.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <link.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RTCHECK_MAX_FRAMES (48)
+#define RTCHECK_MAX_FUNCS  (32)
+#define RTCHECK_MAX_SITES  (256)
+#define RTCHECK_NAME_SIZE  (32)
+
+static const char * const k_default_funcs =
+  "unit_render,unit_note_on,unit_note_off,unit_all_note_off,unit_pitch_bend,unit_channel_pressure,"
+  "unit_aftertouch,unit_gate_on,unit_gate_off,unit_tempo_4ppqn_tick,unit_touch_event";
+
+/*===========================================================================*/
+/* State */
+/*===========================================================================*/
+
+static struct {
+  char funcs[RTCHECK_MAX_FUNCS][RTCHECK_NAME_SIZE];
+  uint32_t func_count;
+  uint32_t max_reports;
+  int abort_on_violation;
+
+  pthread_mutex_t lock;  // Guards the fields below
+  uint64_t sites[RTCHECK_MAX_SITES];  // Hashes of reported backtraces
+  uint32_t site_count;
+  uint64_t violations;
+  int ready;
+} s_check = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// Note: set while checking or reporting, calls made by the checker itself are not checked
+static __thread int s_in_check;
+
+extern void * __libc_malloc(size_t);
+extern void * __libc_calloc(size_t, size_t);
+extern void * __libc_realloc(void *, size_t);
+extern void * __libc_memalign(size_t, size_t);
+extern void __libc_free(void *);
+
+/*===========================================================================*/
+/* Checks */
+/*===========================================================================*/
+
+/**
+ * @return Name of the checked callback containing pc, or NULL.
+ */
+static const char * checked_func(void * pc) {
+  Dl_info info;
+  const ElfW(Sym) * sym = NULL;
+  // Note: return addresses point past the call, which may be the function's end
+  const uintptr_t addr = (uintptr_t)pc - 1;
+  if (!dladdr1((void *)addr, &info, (void **)&sym, RTLD_DL_SYMENT) || !info.dli_sname || !sym)
+    return NULL;
+  if (addr >= (uintptr_t)info.dli_saddr + sym->st_size)
+    return NULL;
+  for (uint32_t i = 0; i < s_check.func_count; ++i) {
+    if (!strcmp(info.dli_sname, s_check.funcs[i]))
+      return s_check.funcs[i];
+  }
+  return NULL;
+}
+
+static void print_frame(int index, void * pc) {
+  Dl_info info;
+  if (!dladdr(pc, &info))
+    fprintf(stderr, "  #%-2d %p\n", index, pc);
+  else if (info.dli_sname)
+    fprintf(stderr, "  #%-2d %p %s+0x%lx (%s)\n", index, pc, info.dli_sname,
+            (unsigned long)((uintptr_t)pc - (uintptr_t)info.dli_saddr), info.dli_fname);
+  else
+    fprintf(stderr, "  #%-2d %p (%s+0x%lx)\n", index, pc, info.dli_fname,
+            (unsigned long)((uintptr_t)pc - (uintptr_t)info.dli_fbase));
+}
+
+/**
+ * Classify allocator calls made on behalf of C++ operators.
+ */
+static const char * describe(const char * what, void * caller) {
+  Dl_info info;
+  if (!dladdr(caller, &info) || !info.dli_sname)
+    return what;
+  if (!strncmp(info.dli_sname, "_Znw", 4) || !strncmp(info.dli_sname, "_Zna", 4))
+    return "operator new";
+  if (!strncmp(info.dli_sname, "_Zdl", 4) || !strncmp(info.dli_sname, "_Zda", 4))
+    return "operator delete";
+  return what;
+}
+
+__attribute__((noinline)) static void check(const char * what) {
+  if (s_in_check || !s_check.ready)
+    return;
+  s_in_check = 1;
+
+  void * frames[RTCHECK_MAX_FRAMES];
+  const int count = backtrace(frames, RTCHECK_MAX_FRAMES);
+
+  // Note: frame 0 is this function, frame 1 the interposed function
+  const char * func = NULL;
+  for (int i = 2; i < count && !func; ++i)
+    func = checked_func(frames[i]);
+
+  if (func) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 2; i < count; ++i)
+      hash = (hash ^ (uintptr_t)frames[i]) * 0x100000001B3ULL;
+
+    pthread_mutex_lock(&s_check.lock);
+    ++s_check.violations;
+    int report = 0;
+    uint32_t i = 0;
+    while (i < s_check.site_count && s_check.sites[i] != hash)
+      ++i;
+    if (i == s_check.site_count && s_check.site_count < s_check.max_reports && i < RTCHECK_MAX_SITES) {
+      s_check.sites[s_check.site_count++] = hash;
+      report = 1;
+    }
+    if (report) {
+      fprintf(stderr, "rtcheck: %s called from %s\n", (count > 2) ? describe(what, frames[2]) : what, func);
+      for (int f = 2; f < count; ++f)
+        print_frame(f - 2, frames[f]);
+    }
+    pthread_mutex_unlock(&s_check.lock);
+
+    if (s_check.abort_on_violation)
+      abort();
+  }
+
+  s_in_check = 0;
+}
+
+__attribute__((constructor)) static void rtcheck_init(void) {
+  const char * funcs = getenv("UNIT_RTCHECK_FUNCS");
+  if (!funcs || !*funcs)
+    funcs = k_default_funcs;
+  while (*funcs && s_check.func_count < RTCHECK_MAX_FUNCS) {
+    size_t len = strcspn(funcs, ",");
+    if (len && len < RTCHECK_NAME_SIZE) {
+      memcpy(s_check.funcs[s_check.func_count], funcs, len);
+      s_check.funcs[s_check.func_count++][len] = '\0';
+    }
+    funcs += len + (funcs[len] == ',');
+  }
+
+  const char * max = getenv("UNIT_RTCHECK_MAX");
+  s_check.max_reports = max ? (uint32_t)atoi(max) : 20;
+  const char * abort_env = getenv("UNIT_RTCHECK_ABORT");
+  s_check.abort_on_violation = abort_env && !strcmp(abort_env, "1");
+
+  // Note: the first backtrace() call loads the unwinder, which allocates
+  void * frame;
+  s_in_check = 1;
+  backtrace(&frame, 1);
+  s_in_check = 0;
+
+  s_check.ready = 1;
+}
+
+__attribute__((destructor)) static void rtcheck_fini(void) {
+  s_in_check = 1;
+  fprintf(stderr, "rtcheck: %llu violation%s, %u distinct call site%s\n", (unsigned long long)s_check.violations,
+          (s_check.violations == 1) ? "" : "s", s_check.site_count, (s_check.site_count == 1) ? "" : "s");
+}
+
+/*===========================================================================*/
+/* Interposed functions */
+/*===========================================================================*/
+
+#define RTCHECK_REAL(name) \
+  static __typeof__(name) * real_##name;   \
+  if (!real_##name)                        \
+    real_##name = (__typeof__(name) *)dlsym(RTLD_NEXT, #name)
+
+// Memory allocation
+
+void * malloc(size_t size) {
+  check("malloc");
+  return __libc_malloc(size);
+}
+
+void * calloc(size_t n, size_t size) {
+  check("calloc");
+  return __libc_calloc(n, size);
+}
+
+void * realloc(void * ptr, size_t size) {
+  check("realloc");
+  return __libc_realloc(ptr, size);
+}
+
+void free(void * ptr) {
+  if (ptr)
+    check("free");
+  __libc_free(ptr);
+}
+
+void * memalign(size_t alignment, size_t size) {
+  check("memalign");
+  return __libc_memalign(alignment, size);
+}
+
+void * aligned_alloc(size_t alignment, size_t size) {
+  check("aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void ** ptr, size_t alignment, size_t size) {
+  check("posix_memalign");
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1)))
+    return 22;  // EINVAL
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : 12;  // ENOMEM
+}
+
+// Locks
+
+int pthread_mutex_lock(pthread_mutex_t * mutex) {
+  RTCHECK_REAL(pthread_mutex_lock);
+  check("pthread_mutex_lock");
+  return real_pthread_mutex_lock(mutex);
+}
+
+int pthread_mutex_trylock(pthread_mutex_t * mutex) {
+  RTCHECK_REAL(pthread_mutex_trylock);
+  check("pthread_mutex_trylock");
+  return real_pthread_mutex_trylock(mutex);
+}
+
+int pthread_mutex_unlock(pthread_mutex_t * mutex) {
+  RTCHECK_REAL(pthread_mutex_unlock);
+  check("pthread_mutex_unlock");
+  return real_pthread_mutex_unlock(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t * lock) {
+  RTCHECK_REAL(pthread_rwlock_rdlock);
+  check("pthread_rwlock_rdlock");
+  return real_pthread_rwlock_rdlock(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t * lock) {
+  RTCHECK_REAL(pthread_rwlock_wrlock);
+  check("pthread_rwlock_wrlock");
+  return real_pthread_rwlock_wrlock(lock);
+}
+
+int pthread_rwlock_unlock(pthread_rwlock_t * lock) {
+  RTCHECK_REAL(pthread_rwlock_unlock);
+  check("pthread_rwlock_unlock");
+  return real_pthread_rwlock_unlock(lock);
+}
+
+int sem_wait(sem_t * sem) {
+  RTCHECK_REAL(sem_wait);
+  check("sem_wait");
+  return real_sem_wait(sem);
+}
+
+int sem_post(sem_t * sem) {
+  RTCHECK_REAL(sem_post);
+  check("sem_post");
+  return real_sem_post(sem);
+}
+
+// Blocking system calls
+
+// Note: O_TMPFILE includes O_DIRECTORY, which alone takes no mode argument
+static inline int open_has_mode(int flags) {
+  return (flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE;
+}
+
+int open(const char * path, int flags, ...) {
+  RTCHECK_REAL(open);
+  check("open");
+  va_list ap;
+  va_start(ap, flags);
+  const mode_t mode = open_has_mode(flags) ? va_arg(ap, mode_t) : 0;
+  va_end(ap);
+  return real_open(path, flags, mode);
+}
+
+int open64(const char * path, int flags, ...) {
+  RTCHECK_REAL(open64);
+  check("open64");
+  va_list ap;
+  va_start(ap, flags);
+  const mode_t mode = open_has_mode(flags) ? va_arg(ap, mode_t) : 0;
+  va_end(ap);
+  return real_open64(path, flags, mode);
+}
+
+int openat(int dirfd, const char * path, int flags, ...) {
+  RTCHECK_REAL(openat);
+  check("openat");
+  va_list ap;
+  va_start(ap, flags);
+  const mode_t mode = open_has_mode(flags) ? va_arg(ap, mode_t) : 0;
+  va_end(ap);
+  return real_openat(dirfd, path, flags, mode);
+}
+
+int close(int fd) {
+  RTCHECK_REAL(close);
+  check("close");
+  return real_close(fd);
+}
+
+ssize_t read(int fd, void * buf, size_t count) {
+  RTCHECK_REAL(read);
+  check("read");
+  return real_read(fd, buf, count);
+}
+
+ssize_t write(int fd, const void * buf, size_t count) {
+  RTCHECK_REAL(write);
+  check("write");
+  return real_write(fd, buf, count);
+}
+
+int fsync(int fd) {
+  RTCHECK_REAL(fsync);
+  check("fsync");
+  return real_fsync(fd);
+}
+
+int poll(struct pollfd * fds, nfds_t nfds, int timeout) {
+  RTCHECK_REAL(poll);
+  check("poll");
+  return real_poll(fds, nfds, timeout);
+}
+
+int select(int nfds, fd_set * readfds, fd_set * writefds, fd_set * exceptfds, struct timeval * timeout) {
+  RTCHECK_REAL(select);
+  check("select");
+  return real_select(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+int nanosleep(const struct timespec * req, struct timespec * rem) {
+  RTCHECK_REAL(nanosleep);
+  check("nanosleep");
+  return real_nanosleep(req, rem);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec * req, struct timespec * rem) {
+  RTCHECK_REAL(clock_nanosleep);
+  check("clock_nanosleep");
+  return real_clock_nanosleep(clock, flags, req, rem);
+}
+
+int usleep(useconds_t usec) {
+  RTCHECK_REAL(usleep);
+  check("usleep");
+  return real_usleep(usec);
+}
+
+unsigned int sleep(unsigned int seconds) {
+  RTCHECK_REAL(sleep);
+  check("sleep");
+  return real_sleep(seconds);
+}
+
+int sched_yield(void) {
+  RTCHECK_REAL(sched_yield);
+  check("sched_yield");
+  return real_sched_yield();
+}
+
+// Note: stdio functions write through internal, non interposable calls
+
+FILE * fopen(const char * path, const char * mode) {
+  RTCHECK_REAL(fopen);
+  check("fopen");
+  return real_fopen(path, mode);
+}
+
+FILE * fopen64(const char * path, const char * mode) {
+  RTCHECK_REAL(fopen64);
+  check("fopen64");
+  return real_fopen64(path, mode);
+}
+
+int fclose(FILE * fp) {
+  RTCHECK_REAL(fclose);
+  check("fclose");
+  return real_fclose(fp);
+}
+
+size_t fread(void * ptr, size_t size, size_t n, FILE * fp) {
+  RTCHECK_REAL(fread);
+  check("fread");
+  return real_fread(ptr, size, n, fp);
+}
+
+size_t fwrite(const void * ptr, size_t size, size_t n, FILE * fp) {
+  RTCHECK_REAL(fwrite);
+  check("fwrite");
+  return real_fwrite(ptr, size, n, fp);
+}
+
+int fflush(FILE * fp) {
+  RTCHECK_REAL(fflush);
+  check("fflush");
+  return real_fflush(fp);
+}
+
+int puts(const char * s) {
+  RTCHECK_REAL(puts);
+  check("puts");
+  return real_puts(s);
+}
+
+int printf(const char * format, ...) {
+  check("printf");
+  va_list ap;
+  va_start(ap, format);
+  const int ret = vfprintf(stdout, format, ap);
+  va_end(ap);
+  return ret;
+}
+
+int fprintf(FILE * fp, const char * format, ...) {
+  check("fprintf");
+  va_list ap;
+  va_start(ap, format);
+  const int ret = vfprintf(fp, format, ap);
+  va_end(ap);
+  return ret;
+}
+
+// Note: _FORTIFY_SOURCE builds call the checked variants
+
+int __printf_chk(int flag, const char * format, ...) {
+  check("printf");
+  va_list ap;
+  va_start(ap, format);
+  const int ret = vfprintf(stdout, format, ap);
+  va_end(ap);
+  return ret;
+}
+
+int __fprintf_chk(FILE * fp, int flag, const char * format, ...) {
+  check("fprintf");
+  va_list ap;
+  va_start(ap, format);
+  const int ret = vfprintf(fp, format, ap);
+  va_end(ap);
+  return ret;
+}
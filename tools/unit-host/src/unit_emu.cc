@@ -0,0 +1,542 @@
+/**
+ * @file unit_emu.cc
+ * @brief drumlogue runtime emulator
+ *
+ * Loads a drumlogue unit shared object, validates its header the way the
+ * device runtime would, serves samples from local WAV folders, and renders
+ * from a SCHED_FIFO thread woken by an absolute timer every block, as the
+ * device's audio thread is. Reports render durations against the block
+ * deadline, deadline misses, and timer wake-up jitter.
+ *
+ * Built for the host, the emulator checks units for realtime behavior in
+ * isolation. Cross compiled (CROSS_COMPILE=arm-linux-gnueabihf-), it also
+ * runs on the drumlogue itself with its CPU frequency and caches.
+ *
+ * Usage: unit-emu [options] <unit.so>
+ *   -s <dir>        Sample banks: one subdirectory of WAV files per bank
+ *   -d <seconds>    Run length (default: 10)
+ *   -b <frames>     Frames per buffer (default: 64)
+ *   -P <priority>   SCHED_FIFO priority (default: 80)
+ *   -a <cpu>        Pin the audio thread to a CPU
+ *   -i <file>       Input audio, 48 kHz WAV, looped (default: silence)
+ *   -o <file>       Write rendered output as WAV
+ *   -p <id>=<value> Set a parameter before rendering, can be repeated
+ *   -n <note>[:vel] Send a note on and a gate on before rendering
+ *
+ * Note: SCHED_FIFO and mlockall() need CAP_SYS_NICE and CAP_IPC_LOCK (or a
+ *       suitable RLIMIT_RTPRIO/RLIMIT_MEMLOCK). Without them, the emulator
+ *       runs with the default policy and says so: deadline figures are then
+ *       only indicative.
+ *
+ */
+
+#include <elf.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "unit_host.h"
+#include "wav_file.h"
+
+using unit_host::Runtime;
+using unit_host::Unit;
+using unit_host::WavReader;
+using unit_host::WavWriter;
+
+namespace {
+
+  constexpr uint32_t k_emu_samplerate = 48000;
+  constexpr size_t k_listed_misses = 8;
+
+  struct Config {
+    const char * unit_path = nullptr;
+    const char * samples_path = nullptr;
+    const char * in_path = nullptr;
+    const char * out_path = nullptr;
+    double seconds = 10.;
+    uint16_t frames_per_buffer = 64;
+    int priority = 80;
+    int cpu = -1;
+    int note = -1;
+    int velocity = 100;
+    std::vector<std::pair<uint8_t, int32_t>> params;
+  };
+
+  void usage() {
+    std::fprintf(stderr,
+                 "usage: unit-emu [-s samples/] [-d seconds] [-b frames] [-P priority] [-a cpu] [-i in.wav] "
+                 "[-o out.wav] [-p id=value]... [-n note[:vel]] <unit.so>\n");
+  }
+
+  inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+  inline struct timespec to_timespec(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    return ts;
+  }
+
+  /*===========================================================================*/
+  /* Header validation */
+  /*===========================================================================*/
+
+  struct Validation {
+    int errors = 0;
+    int warnings = 0;
+
+    void Error(const char * what) {
+      std::printf("  error: %s\n", what);
+      ++errors;
+    }
+
+    void Warning(const char * what) {
+      std::printf("  warning: %s\n", what);
+      ++warnings;
+    }
+  };
+
+  /**
+   * Find the address range of a named section.
+   *
+   * @return False if the file is not an ELF object of this class, or lacks the section.
+   */
+  template <typename Ehdr, typename Shdr>
+  bool find_section(const uint8_t * data, size_t size, const char * name, uint64_t & addr, uint64_t & len) {
+    const Ehdr & eh = *reinterpret_cast<const Ehdr *>(data);
+    if (size < sizeof(Ehdr) || eh.e_shoff == 0 || eh.e_shentsize != sizeof(Shdr) || eh.e_shstrndx >= eh.e_shnum
+        || eh.e_shoff + (uint64_t)eh.e_shnum * sizeof(Shdr) > size)
+      return false;
+    const Shdr * sh = reinterpret_cast<const Shdr *>(data + eh.e_shoff);
+    const Shdr & strtab = sh[eh.e_shstrndx];
+    if (strtab.sh_offset + strtab.sh_size > size)
+      return false;
+    const char * names = reinterpret_cast<const char *>(data + strtab.sh_offset);
+    for (unsigned i = 0; i < eh.e_shnum; ++i) {
+      if (sh[i].sh_name < strtab.sh_size && std::strncmp(names + sh[i].sh_name, name, strtab.sh_size - sh[i].sh_name) == 0) {
+        addr = sh[i].sh_addr;
+        len = sh[i].sh_size;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Check that unit_header was placed in its own section, as the device's loader expects (see attributes.h).
+   */
+  void check_header_section(const Unit & unit, const char * path, Validation & v) {
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0)
+        close(fd);
+      v.Warning("cannot read shared object, header section not checked");
+      return;
+    }
+    void * map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+      v.Warning("cannot map shared object, header section not checked");
+      return;
+    }
+
+    const uint8_t * data = static_cast<const uint8_t *>(map);
+    uint64_t addr = 0, len = 0;
+    bool found = false;
+    if ((size_t)st.st_size > EI_CLASS && std::memcmp(data, ELFMAG, SELFMAG) == 0) {
+      found = (data[EI_CLASS] == ELFCLASS32) ? find_section<Elf32_Ehdr, Elf32_Shdr>(data, st.st_size, ".unit_header", addr, len)
+                                             : find_section<Elf64_Ehdr, Elf64_Shdr>(data, st.st_size, ".unit_header", addr, len);
+    }
+    munmap(map, st.st_size);
+
+    Dl_info info;
+    if (!found) {
+      v.Error("no .unit_header section, unit_header must be declared with __unit_header");
+    } else if (dladdr(unit.header, &info) && info.dli_fbase) {
+      const uint64_t offset = (uint64_t)((uintptr_t)unit.header - (uintptr_t)info.dli_fbase);
+      if (offset < addr || offset + sizeof(unit_header_t) > addr + len)
+        v.Error("unit_header is not located in the .unit_header section");
+    }
+  }
+
+  bool terminated(const char * s, size_t size) {
+    return std::memchr(s, '\0', size) != nullptr;
+  }
+
+  /**
+   * Validate the unit header, printing findings.
+   *
+   * @return False if the device would refuse to load the unit.
+   */
+  bool validate_header(const Unit & unit, const char * path) {
+    const unit_header_t & h = *unit.header;
+    Validation v;
+    char msg[128];
+
+    std::printf("header:\n");
+    check_header_section(unit, path, v);
+
+    if (h.header_size != sizeof(unit_header_t)) {
+      std::snprintf(msg, sizeof(msg), "header_size is %u, expected %zu", h.header_size, sizeof(unit_header_t));
+      v.Error(msg);
+    }
+    if (!UNIT_TARGET_PLATFORM_IS_COMPAT(h.target)) {
+      std::snprintf(msg, sizeof(msg), "target 0x%04x is not a drumlogue target", h.target);
+      v.Error(msg);
+    }
+    switch (h.target & UNIT_TARGET_MODULE_MASK) {
+    case k_unit_module_synth:
+    case k_unit_module_delfx:
+    case k_unit_module_revfx:
+    case k_unit_module_masterfx:
+      break;
+    default:
+      std::snprintf(msg, sizeof(msg), "module %u is not supported by drumlogue", h.target & UNIT_TARGET_MODULE_MASK);
+      v.Error(msg);
+    }
+    if (!UNIT_API_IS_COMPAT(h.api)) {
+      std::snprintf(msg, sizeof(msg), "API %u.%u.%u is not compatible with runtime API %u.%u.%u", UNIT_API_MAJOR(h.api),
+                    UNIT_API_MINOR(h.api), UNIT_API_PATCH(h.api), UNIT_API_MAJOR(UNIT_API_VERSION),
+                    UNIT_API_MINOR(UNIT_API_VERSION), UNIT_API_PATCH(UNIT_API_VERSION));
+      v.Error(msg);
+    }
+    if (!terminated(h.name, sizeof(h.name)))
+      v.Error("name is not NUL terminated");
+    else if (!h.name[0])
+      v.Warning("name is empty");
+    if (h.num_params > UNIT_MAX_PARAM_COUNT) {
+      std::snprintf(msg, sizeof(msg), "num_params is %u, at most %u are supported", h.num_params, UNIT_MAX_PARAM_COUNT);
+      v.Error(msg);
+    }
+
+    for (uint32_t i = 0; i < h.num_params && i < UNIT_MAX_PARAM_COUNT; ++i) {
+      const unit_param_t & p = h.params[i];
+      if (!terminated(p.name, sizeof(p.name))) {
+        std::snprintf(msg, sizeof(msg), "param %u: name is not NUL terminated", i);
+        v.Error(msg);
+        continue;
+      }
+      if (p.type >= k_num_unit_param_type) {
+        std::snprintf(msg, sizeof(msg), "param %u (%s): unknown type %u", i, p.name, p.type);
+        v.Error(msg);
+      }
+      if (p.min > p.max) {
+        std::snprintf(msg, sizeof(msg), "param %u (%s): min %d above max %d", i, p.name, p.min, p.max);
+        v.Error(msg);
+      } else if (p.init < p.min || p.init > p.max) {
+        std::snprintf(msg, sizeof(msg), "param %u (%s): default %d outside of [%d, %d]", i, p.name, p.init, p.min, p.max);
+        v.Warning(msg);
+      }
+    }
+
+    std::printf("  %.*s (%08x:%08x v%u.%u.%u), %u params, %u presets: %d error(s), %d warning(s)\n",
+                (int)sizeof(h.name), h.name, h.dev_id, h.unit_id, (h.version >> 16) & 0x7F, (h.version >> 8) & 0x7F,
+                h.version & 0x7F, h.num_params, h.num_presets, v.errors, v.warnings);
+    return v.errors == 0;
+  }
+
+  /*===========================================================================*/
+  /* Audio thread */
+  /*===========================================================================*/
+
+  struct AudioThread {
+    const Config * cfg = nullptr;
+    Unit * unit = nullptr;
+    uint16_t in_ch = 0;
+    uint16_t out_ch = 0;
+    size_t blocks = 0;
+
+    const float * input = nullptr;  // Looped
+    size_t input_frames = 0;
+    float * output = nullptr;       // blocks * frames_per_buffer frames, or null
+
+    // Per block measurements, preallocated
+    std::vector<uint32_t> wake_ns;    // Wake-up delay past the block's start time
+    std::vector<uint32_t> render_ns;
+    std::vector<uint32_t> misses;     // Blocks that finished past their deadline
+
+    bool realtime = false;
+  };
+
+  void * audio_thread(void * arg) {
+    AudioThread & t = *static_cast<AudioThread *>(arg);
+    const uint16_t frames = t.cfg->frames_per_buffer;
+
+    std::vector<float> silence((size_t)frames * t.in_ch, 0.f);
+    std::vector<float> scratch((size_t)frames * t.out_ch, 0.f);
+    std::vector<float> in_block((size_t)frames * t.in_ch, 0.f);
+
+    // Note: deadlines are derived from the start time, so that rounding never accumulates
+    const uint64_t start = now_ns() + 10000000ULL;
+    for (size_t b = 0; b < t.blocks; ++b) {
+      const uint64_t release = start + (uint64_t)b * frames * 1000000000ULL / k_emu_samplerate;
+      const uint64_t deadline = start + (uint64_t)(b + 1) * frames * 1000000000ULL / k_emu_samplerate;
+
+      const float * in = silence.data();
+      if (t.input) {
+        // Note: copy before the timed section, the device's input buffer is ready at release time
+        for (size_t f = 0; f < frames; ++f) {
+          const size_t src = ((b * frames + f) % t.input_frames) * t.in_ch;
+          std::copy(t.input + src, t.input + src + t.in_ch, &in_block[f * t.in_ch]);
+        }
+        in = in_block.data();
+      }
+      float * out = t.output ? t.output + b * frames * t.out_ch : scratch.data();
+
+      const struct timespec ts = to_timespec(release);
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+      }
+      const uint64_t t0 = now_ns();
+      t.unit->render(in, out, frames);
+      const uint64_t t1 = now_ns();
+
+      t.wake_ns[b] = (uint32_t)std::min<uint64_t>(t0 - std::min(t0, release), UINT32_MAX);
+      t.render_ns[b] = (uint32_t)std::min<uint64_t>(t1 - t0, UINT32_MAX);
+      if (t1 > deadline)
+        t.misses.push_back((uint32_t)b);  // Note: capacity reserved for all blocks
+    }
+    return nullptr;
+  }
+
+  /**
+   * Start the audio thread, with SCHED_FIFO if permitted.
+   */
+  bool start_audio_thread(AudioThread & t, pthread_t & thread) {
+    pthread_attr_t attr;
+    for (int realtime = 1; realtime >= 0; --realtime) {
+      pthread_attr_init(&attr);
+      if (t.cfg->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(t.cfg->cpu, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+      }
+      if (realtime) {
+        struct sched_param param;
+        param.sched_priority = t.cfg->priority;
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+      }
+
+      t.realtime = realtime;
+      const int err = pthread_create(&thread, &attr, audio_thread, &t);
+      pthread_attr_destroy(&attr);
+      if (err == 0)
+        return true;
+      if (err != EPERM || !realtime) {
+        std::fprintf(stderr, "error: cannot start audio thread: %s\n", std::strerror(err));
+        return false;
+      }
+      std::fprintf(stderr, "warning: SCHED_FIFO not permitted, running with the default policy\n");
+    }
+    return false;
+  }
+
+  uint32_t quantile(std::vector<uint32_t> v, double q) {
+    if (v.empty())
+      return 0;
+    const size_t k = std::min(v.size() - 1, (size_t)(q * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+  }
+
+  double mean(const std::vector<uint32_t> & v) {
+    double sum = 0.;
+    for (uint32_t x : v)
+      sum += x;
+    return v.empty() ? 0. : sum / v.size();
+  }
+
+  void report(const AudioThread & t) {
+    const double period_ns = 1e9 * t.cfg->frames_per_buffer / k_emu_samplerate;
+
+    std::printf("\naudio thread: %s, %zu blocks of %u frames, period %.0f ns\n",
+                t.realtime ? "SCHED_FIFO" : "SCHED_OTHER", t.blocks, t.cfg->frames_per_buffer, period_ns);
+    std::printf("%-10s %12s %12s %12s %12s %12s\n", "(ns)", "mean", "p50", "p99", "p99.9", "max");
+    std::printf("%-10s %12.0f %12u %12u %12u %12u\n", "render", mean(t.render_ns), quantile(t.render_ns, 0.5),
+                quantile(t.render_ns, 0.99), quantile(t.render_ns, 0.999), quantile(t.render_ns, 1.));
+    std::printf("%-10s %12.0f %12u %12u %12u %12u\n", "wake-up", mean(t.wake_ns), quantile(t.wake_ns, 0.5),
+                quantile(t.wake_ns, 0.99), quantile(t.wake_ns, 0.999), quantile(t.wake_ns, 1.));
+    std::printf("load: %.2f%% mean, %.2f%% max\n", 100. * mean(t.render_ns) / period_ns,
+                100. * quantile(t.render_ns, 1.) / period_ns);
+
+    std::printf("deadline misses: %zu (%.3f%%)", t.misses.size(), t.blocks ? 100. * t.misses.size() / t.blocks : 0.);
+    for (size_t i = 0; i < t.misses.size() && i < k_listed_misses; ++i) {
+      const uint32_t b = t.misses[i];
+      std::printf("%s block %u (wake-up %u ns, render %u ns)", i ? "," : ":", b, t.wake_ns[b], t.render_ns[b]);
+    }
+    std::printf("%s\n", t.misses.size() > k_listed_misses ? ", ..." : "");
+  }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+  Config cfg;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:d:b:P:a:i:o:p:n:")) != -1) {
+    switch (opt) {
+    case 's': cfg.samples_path = optarg; break;
+    case 'd': cfg.seconds = std::atof(optarg); break;
+    case 'b': cfg.frames_per_buffer = (uint16_t)std::atoi(optarg); break;
+    case 'P': cfg.priority = std::atoi(optarg); break;
+    case 'a': cfg.cpu = std::atoi(optarg); break;
+    case 'i': cfg.in_path = optarg; break;
+    case 'o': cfg.out_path = optarg; break;
+    case 'p': {
+      int id, value;
+      if (std::sscanf(optarg, "%d=%d", &id, &value) != 2 || id < 0 || id >= UNIT_MAX_PARAM_COUNT) {
+        usage();
+        return 1;
+      }
+      cfg.params.emplace_back((uint8_t)id, (int32_t)value);
+    } break;
+    case 'n':
+      if (std::sscanf(optarg, "%d:%d", &cfg.note, &cfg.velocity) < 1 || cfg.note < 0 || cfg.note > 127
+          || cfg.velocity < 0 || cfg.velocity > 127) {
+        usage();
+        return 1;
+      }
+      break;
+    default: usage(); return 1;
+    }
+  }
+  if (argc - optind != 1 || cfg.frames_per_buffer == 0 || cfg.seconds <= 0.) {
+    usage();
+    return 1;
+  }
+  cfg.unit_path = argv[optind];
+
+  Unit unit;
+  std::string error;
+  if (!unit.Load(cfg.unit_path, error)) {
+    std::fprintf(stderr, "error: %s\n", error.c_str());
+    return 1;
+  }
+  if (!validate_header(unit, cfg.unit_path)) {
+    std::fprintf(stderr, "error: unit would be rejected by the runtime\n");
+    return 1;
+  }
+
+  if (cfg.samples_path) {
+    if (!unit_host::LoadSampleBanks(cfg.samples_path, error)) {
+      std::fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+  }
+
+  Runtime runtime;
+  runtime.Setup(unit.header->target, k_emu_samplerate, cfg.frames_per_buffer);
+  if (runtime.desc.get_num_sample_banks) {
+    uint32_t samples = 0;
+    for (uint8_t b = 0; b < runtime.desc.get_num_sample_banks(); ++b)
+      samples += runtime.desc.get_num_samples_for_bank(b);
+    std::printf("samples: %u banks, %u samples\n", runtime.desc.get_num_sample_banks(), samples);
+  }
+
+  AudioThread t;
+  t.cfg = &cfg;
+  t.unit = &unit;
+  t.in_ch = runtime.desc.input_channels;
+  t.out_ch = runtime.desc.output_channels;
+  t.blocks = (size_t)std::ceil(cfg.seconds * k_emu_samplerate / cfg.frames_per_buffer);
+
+  std::vector<float> input;
+  if (cfg.in_path) {
+    WavReader reader;
+    if (!reader.Open(cfg.in_path, error)) {
+      std::fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+    // Note: the runtime does not resample, and rendering faster or slower would skew deadlines
+    if (reader.samplerate() != k_emu_samplerate) {
+      std::fprintf(stderr, "error: %s is %u Hz, the unit runs at %u Hz\n", cfg.in_path, reader.samplerate(),
+                   k_emu_samplerate);
+      return 1;
+    }
+    if (reader.frames() && t.in_ch) {
+      input.resize(reader.frames() * t.in_ch);
+      const float * src = reader.Read(reader.frames(), t.in_ch, input.data());
+      if (src != input.data())
+        std::copy(src, src + input.size(), input.begin());
+      t.input = input.data();
+      t.input_frames = reader.frames();
+    }
+  }
+  std::vector<float> output;
+  if (cfg.out_path) {
+    output.resize(t.blocks * cfg.frames_per_buffer * t.out_ch);
+    t.output = output.data();
+  }
+  t.wake_ns.resize(t.blocks);
+  t.render_ns.resize(t.blocks);
+  t.misses.reserve(t.blocks);
+
+  const int8_t err = unit.init(&runtime.desc);
+  if (err != k_unit_err_none) {
+    std::fprintf(stderr, "error: unit_init failed (%s)\n", unit_host::ErrorString(err));
+    return 1;
+  }
+  for (uint32_t p = 0; p < unit.header->num_params && p < UNIT_MAX_PARAM_COUNT; ++p) {
+    if (unit.set_param_value)
+      unit.set_param_value(p, unit.header->params[p].init);
+  }
+  for (const auto & p : cfg.params) {
+    if (unit.set_param_value)
+      unit.set_param_value(p.first, p.second);
+  }
+  if (unit.resume)
+    unit.resume();
+  if (cfg.note >= 0) {
+    if (unit.note_on)
+      unit.note_on((uint8_t)cfg.note, (uint8_t)cfg.velocity);
+    if (unit.gate_on)
+      unit.gate_on((uint8_t)cfg.velocity);
+  }
+
+  // Note: page faults in the audio thread would show up as deadline misses
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    std::fprintf(stderr, "warning: mlockall failed: %s\n", std::strerror(errno));
+
+  pthread_t thread;
+  if (!start_audio_thread(t, thread))
+    return 1;
+  pthread_join(thread, nullptr);
+
+  if (unit.suspend)
+    unit.suspend();
+  if (unit.teardown)
+    unit.teardown();
+
+  report(t);
+
+  if (cfg.out_path) {
+    WavWriter writer;
+    if (!writer.Open(cfg.out_path, k_emu_samplerate, t.out_ch, unit_host::k_wav_format_float32, error)
+        || !writer.Write(output.data(), t.blocks * cfg.frames_per_buffer) || !writer.Close()) {
+      std::fprintf(stderr, "error: cannot write %s\n", cfg.out_path);
+      return 1;
+    }
+  }
+
+  return t.misses.empty() ? 0 : 2;
+}
@@ -0,0 +1,478 @@
+/**
+ * @file unit_host.cc
+ * @brief Minimal host runtime for units built as native shared objects
+ *
+ */
+
+#include "unit_host.h"
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+#include "wav_file.h"
+#endif
+
+namespace unit_host {
+
+  namespace {
+
+    // Note: runtime hooks are plain function pointers without user data, state is thus process wide.
+    //       Each unit instance is expected to live in its own process or worker, see unit-sweep.
+    thread_local const float * s_current_input = nullptr;
+
+#if !defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+    uint8_t * sdram_alloc(size_t size) {
+      return static_cast<uint8_t *>(std::calloc(1, size));
+    }
+
+    void sdram_free(const uint8_t * mem) {
+      std::free(const_cast<uint8_t *>(mem));
+    }
+
+    size_t sdram_avail(void) {
+      // Note: actual SDRAM budget of the device is not modeled
+      return 16U << 20;
+    }
+#endif
+
+#if defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+    const float * get_raw_input(void) {
+      return s_current_input;
+    }
+#endif
+
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+    void notify_input_usage(uint8_t usage) {
+      (void)usage;
+    }
+#endif
+
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+    struct Sample {
+      sample_wrapper_t wrapper;
+      std::vector<float> data;
+    };
+
+    // Note: filled by LoadSampleBanks() before units are initialized, read only afterwards
+    std::vector<std::vector<Sample>> s_sample_banks;
+
+    uint8_t get_num_sample_banks() {
+      return (uint8_t)s_sample_banks.size();
+    }
+
+    uint8_t get_num_samples_for_bank(uint8_t bank) {
+      return (bank < s_sample_banks.size()) ? (uint8_t)s_sample_banks[bank].size() : 0;
+    }
+
+    const sample_wrapper_t * get_sample(uint8_t bank, uint8_t index) {
+      if (bank >= s_sample_banks.size() || index >= s_sample_banks[bank].size())
+        return nullptr;
+      return &s_sample_banks[bank][index].wrapper;
+    }
+
+    /**
+     * @return Sorted names of directory entries accepted by filter.
+     */
+    template <typename F>
+    bool list_dir(const std::string & path, F filter, std::vector<std::string> & names, std::string & error) {
+      DIR * dir = opendir(path.c_str());
+      if (!dir) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+      }
+      while (const struct dirent * ent = readdir(dir)) {
+        if (ent->d_name[0] != '.' && filter(path + "/" + ent->d_name, ent->d_name))
+          names.push_back(ent->d_name);
+      }
+      closedir(dir);
+      std::sort(names.begin(), names.end());
+      return true;
+    }
+
+    bool is_dir(const std::string & path, const char *) {
+      struct stat st;
+      return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    bool is_wav(const std::string &, const char * name) {
+      const size_t len = std::strlen(name);
+      return len > 4 && strcasecmp(name + len - 4, ".wav") == 0;
+    }
+
+    bool load_bank(const std::string & path, uint8_t bank, std::vector<Sample> & samples, std::string & error) {
+      std::vector<std::string> files;
+      if (!list_dir(path, is_wav, files, error))
+        return false;
+      // Note: indices are 8-bit
+      files.resize(std::min<size_t>(files.size(), 0xFF));
+
+      samples.resize(files.size());
+      for (size_t i = 0; i < files.size(); ++i) {
+        const std::string file = path + "/" + files[i];
+        WavReader reader;
+        if (!reader.Open(file.c_str(), error))
+          return false;
+        if (reader.channels() < 1 || reader.channels() > 2) {
+          error = file + ": only mono and stereo samples are supported";
+          return false;
+        }
+
+        Sample & s = samples[i];
+        s.data.resize(reader.frames() * reader.channels());
+        const float * src = reader.Read(reader.frames(), reader.channels(), s.data.data());
+        if (src != s.data.data())
+          std::copy(src, src + s.data.size(), s.data.begin());
+
+        std::memset(&s.wrapper, 0, sizeof(s.wrapper));
+        s.wrapper.bank = bank;
+        s.wrapper.index = (uint8_t)i;
+        s.wrapper.channels = (uint8_t)reader.channels();
+        const std::string name = files[i].substr(0, files[i].size() - 4);
+        std::strncpy(s.wrapper.name, name.c_str(), UNIT_SAMPLE_WRAPPER_MAX_NAME_LEN);
+        s.wrapper.frames = reader.frames();
+        s.wrapper.sample_ptr = s.data.data();
+      }
+      return true;
+    }
+#endif
+
+    template <typename T>
+    void resolve(void * handle, const char * name, T & func) {
+      func = reinterpret_cast<T>(dlsym(handle, name));
+    }
+
+  }  // namespace
+
+  /*===========================================================================*/
+  /* Unit */
+  /*===========================================================================*/
+
+  bool Unit::Load(const char * path, std::string & error) {
+    Unload();
+
+    // Note: dlopen() searches the library path for names without a slash, e.g.: "waves.so"
+    const std::string file = std::strchr(path, '/') ? std::string(path) : std::string("./") + path;
+
+    // Note: RTLD_LOCAL so that several copies of a unit can coexist in one process
+    handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+      const char * err = dlerror();
+      error = err ? err : "dlopen failed";
+      return false;
+    }
+
+    // Note: platform specific headers (e.g.: genericfx_unit_header_t) start with unit_header_t
+    header = static_cast<const unit_header_t *>(dlsym(handle, "unit_header"));
+    if (!header) {
+      error = "unit_header symbol not found";
+      Unload();
+      return false;
+    }
+
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+    const uint32_t * flags_sym = static_cast<const uint32_t *>(dlsym(handle, "unit_flags"));
+    flags = flags_sym ? *flags_sym : (uint32_t)k_unit_flags_none;
+#else
+    flags = header->flags;
+#endif
+
+    resolve(handle, "unit_init", init);
+    resolve(handle, "unit_teardown", teardown);
+    resolve(handle, "unit_reset", reset);
+    resolve(handle, "unit_resume", resume);
+    resolve(handle, "unit_suspend", suspend);
+    resolve(handle, "unit_render", render);
+    resolve(handle, "unit_get_param_value", get_param_value);
+    resolve(handle, "unit_get_param_str_value", get_param_str_value);
+    resolve(handle, "unit_set_param_value", set_param_value);
+    resolve(handle, "unit_set_param_values", set_param_values);
+    resolve(handle, "unit_set_tempo", set_tempo);
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+    resolve(handle, "unit_get_preset_index", get_preset_index);
+    resolve(handle, "unit_get_preset_name", get_preset_name);
+    resolve(handle, "unit_load_preset", load_preset);
+    resolve(handle, "unit_get_param_bmp_value", get_param_bmp_value);
+    resolve(handle, "unit_gate_on", gate_on);
+    resolve(handle, "unit_gate_off", gate_off);
+#else
+    resolve(handle, "unit_tempo_4ppqn_tick", tempo_4ppqn_tick);
+#endif
+#if defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+    resolve(handle, "unit_touch_event", touch_event);
+#else
+    resolve(handle, "unit_note_on", note_on);
+    resolve(handle, "unit_note_off", note_off);
+    resolve(handle, "unit_all_note_off", all_note_off);
+    resolve(handle, "unit_pitch_bend", pitch_bend);
+    resolve(handle, "unit_channel_pressure", channel_pressure);
+    resolve(handle, "unit_aftertouch", aftertouch);
+#endif
+
+    if (!init || !render) {
+      error = "unit_init or unit_render symbol not found";
+      Unload();
+      return false;
+    }
+
+    return true;
+  }
+
+  bool Unit::LoadCopy(const char * path, std::string & error) {
+    const int src = open(path, O_RDONLY);
+    if (src < 0) {
+      error = std::string(path) + ": " + std::strerror(errno);
+      return false;
+    }
+
+    const char * tmpdir = std::getenv("TMPDIR");
+    std::string copy = std::string(tmpdir ? tmpdir : "/tmp") + "/unit-host-XXXXXX.so";
+    const int dst = mkstemps(&copy[0], 3);
+    if (dst < 0) {
+      error = copy + ": " + std::strerror(errno);
+      close(src);
+      return false;
+    }
+
+    struct stat st;
+    bool ok = fstat(src, &st) == 0;
+    for (off_t done = 0; ok && done < st.st_size;) {
+      const ssize_t n = sendfile(dst, src, nullptr, st.st_size - done);
+      ok = n > 0;
+      done += ok ? n : 0;
+    }
+    close(src);
+    close(dst);
+
+    ok = ok && Load(copy.c_str(), error);
+    // Note: mapping outlives the file
+    unlink(copy.c_str());
+    if (!ok && error.empty())
+      error = copy + ": copy failed";
+    return ok;
+  }
+
+  void Unit::ResetStubs() {
+    typedef void (*reset_func)(void);
+    reset_func reset_stubs = handle ? reinterpret_cast<reset_func>(dlsym(handle, "unit_host_stub_reset")) : nullptr;
+    if (reset_stubs)
+      reset_stubs();
+  }
+
+  void Unit::Unload() {
+    void * h = handle;
+    // Note: only plain pointers and integers, see Unit
+    std::memset(static_cast<void *>(this), 0, sizeof(*this));
+    if (h)
+      dlclose(h);
+  }
+
+  /*===========================================================================*/
+  /* Runtime */
+  /*===========================================================================*/
+
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+  bool LoadSampleBanks(const char * path, std::string & error) {
+    s_sample_banks.clear();
+
+    std::vector<std::string> banks;
+    if (!list_dir(path, is_dir, banks, error))
+      return false;
+    if (banks.empty())
+      banks.push_back(".");
+    banks.resize(std::min<size_t>(banks.size(), 0xFF));
+
+    s_sample_banks.resize(banks.size());
+    for (size_t b = 0; b < banks.size(); ++b) {
+      if (!load_bank(std::string(path) + "/" + banks[b], (uint8_t)b, s_sample_banks[b], error)) {
+        s_sample_banks.clear();
+        return false;
+      }
+    }
+    return true;
+  }
+#endif
+
+  void Runtime::Setup(uint32_t target, uint32_t samplerate, uint16_t frames_per_buffer,
+                      uint8_t input_channels, uint8_t output_channels) {
+    std::memset(&desc, 0, sizeof(desc));
+
+    uint8_t in_ch, out_ch;
+    DefaultGeometry(target, in_ch, out_ch);
+
+    desc.target = target;
+    desc.api = UNIT_API_VERSION;
+    desc.samplerate = samplerate;
+    desc.frames_per_buffer = frames_per_buffer;
+    desc.input_channels = input_channels ? input_channels : in_ch;
+    desc.output_channels = output_channels ? output_channels : out_ch;
+
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+    desc.get_num_sample_banks = get_num_sample_banks;
+    desc.get_num_samples_for_bank = get_num_samples_for_bank;
+    desc.get_sample = get_sample;
+#else
+    desc.hooks.sdram_alloc = sdram_alloc;
+    desc.hooks.sdram_free = sdram_free;
+    desc.hooks.sdram_avail = sdram_avail;
+#endif
+
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+    std::memset(&osc_context, 0, sizeof(osc_context));
+    osc_context.pitch = 60 << 8;  // C4
+    osc_context.notify_input_usage = notify_input_usage;
+    if ((target & UNIT_TARGET_MODULE_MASK) == k_unit_module_osc)
+      desc.hooks.runtime_context = &osc_context;
+#elif defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+    std::memset(&genericfx_context, 0, sizeof(genericfx_context));
+    genericfx_context.touch_area_width = 1024;
+    genericfx_context.touch_area_height = 1024;
+    genericfx_context.get_raw_input = get_raw_input;
+    desc.hooks.runtime_context = &genericfx_context;
+#endif
+  }
+
+  void * Runtime::context() {
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+    return (desc.hooks.runtime_context) ? &osc_context : nullptr;
+#elif defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+    return &genericfx_context;
+#else
+    return nullptr;
+#endif
+  }
+
+  size_t Runtime::context_data_size() const {
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+    return (desc.hooks.runtime_context) ? offsetof(unit_runtime_osc_context_t, notify_input_usage) : 0;
+#elif defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+    return offsetof(unit_runtime_genericfx_context_t, get_raw_input);
+#else
+    return 0;
+#endif
+  }
+
+  void Runtime::SetCurrentInput(const float * in) {
+    s_current_input = in;
+  }
+
+  /*===========================================================================*/
+  /* Helpers */
+  /*===========================================================================*/
+
+  void Dispatch(Unit & unit, Runtime & runtime, const unit_trace_record_t & rec, const void * payload) {
+    switch (rec.type) {
+    case k_unit_trace_rec_reset:
+      if (unit.reset) unit.reset();
+      break;
+    case k_unit_trace_rec_resume:
+      if (unit.resume) unit.resume();
+      break;
+    case k_unit_trace_rec_suspend:
+      if (unit.suspend) unit.suspend();
+      break;
+    case k_unit_trace_rec_set_param_value:
+      if (unit.set_param_value) unit.set_param_value(rec.arg0, (int32_t)rec.value0);
+      break;
+    case k_unit_trace_rec_set_param_values:
+      // Note: payload holds values up to the highest bit of the mask
+      if (unit.set_param_values && rec.value0
+          && rec.value1 >= (32 - __builtin_clz(rec.value0)) * sizeof(int32_t))
+        unit.set_param_values(static_cast<const int32_t *>(payload), rec.value0);
+      break;
+    case k_unit_trace_rec_set_tempo:
+      if (unit.set_tempo) unit.set_tempo(rec.value0);
+      break;
+    case k_unit_trace_rec_context:
+      if (runtime.context() && payload && rec.value1 <= runtime.context_data_size())
+        std::memcpy(runtime.context(), payload, rec.value1);
+      break;
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+    case k_unit_trace_rec_load_preset:
+      if (unit.load_preset) unit.load_preset(rec.arg0);
+      break;
+    case k_unit_trace_rec_gate_on:
+      if (unit.gate_on) unit.gate_on(rec.arg0);
+      break;
+    case k_unit_trace_rec_gate_off:
+      if (unit.gate_off) unit.gate_off();
+      break;
+#else
+    case k_unit_trace_rec_tempo_4ppqn_tick:
+      if (unit.tempo_4ppqn_tick) unit.tempo_4ppqn_tick(rec.value0);
+      break;
+#endif
+#if defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+    case k_unit_trace_rec_touch_event:
+      if (unit.touch_event) unit.touch_event(rec.arg0, (uint8_t)rec.arg1, rec.value0, rec.value1);
+      break;
+#else
+    case k_unit_trace_rec_note_on:
+      if (unit.note_on) unit.note_on(rec.arg0, (uint8_t)rec.arg1);
+      break;
+    case k_unit_trace_rec_note_off:
+      if (unit.note_off) unit.note_off(rec.arg0);
+      break;
+    case k_unit_trace_rec_all_note_off:
+      if (unit.all_note_off) unit.all_note_off();
+      break;
+    case k_unit_trace_rec_pitch_bend:
+      if (unit.pitch_bend) unit.pitch_bend(rec.arg1);
+      break;
+    case k_unit_trace_rec_channel_pressure:
+      if (unit.channel_pressure) unit.channel_pressure(rec.arg0);
+      break;
+    case k_unit_trace_rec_aftertouch:
+      if (unit.aftertouch) unit.aftertouch(rec.arg0, (uint8_t)rec.arg1);
+      break;
+#endif
+    default:
+      break;
+    }
+  }
+
+  void DefaultGeometry(uint32_t target, uint8_t & input_channels, uint8_t & output_channels) {
+    switch (target & UNIT_TARGET_MODULE_MASK) {
+    case k_unit_module_osc:
+      input_channels = 2;
+      output_channels = 1;
+      break;
+    case k_unit_module_synth:
+      input_channels = 0;
+      output_channels = 2;
+      break;
+    case k_unit_module_masterfx:
+      input_channels = 4;
+      output_channels = 2;
+      break;
+    default:
+      input_channels = 2;
+      output_channels = 2;
+      break;
+    }
+  }
+
+  const char * ErrorString(int8_t err) {
+    switch (err) {
+    case k_unit_err_none: return "none";
+    case k_unit_err_target: return "target";
+    case k_unit_err_api_version: return "api version";
+    case k_unit_err_samplerate: return "samplerate";
+    case k_unit_err_geometry: return "geometry";
+    case k_unit_err_memory: return "memory";
+    case k_unit_err_undef: return "undefined";
+    default: return "unknown";
+    }
+  }
+
+}  // namespace unit_host
@@ -0,0 +1,201 @@
+/**
+ * @file unit_host.h
+ * @brief Minimal host runtime for units built as native shared objects
+ *
+ * Loads a unit with dlopen(), resolves its callbacks the same way device
+ * runtimes do (by symbol name), and provides a runtime descriptor with
+ * host implementations of the runtime hooks.
+ *
+ * The platform is selected at build time, see UNIT_HOST_PLATFORM_* in the Makefile.
+ *
+ */
+
+#pragma once
+
+#include <time.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "unit.h"
+#include "unit_trace.h"
+
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+#include "unit_osc.h"
+#elif defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+#include "unit_genericfx.h"
+#endif
+
+namespace unit_host {
+
+  /**
+   * Unit callbacks resolved from a shared object.
+   * Callbacks the unit does not export are left null, callers must check.
+   */
+  struct Unit {
+    void * handle = nullptr;
+    const unit_header_t * header = nullptr;
+    uint32_t flags = 0;  // k_unit_flag_*
+
+    unit_init_func init = nullptr;
+    unit_teardown_func teardown = nullptr;
+    unit_reset_func reset = nullptr;
+    unit_resume_func resume = nullptr;
+    unit_suspend_func suspend = nullptr;
+    unit_render_func render = nullptr;
+    unit_get_param_value_func get_param_value = nullptr;
+    unit_get_param_str_value_func get_param_str_value = nullptr;
+    unit_set_param_value_func set_param_value = nullptr;
+    unit_set_param_values_func set_param_values = nullptr;
+    unit_set_tempo_func set_tempo = nullptr;
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+    unit_get_preset_index_func get_preset_index = nullptr;
+    unit_get_preset_name_func get_preset_name = nullptr;
+    unit_load_preset_func load_preset = nullptr;
+    unit_get_param_bmp_value_func get_param_bmp_value = nullptr;
+    unit_gate_on_func gate_on = nullptr;
+    unit_gate_off_func gate_off = nullptr;
+#else
+    unit_tempo_4ppqn_tick_func tempo_4ppqn_tick = nullptr;
+#endif
+#if defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+    unit_touch_event_func touch_event = nullptr;
+#else
+    unit_note_on_func note_on = nullptr;
+    unit_note_off_func note_off = nullptr;
+    unit_all_note_off_func all_note_off = nullptr;
+    unit_pitch_bend_func pitch_bend = nullptr;
+    unit_channel_pressure_func channel_pressure = nullptr;
+    unit_aftertouch_func aftertouch = nullptr;
+#endif
+
+    /**
+     * Load a unit shared object and resolve its callbacks.
+     *
+     * @param path  Path to the shared object.
+     * @param error Set to a description of the failure, if any.
+     * @return True on success.
+     */
+    bool Load(const char * path, std::string & error);
+
+    /**
+     * Load a private copy of a unit shared object.
+     *
+     * The dynamic loader maps a given file only once per process: loading a
+     * temporary copy gives the instance its own file-static state, so that
+     * several instances can run concurrently (e.g.: one per worker thread).
+     *
+     * @note Units must be built without STB_GNU_UNIQUE symbols, which the loader
+     *       binds process wide, see -fno-gnu-unique in the Makefile.
+     */
+    bool LoadCopy(const char * path, std::string & error);
+
+    /**
+     * Reset host stubs linked into the unit (noise generator seeds, tempo) to
+     * their initial state, if any. See src/nts_api_stubs.c.
+     */
+    void ResetStubs();
+
+    /**
+     * Unload the shared object, all callbacks become invalid.
+     */
+    void Unload();
+
+    Unit() = default;
+    Unit(const Unit &) = delete;
+    Unit & operator=(const Unit &) = delete;
+    ~Unit() { Unload(); }
+  };
+
+  /**
+   * Host runtime environment: runtime descriptor, context and hooks.
+   */
+  struct Runtime {
+    unit_runtime_desc_t desc;
+
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+    unit_runtime_osc_context_t osc_context;
+#elif defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+    unit_runtime_genericfx_context_t genericfx_context;
+#endif
+
+    /**
+     * Setup the runtime descriptor for the given target and buffer geometry.
+     * Channel counts of 0 select the platform's default geometry for the target's module.
+     */
+    void Setup(uint32_t target, uint32_t samplerate, uint16_t frames_per_buffer,
+               uint8_t input_channels = 0, uint8_t output_channels = 0);
+
+    /**
+     * @return Runtime context writable by the host (e.g.: oscillator pitch), or null.
+     */
+    void * context();
+
+    /**
+     * @return Size of the context's leading data fields, i.e.: excluding API pointers.
+     */
+    size_t context_data_size() const;
+
+    /**
+     * Set the input buffer exposed through context APIs for the current render call.
+     */
+    static void SetCurrentInput(const float * in);
+  };
+
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+  /**
+   * Serve samples from a directory through the runtime's get_sample() and related hooks.
+   *
+   * Each subdirectory is a bank and each WAV file in it a sample, both in name
+   * order. A directory without subdirectories makes up a single bank. Samples
+   * are loaded as 32-bit float, mono or stereo, and are not resampled.
+   *
+   * @note Call before initializing units, samples are shared process wide.
+   */
+  bool LoadSampleBanks(const char * path, std::string & error);
+
+#endif
+  /**
+   * Issue the callback described by a trace record, see inc/unit_trace.h.
+   *
+   * Render records are left to the caller, as are init and teardown records.
+   * Context records update the runtime context. Records of other platforms
+   * are ignored.
+   *
+   * @param payload Record payload, if any.
+   */
+  void Dispatch(Unit & unit, Runtime & runtime, const unit_trace_record_t & rec, const void * payload);
+
+  /**
+   * Default buffer geometry of a platform/module pair.
+   */
+  void DefaultGeometry(uint32_t target, uint8_t & input_channels, uint8_t & output_channels);
+
+  /**
+   * Human readable error code.
+   */
+  const char * ErrorString(int8_t err);
+
+  /**
+   * Free running cycle counter for relative cost measurements.
+   *
+   * @note TSC ticks on x86, i.e.: constant rate rather than core cycles.
+   *       Monotonic clock nanoseconds on other architectures, where user
+   *       access to cycle counters is usually disabled.
+   */
+  inline uint64_t CycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+  }
+
+}  // namespace unit_host
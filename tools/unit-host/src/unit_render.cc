@@ -0,0 +1,176 @@
+/**
+ * @file unit_render.cc
+ * @brief Offline rendering of a unit from and to WAV files
+ *
+ * Input and output are streamed block by block, memory use does not depend
+ * on the render length.
+ *
+ * Usage: unit-render [options] <unit.so> <out.wav>
+ *   -i <file>       Input audio, WAV (default: silence)
+ *   -d <seconds>    Render length (default: input length, or 10 seconds without input)
+ *   -b <frames>     Frames per buffer (default: 64)
+ *   -F <format>     Output sample format: float, 16 or 24 (default: float)
+ *   -p <id>=<value> Set a parameter before rendering, repeatable
+ *   -n <note>[:vel] Send a note on before rendering (default velocity: 100)
+ *
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "unit_host.h"
+#include "wav_file.h"
+
+using unit_host::Runtime;
+using unit_host::Unit;
+using unit_host::WavFormat;
+using unit_host::WavReader;
+using unit_host::WavWriter;
+
+namespace {
+
+  constexpr uint32_t k_render_samplerate = 48000;
+
+  struct ParamSetting {
+    uint8_t id;
+    int32_t value;
+  };
+
+  void usage() {
+    std::fprintf(stderr,
+                 "usage: unit-render [-i in.wav] [-d seconds] [-b frames] [-F float|16|24] [-p id=value]... "
+                 "[-n note[:vel]] <unit.so> <out.wav>\n");
+  }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+  const char * in_path = nullptr;
+  double duration = -1.;
+  uint16_t frames_per_buffer = 64;
+  WavFormat out_format = unit_host::k_wav_format_float32;
+  std::vector<ParamSetting> params;
+  int note = -1;
+  int velocity = 100;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "i:d:b:F:p:n:")) != -1) {
+    switch (opt) {
+    case 'i': in_path = optarg; break;
+    case 'd': duration = std::atof(optarg); break;
+    case 'b': frames_per_buffer = (uint16_t)std::atoi(optarg); break;
+    case 'F':
+      if (!unit_host::ParseWavFormat(optarg, out_format)) {
+        usage();
+        return 1;
+      }
+      break;
+    case 'p': {
+      int id, value;
+      if (std::sscanf(optarg, "%d=%d", &id, &value) != 2 || id < 0 || id > 255) {
+        usage();
+        return 1;
+      }
+      params.push_back({(uint8_t)id, (int32_t)value});
+    } break;
+    case 'n':
+      if (std::sscanf(optarg, "%d:%d", &note, &velocity) < 1) {
+        usage();
+        return 1;
+      }
+      break;
+    default: usage(); return 1;
+    }
+  }
+  if (argc - optind != 2 || frames_per_buffer == 0) {
+    usage();
+    return 1;
+  }
+
+  const char * unit_path = argv[optind];
+  const char * out_path = argv[optind + 1];
+  std::string error;
+
+  WavReader reader;
+  if (in_path) {
+    if (!reader.Open(in_path, error)) {
+      std::fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+    if (reader.samplerate() != k_render_samplerate)
+      std::fprintf(stderr, "warning: %s is %u Hz, rendering at %u Hz without resampling\n", in_path,
+                   reader.samplerate(), k_render_samplerate);
+  }
+
+  Unit unit;
+  if (!unit.Load(unit_path, error)) {
+    std::fprintf(stderr, "error: %s\n", error.c_str());
+    return 1;
+  }
+
+  Runtime runtime;
+  runtime.Setup(unit.header->target, k_render_samplerate, frames_per_buffer);
+  const uint16_t in_ch = runtime.desc.input_channels;
+  const uint16_t out_ch = runtime.desc.output_channels;
+
+  const int8_t err = unit.init(&runtime.desc);
+  if (err != k_unit_err_none) {
+    std::fprintf(stderr, "error: unit_init failed (%s)\n", unit_host::ErrorString(err));
+    return 1;
+  }
+
+  WavWriter writer;
+  if (!writer.Open(out_path, k_render_samplerate, out_ch, out_format, error)) {
+    std::fprintf(stderr, "error: %s\n", error.c_str());
+    return 1;
+  }
+
+  for (const ParamSetting & p : params) {
+    if (unit.set_param_value)
+      unit.set_param_value(p.id, p.value);
+  }
+  if (unit.resume)
+    unit.resume();
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+  if (note >= 0 && unit.note_on)
+    unit.note_on((uint8_t)note, (uint8_t)velocity);
+#elif defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+  if (note >= 0) {
+    if (runtime.context())
+      runtime.osc_context.pitch = (uint16_t)(note << 8);
+    if (unit.note_on)
+      unit.note_on((uint8_t)note, (uint8_t)velocity);
+  }
+#endif
+
+  const size_t total_frames = (duration >= 0.) ? (size_t)(duration * k_render_samplerate)
+                              : in_path ? reader.frames() : (size_t)10 * k_render_samplerate;
+
+  std::vector<float> silence((size_t)frames_per_buffer * in_ch, 0.f);
+  std::vector<float> scratch((size_t)frames_per_buffer * in_ch, 0.f);
+  std::vector<float> out((size_t)frames_per_buffer * out_ch, 0.f);
+
+  bool ok = true;
+  for (size_t done = 0; done < total_frames && ok;) {
+    const size_t frames = (total_frames - done < frames_per_buffer) ? total_frames - done : frames_per_buffer;
+    const float * in = in_path ? reader.Read(frames, in_ch, scratch.data()) : silence.data();
+    Runtime::SetCurrentInput(in);
+    unit.render(in, out.data(), (uint32_t)frames);
+    ok = writer.Write(out.data(), frames);
+    done += frames;
+  }
+
+  if (unit.teardown)
+    unit.teardown();
+
+  ok = writer.Close() && ok;
+  if (!ok) {
+    std::fprintf(stderr, "error: failed writing %s\n", out_path);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,449 @@
+/**
+ * @file unit_replay.cc
+ * @brief Deterministic replay of a render trace against a host unit build
+ *
+ * The trace is memory mapped read-only and walked in place: recorded input
+ * audio is passed to unit_render() directly from the mapping, without copies.
+ *
+ * Usage: unit-replay [options] <unit.so> <trace>
+ *   -r <count>  Replay the trace count times (default: 1), each on a freshly loaded unit
+ *   -o <file>   Write rendered output of the last run as WAV
+ *   -F <format> Output sample format: float, 16 or 24 (default: float)
+ *   -f          Ignore unit identity mismatches between trace and shared object
+ *   -c          Sample hardware counters around each render call, see perf_counters.h
+ *   -t <count>  Number of parameter states listed with -c (default: 10)
+ *
+ * Units built with UNIT_PROFILE also get their profile.h scope table listed.
+ * Units built with UNIT_FPCHECK get their outputs and registered state buffers
+ * scanned for subnormals, NaNs and infinities after each block, see fp_check.h.
+ *
+ */
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "perf_counters.h"
+#include "unit_host.h"
+#include "unit_trace.h"
+#include "wav_file.h"
+
+using unit_host::PerfCounter;
+using unit_host::PerfCounters;
+using unit_host::PerfDistribution;
+using unit_host::Runtime;
+using unit_host::Unit;
+using unit_host::WavFormat;
+using unit_host::WavWriter;
+
+namespace {
+
+  struct MappedTrace {
+    const uint8_t * data = nullptr;
+    size_t size = 0;
+
+    bool Map(const char * path) {
+      const int fd = open(path, O_RDONLY);
+      if (fd < 0)
+        return false;
+      struct stat st;
+      if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(unit_trace_header_t)) {
+        close(fd);
+        return false;
+      }
+      void * p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (p == MAP_FAILED)
+        return false;
+      madvise(p, st.st_size, MADV_SEQUENTIAL);
+      data = static_cast<const uint8_t *>(p);
+      size = st.st_size;
+      return true;
+    }
+
+    ~MappedTrace() {
+      if (data)
+        munmap(const_cast<uint8_t *>(data), size);
+    }
+
+    const unit_trace_header_t & header() const {
+      return *reinterpret_cast<const unit_trace_header_t *>(data);
+    }
+  };
+
+  inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+  typedef std::array<int32_t, UNIT_MAX_PARAM_COUNT> ParamState;
+
+  struct StateAggregate {
+    uint64_t blocks = 0;
+    uint64_t sums[unit_host::k_perf_counter_count] = {0};
+  };
+
+  struct RenderStats {
+    uint64_t calls = 0;
+    uint64_t frames = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+
+    // Hardware counters, if enabled
+    PerfCounters * perf = nullptr;
+    PerfDistribution blocks;
+    ParamState params = {};
+    std::map<ParamState, StateAggregate> states;
+
+    // Output scans, if the unit was built with UNIT_FPCHECK
+    void (*fpcheck_scan)(const float *, uint32_t) = nullptr;
+    const uint32_t * fpcheck_blocks = nullptr;
+  };
+
+  void usage() {
+    std::fprintf(stderr, "usage: unit-replay [-r count] [-o out.wav] [-F float|16|24] [-f] [-c [-t count]] <unit.so> <trace>\n");
+  }
+
+  /**
+   * Replay all records of a trace.
+   *
+   * @return False if the trace is malformed.
+   */
+  bool replay(const MappedTrace & trace, Unit & unit, Runtime & runtime, const std::vector<float> & silence,
+              std::vector<float> & out, WavWriter * writer, RenderStats & stats) {
+    const unit_trace_header_t & h = trace.header();
+    size_t offset = h.header_size;
+
+    while (offset + sizeof(unit_trace_record_t) <= trace.size) {
+      const unit_trace_record_t & rec = *reinterpret_cast<const unit_trace_record_t *>(trace.data + offset);
+      offset += sizeof(unit_trace_record_t);
+
+      const uint8_t * payload = nullptr;
+      if (rec.type & k_unit_trace_rec_payload) {
+        if (offset + UNIT_TRACE_PAD(rec.value1) > trace.size)
+          return false;
+        payload = rec.value1 ? trace.data + offset : nullptr;
+        offset += UNIT_TRACE_PAD(rec.value1);
+      }
+
+      switch (rec.type) {
+      case k_unit_trace_rec_init:
+      case k_unit_trace_rec_teardown:
+        // Note: lifetime is handled by the replayer
+        break;
+      case k_unit_trace_rec_render: {
+        const uint32_t frames = rec.value0;
+        if (frames > h.frames_per_buffer)
+          return false;
+        const float * in = payload ? reinterpret_cast<const float *>(payload) : silence.data();
+        Runtime::SetCurrentInput(in);
+        unit_host::PerfSample c0, c1;
+        if (stats.perf)
+          stats.perf->Read(c0);
+        const uint32_t scanned = stats.fpcheck_blocks ? *stats.fpcheck_blocks : 0;
+        const uint64_t t0 = now_ns();
+        unit.render(in, out.data(), frames);
+        const uint64_t dt = now_ns() - t0;
+        if (stats.perf)
+          stats.perf->Read(c1);
+        // Note: units calling FPCHECK_BLOCK() already scanned their output, host scans are not counted
+        if (stats.fpcheck_scan && *stats.fpcheck_blocks == scanned)
+          stats.fpcheck_scan(out.data(), frames * h.output_channels);
+        if (stats.perf) {
+          uint64_t delta[unit_host::k_perf_counter_count];
+          stats.perf->Delta(c0, c1, delta);
+          StateAggregate & state = stats.states[stats.params];
+          state.blocks++;
+          for (int c = 0; c < unit_host::k_perf_counter_count; ++c)
+            state.sums[c] += delta[c];
+          stats.blocks.Add(delta);
+        }
+        stats.calls++;
+        stats.frames += frames;
+        stats.total_ns += dt;
+        stats.max_ns = dt > stats.max_ns ? dt : stats.max_ns;
+        if (writer && !writer->Write(out.data(), frames))
+          writer = nullptr;
+      } break;
+      case k_unit_trace_rec_set_param_value:
+        if (rec.arg0 < UNIT_MAX_PARAM_COUNT)
+          stats.params[rec.arg0] = (int32_t)rec.value0;
+        unit_host::Dispatch(unit, runtime, rec, payload);
+        break;
+      case k_unit_trace_rec_set_param_values: {
+        // Note: payload holds values up to the highest bit of the mask
+        const uint32_t count = rec.value0 ? 32 - __builtin_clz(rec.value0) : 0;
+        if (rec.value1 < count * sizeof(int32_t))
+          return false;
+        const int32_t * values = reinterpret_cast<const int32_t *>(payload);
+        for (uint32_t mask = rec.value0; mask; mask &= mask - 1) {
+          const uint32_t i = __builtin_ctz(mask);
+          if (i < UNIT_MAX_PARAM_COUNT)
+            stats.params[i] = values[i];
+        }
+        unit_host::Dispatch(unit, runtime, rec, payload);
+      } break;
+      default:
+        unit_host::Dispatch(unit, runtime, rec, payload);
+        break;
+      }
+    }
+
+    return offset == trace.size;
+  }
+
+  void print_counters(RenderStats & stats, size_t top_states) {
+    using unit_host::k_perf_counter_count;
+
+    std::printf("\nper block: %14s %14s %14s %14s %14s\n", "mean", "p50", "p90", "p99", "max");
+    for (int c = 0; c < k_perf_counter_count; ++c) {
+      const PerfCounter counter = (PerfCounter)c;
+      if (!stats.perf->available(counter)) {
+        std::printf("%-14s %14s\n", PerfCounters::Name(counter), "n/a");
+        continue;
+      }
+      std::printf("%-14s %14.0f %14llu %14llu %14llu %14llu\n", PerfCounters::Name(counter),
+                  stats.blocks.Mean(counter), (unsigned long long)stats.blocks.Quantile(counter, 0.5),
+                  (unsigned long long)stats.blocks.Quantile(counter, 0.9),
+                  (unsigned long long)stats.blocks.Quantile(counter, 0.99),
+                  (unsigned long long)stats.blocks.Quantile(counter, 1.));
+    }
+    if (!stats.perf->is_open() || stats.states.empty())
+      return;
+    if (stats.perf->multiplexed())
+      std::printf("note: counters were multiplexed with other events, counts are scaled estimates\n");
+
+    // Note: only list parameters that differ between states
+    bool varying[UNIT_MAX_PARAM_COUNT] = {false};
+    const ParamState & first = stats.states.begin()->first;
+    for (const auto & s : stats.states) {
+      for (size_t i = 0; i < UNIT_MAX_PARAM_COUNT; ++i)
+        varying[i] |= s.first[i] != first[i];
+    }
+
+    std::vector<const std::pair<const ParamState, StateAggregate> *> sorted;
+    for (const auto & s : stats.states)
+      sorted.push_back(&s);
+    // Note: rank by cycles, or by the first available counter if the host does not count cycles
+    int key = 0;
+    while (key < k_perf_counter_count - 1 && !stats.perf->available((PerfCounter)key))
+      ++key;
+    std::sort(sorted.begin(), sorted.end(), [key](decltype(sorted[0]) a, decltype(sorted[0]) b) {
+      return a->second.sums[key] * b->second.blocks > b->second.sums[key] * a->second.blocks;
+    });
+
+    std::printf("\nparameter states: %zu, by mean %s per block\n", sorted.size(), PerfCounters::Name((PerfCounter)key));
+    for (size_t n = 0; n < sorted.size() && n < top_states; ++n) {
+      const ParamState & params = sorted[n]->first;
+      const StateAggregate & agg = sorted[n]->second;
+      std::printf("%8llu blocks", (unsigned long long)agg.blocks);
+      for (int c = 0; c < k_perf_counter_count; ++c) {
+        if (stats.perf->available((PerfCounter)c))
+          std::printf("  %s %.0f", PerfCounters::Name((PerfCounter)c), (double)agg.sums[c] / agg.blocks);
+      }
+      std::printf("  |");
+      for (size_t i = 0; i < UNIT_MAX_PARAM_COUNT; ++i) {
+        if (varying[i])
+          std::printf(" p%zu=%d", i, params[i]);
+      }
+      std::printf("\n");
+    }
+  }
+
+  void print_profile(const Unit & unit, uint64_t calls) {
+    // Note: only exported by units built with UNIT_PROFILE, see profile.h
+    const uint32_t * count = static_cast<const uint32_t *>(dlsym(unit.handle, "unit_profile_count"));
+    const unit_profile_entry_t * table =
+        static_cast<const unit_profile_entry_t *>(dlsym(unit.handle, "unit_profile_table"));
+    if (!count || !table || !*count || !calls)
+      return;
+
+    std::printf("\nprofile scopes: %14s %14s %14s %14s\n", "passes", "cycles/pass", "cycles/render", "max");
+    for (uint32_t i = 0; i < *count; ++i) {
+      const unit_profile_entry_t & e = table[i];
+      std::printf("%-15s %14llu %14.0f %14.0f %14u\n", e.name, (unsigned long long)e.passes,
+                  e.passes ? (double)e.cycles / e.passes : 0., (double)e.cycles / calls, e.max_cycles);
+    }
+  }
+
+  void print_fpcheck(const Unit & unit) {
+    // Note: only exported by units built with UNIT_FPCHECK, see fp_check.h
+    const uint32_t * count = static_cast<const uint32_t *>(dlsym(unit.handle, "unit_fpcheck_count"));
+    const unit_fpcheck_entry_t * table =
+        static_cast<const unit_fpcheck_entry_t *>(dlsym(unit.handle, "unit_fpcheck_table"));
+    const uint32_t * log_count = static_cast<const uint32_t *>(dlsym(unit.handle, "unit_fpcheck_log_count"));
+    const unit_fpcheck_record_t * log =
+        static_cast<const unit_fpcheck_record_t *>(dlsym(unit.handle, "unit_fpcheck_log"));
+    const uint32_t * blocks = static_cast<const uint32_t *>(dlsym(unit.handle, "unit_fpcheck_blocks"));
+    if (!count || !table || !log_count || !log || !blocks)
+      return;
+
+    std::printf("\nfp check: %u blocks scanned, %s\n", *blocks, *log_count ? "FAILED" : "all values normal or zero");
+    if (!*log_count)
+      return;
+    std::printf("%-15s %14s %14s %14s\n", "buffer", "subnormals", "nans", "infs");
+    for (uint32_t i = 0; i < *count; ++i) {
+      const unit_fpcheck_entry_t & e = table[i];
+      std::printf("%-15s %14u %14u %14u\n", e.name, e.subnormals, e.nans, e.infs);
+    }
+    std::printf("\nfirst offending blocks:\n");
+    for (uint32_t i = 0; i < *log_count; ++i) {
+      const unit_fpcheck_record_t & r = log[i];
+      std::printf("  block %-8u %-15s%s%s%s, first at [%u] = %g\n", r.block, table[r.entry].name,
+                  (r.kinds & k_unit_fpcheck_subnormal) ? " subnormal" : "", (r.kinds & k_unit_fpcheck_nan) ? " nan" : "",
+                  (r.kinds & k_unit_fpcheck_inf) ? " inf" : "", r.index, r.value);
+    }
+  }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+  int repeat = 1;
+  const char * out_path = nullptr;
+  bool force = false;
+  bool counters = false;
+  size_t top_states = 10;
+  WavFormat out_format = unit_host::k_wav_format_float32;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:o:F:fct:")) != -1) {
+    switch (opt) {
+    case 'r': repeat = std::atoi(optarg); break;
+    case 'o': out_path = optarg; break;
+    case 'F':
+      if (!unit_host::ParseWavFormat(optarg, out_format)) {
+        usage();
+        return 1;
+      }
+      break;
+    case 'f': force = true; break;
+    case 'c': counters = true; break;
+    case 't': top_states = (size_t)std::atoi(optarg); break;
+    default: usage(); return 1;
+    }
+  }
+  if (argc - optind != 2 || repeat < 1) {
+    usage();
+    return 1;
+  }
+
+  const char * unit_path = argv[optind];
+  const char * trace_path = argv[optind + 1];
+
+  MappedTrace trace;
+  if (!trace.Map(trace_path)) {
+    std::fprintf(stderr, "error: cannot map trace %s\n", trace_path);
+    return 1;
+  }
+
+  const unit_trace_header_t & h = trace.header();
+  if (h.magic != UNIT_TRACE_MAGIC || h.version != UNIT_TRACE_VERSION || h.header_size < sizeof(unit_trace_header_t)
+      || (h.header_size % UNIT_TRACE_ALIGN) != 0) {
+    std::fprintf(stderr, "error: %s is not a supported trace\n", trace_path);
+    return 1;
+  }
+
+  Unit unit;
+  std::string error;
+  if (!unit.Load(unit_path, error)) {
+    std::fprintf(stderr, "error: %s\n", error.c_str());
+    return 1;
+  }
+
+  if (unit.header->dev_id != h.dev_id || unit.header->unit_id != h.unit_id || unit.header->version != h.unit_version) {
+    std::fprintf(stderr, "%s: trace was recorded with %.*s (%08x:%08x v%08x)\n", force ? "warning" : "error",
+                 UNIT_TRACE_NAME_SIZE, h.unit_name, h.dev_id, h.unit_id, h.unit_version);
+    if (!force)
+      return 1;
+  }
+
+  std::vector<float> silence((size_t)h.frames_per_buffer * h.input_channels, 0.f);
+  std::vector<float> out((size_t)h.frames_per_buffer * h.output_channels, 0.f);
+
+  RenderStats stats;
+  PerfCounters perf;
+  if (counters) {
+    if (!perf.Open(error)) {
+      std::fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+    stats.perf = &perf;
+  }
+
+  Runtime runtime;
+  bool ok = true;
+  uint64_t run_calls = 0;
+  WavWriter writer;
+  for (int r = 0; r < repeat && ok; ++r) {
+    if (out_path && r == repeat - 1 && !writer.Open(out_path, h.samplerate, h.output_channels, out_format, error)) {
+      std::fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+
+    // Note: file-static state survives unit_init(), each further run gets a fresh private copy
+    if (r > 0) {
+      if (unit.teardown)
+        unit.teardown();
+      if (!unit.LoadCopy(unit_path, error)) {
+        std::fprintf(stderr, "error: %s\n", error.c_str());
+        return 1;
+      }
+    }
+    unit.ResetStubs();
+    runtime.Setup(h.target, h.samplerate, h.frames_per_buffer, h.input_channels, h.output_channels);
+    const int8_t err = unit.init(&runtime.desc);
+    if (err != k_unit_err_none) {
+      std::fprintf(stderr, "error: unit_init failed (%s)\n", unit_host::ErrorString(err));
+      return 1;
+    }
+
+    stats.fpcheck_scan = reinterpret_cast<void (*)(const float *, uint32_t)>(dlsym(unit.handle, "unit_fpcheck_scan"));
+    stats.fpcheck_blocks = static_cast<const uint32_t *>(dlsym(unit.handle, "unit_fpcheck_blocks"));
+    if (!stats.fpcheck_blocks)
+      stats.fpcheck_scan = nullptr;
+
+    stats.params.fill(0);
+    const uint64_t calls = stats.calls;
+    ok = replay(trace, unit, runtime, silence, out, writer.is_open() ? &writer : nullptr, stats);
+    run_calls = stats.calls - calls;
+  }
+  if (writer.is_open() && !writer.Close())
+    std::fprintf(stderr, "error: failed writing %s\n", out_path);
+
+  if (!ok) {
+    std::fprintf(stderr, "error: truncated or malformed trace\n");
+    return 1;
+  }
+
+  if (stats.calls) {
+    const double budget_ns = 1e9 * stats.frames / ((double)h.samplerate * stats.calls);
+    const double mean_ns = (double)stats.total_ns / stats.calls;
+    std::printf("renders: %llu (%llu frames)\n", (unsigned long long)stats.calls, (unsigned long long)stats.frames);
+    std::printf("mean: %.0f ns, max: %llu ns, budget: %.0f ns/call (%.2f%% mean load)\n", mean_ns,
+                (unsigned long long)stats.max_ns, budget_ns, 100. * mean_ns / budget_ns);
+  }
+
+  if (stats.perf)
+    print_counters(stats, top_states);
+
+  // Note: profile and fp check tables live in the unit image, i.e.: cover the last run
+  print_profile(unit, run_calls);
+  print_fpcheck(unit);
+
+  if (unit.teardown)
+    unit.teardown();
+
+  return 0;
+}
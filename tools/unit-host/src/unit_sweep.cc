@@ -0,0 +1,344 @@
+/**
+ * @file unit_sweep.cc
+ * @brief Parallel parameter sweep renderer
+ *
+ * Renders a unit once per point of a parameter grid, and reports per-point
+ * render cost and a hash of the rendered output. Points are distributed over
+ * a pool of worker threads.
+ *
+ * Every point renders with a freshly loaded private copy of the unit's shared
+ * object, so that no file-static state is shared between workers or carried
+ * over from a previous point (unit_init() alone does not reset it), with
+ * header default parameter values and reset host stubs. Results thus do not
+ * depend on scheduling and can be compared across runs and builds.
+ *
+ * Usage: unit-sweep [options] -p <spec> [-p <spec>]... <unit.so>
+ *   -p <spec>       Swept parameter: <id>=all, <id>=<min>:<max>[:<step>] or <id>=<v0>,<v1>,...
+ *   -j <jobs>       Worker threads (default: hardware concurrency)
+ *   -d <seconds>    Render length per point (default: 1)
+ *   -b <frames>     Frames per buffer (default: 64)
+ *   -i <file>       Input audio, WAV (default: silence)
+ *   -n <note>[:vel] Send a note on before rendering (default velocity: 100)
+ *   -o <file>       Write the results table to file instead of stdout
+ *   -c              Add mean hardware counts per block, see perf_counters.h
+ *
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "perf_counters.h"
+#include "unit_host.h"
+#include "wav_file.h"
+
+using unit_host::PerfCounter;
+using unit_host::PerfCounters;
+using unit_host::Runtime;
+using unit_host::Unit;
+using unit_host::WavReader;
+
+namespace {
+
+  constexpr uint32_t k_sweep_samplerate = 48000;
+
+  struct Axis {
+    uint8_t id;
+    std::vector<int32_t> values;
+  };
+
+  struct Config {
+    const char * unit_path = nullptr;
+    const char * in_path = nullptr;
+    std::vector<Axis> axes;
+    size_t frames = k_sweep_samplerate;
+    uint16_t frames_per_buffer = 64;
+    int note = -1;
+    int velocity = 100;
+    bool counters = false;
+  };
+
+  struct PointResult {
+    bool done = false;
+    uint64_t cycles = 0;       // Sum over render calls
+    uint64_t max_cycles = 0;   // Most expensive render call
+    uint64_t hash = 0;         // FNV-1a over output sample bits
+    float peak = 0.f;
+    bool non_finite = false;
+    uint64_t counts[unit_host::k_perf_counter_count] = {0};  // Sums over render calls, with -c
+  };
+
+  void usage() {
+    std::fprintf(stderr,
+                 "usage: unit-sweep [-j jobs] [-d seconds] [-b frames] [-i in.wav] [-n note[:vel]] [-o out.csv] [-c] "
+                 "-p <id>=all|<min>:<max>[:<step>]|<v0>,<v1>,... [-p ...] <unit.so>\n");
+  }
+
+  bool parse_axis(const char * spec, Axis & axis) {
+    int id;
+    int n = 0;
+    if (std::sscanf(spec, "%d=%n", &id, &n) != 1 || n == 0 || id < 0 || id >= UNIT_MAX_PARAM_COUNT)
+      return false;
+    axis.id = (uint8_t)id;
+    axis.values.clear();
+
+    const char * values = spec + n;
+    int min, max, step = 1;
+    if (!std::strcmp(values, "all"))
+      return true;  // Note: expanded once the unit header is known
+    if (std::strchr(values, ':')) {
+      if (std::sscanf(values, "%d:%d:%d", &min, &max, &step) < 2 || step <= 0 || max < min)
+        return false;
+      for (int v = min; v <= max; v += step)
+        axis.values.push_back(v);
+      return true;
+    }
+    for (const char * p = values; *p;) {
+      char * end;
+      axis.values.push_back((int32_t)std::strtol(p, &end, 10));
+      if (end == p)
+        return false;
+      p = (*end == ',') ? end + 1 : end;
+    }
+    return !axis.values.empty();
+  }
+
+  inline void fnv1a(uint64_t & hash, const float * samples, size_t count) {
+    const uint8_t * bytes = reinterpret_cast<const uint8_t *>(samples);
+    for (size_t i = 0; i < count * sizeof(float); ++i) {
+      hash ^= bytes[i];
+      hash *= 0x100000001B3ULL;
+    }
+  }
+
+  /**
+   * Render one point of the grid with a freshly loaded unit.
+   */
+  PointResult render_point(const Config & cfg, Unit & unit, WavReader & reader, const PerfCounters * perf,
+                           size_t index) {
+    PointResult res;
+    res.hash = 0xCBF29CE484222325ULL;
+
+    unit.ResetStubs();
+
+    Runtime runtime;
+    runtime.Setup(unit.header->target, k_sweep_samplerate, cfg.frames_per_buffer);
+    if (unit.init(&runtime.desc) != k_unit_err_none)
+      return res;
+
+    for (uint32_t p = 0; p < unit.header->num_params && p < UNIT_MAX_PARAM_COUNT; ++p) {
+      if (unit.set_param_value)
+        unit.set_param_value(p, unit.header->params[p].init);
+    }
+    // Note: first axis varies slowest
+    size_t stride = 1;
+    for (size_t a = cfg.axes.size(); a-- > 0;) {
+      const Axis & axis = cfg.axes[a];
+      if (unit.set_param_value)
+        unit.set_param_value(axis.id, axis.values[(index / stride) % axis.values.size()]);
+      stride *= axis.values.size();
+    }
+
+    if (unit.resume)
+      unit.resume();
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+    if (cfg.note >= 0 && unit.note_on)
+      unit.note_on((uint8_t)cfg.note, (uint8_t)cfg.velocity);
+#elif defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+    if (cfg.note >= 0) {
+      if (runtime.context())
+        runtime.osc_context.pitch = (uint16_t)(cfg.note << 8);
+      if (unit.note_on)
+        unit.note_on((uint8_t)cfg.note, (uint8_t)cfg.velocity);
+    }
+#endif
+
+    const uint16_t in_ch = runtime.desc.input_channels;
+    const uint16_t out_ch = runtime.desc.output_channels;
+    std::vector<float> scratch((size_t)cfg.frames_per_buffer * in_ch, 0.f);
+    std::vector<float> out((size_t)cfg.frames_per_buffer * out_ch, 0.f);
+
+    reader.Rewind();
+    for (size_t done = 0; done < cfg.frames;) {
+      const size_t frames = std::min<size_t>(cfg.frames - done, cfg.frames_per_buffer);
+      const float * in = cfg.in_path ? reader.Read(frames, in_ch, scratch.data()) : scratch.data();
+      Runtime::SetCurrentInput(in);
+
+      unit_host::PerfSample c0, c1;
+      if (perf)
+        perf->Read(c0);
+      const uint64_t t0 = unit_host::CycleCount();
+      unit.render(in, out.data(), (uint32_t)frames);
+      const uint64_t dt = unit_host::CycleCount() - t0;
+      if (perf) {
+        perf->Read(c1);
+        uint64_t delta[unit_host::k_perf_counter_count];
+        perf->Delta(c0, c1, delta);
+        for (int c = 0; c < unit_host::k_perf_counter_count; ++c)
+          res.counts[c] += delta[c];
+      }
+
+      res.cycles += dt;
+      res.max_cycles = std::max(res.max_cycles, dt);
+      fnv1a(res.hash, out.data(), frames * out_ch);
+      for (size_t i = 0; i < frames * out_ch; ++i) {
+        const float a = out[i] < 0.f ? -out[i] : out[i];
+        res.non_finite |= !(a <= 3.4e38f);
+        res.peak = (a > res.peak) ? a : res.peak;
+      }
+      done += frames;
+    }
+
+    if (unit.teardown)
+      unit.teardown();
+
+    res.done = true;
+    return res;
+  }
+
+  void worker(const Config & cfg, std::atomic<size_t> & next, std::vector<PointResult> & results) {
+    Unit unit;
+    std::string error;
+
+    // Note: counters are per thread
+    PerfCounters perf;
+    if (cfg.counters && !perf.Open(error)) {
+      std::fprintf(stderr, "error: %s\n", error.c_str());
+      return;
+    }
+
+    WavReader reader;
+    if (cfg.in_path && !reader.Open(cfg.in_path, error)) {
+      std::fprintf(stderr, "error: %s\n", error.c_str());
+      return;
+    }
+
+    for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < results.size();
+         i = next.fetch_add(1, std::memory_order_relaxed)) {
+      // Note: new copy per point, each copy is a distinct file and thus gets a fresh image
+      //       even if the previous one could not be unmapped (e.g.: STB_GNU_UNIQUE symbols)
+      if (!unit.LoadCopy(cfg.unit_path, error)) {
+        std::fprintf(stderr, "error: %s\n", error.c_str());
+        return;
+      }
+      results[i] = render_point(cfg, unit, reader, cfg.counters ? &perf : nullptr, i);
+      unit.Unload();
+    }
+  }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+  Config cfg;
+  unsigned jobs = std::max(1U, std::thread::hardware_concurrency());
+  const char * out_path = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:j:d:b:i:n:o:c")) != -1) {
+    switch (opt) {
+    case 'p': {
+      Axis axis;
+      if (!parse_axis(optarg, axis)) {
+        usage();
+        return 1;
+      }
+      cfg.axes.push_back(axis);
+    } break;
+    case 'j': jobs = (unsigned)std::max(1, std::atoi(optarg)); break;
+    case 'd': cfg.frames = (size_t)(std::atof(optarg) * k_sweep_samplerate); break;
+    case 'b': cfg.frames_per_buffer = (uint16_t)std::atoi(optarg); break;
+    case 'i': cfg.in_path = optarg; break;
+    case 'n':
+      if (std::sscanf(optarg, "%d:%d", &cfg.note, &cfg.velocity) < 1) {
+        usage();
+        return 1;
+      }
+      break;
+    case 'o': out_path = optarg; break;
+    case 'c': cfg.counters = true; break;
+    default: usage(); return 1;
+    }
+  }
+  if (argc - optind != 1 || cfg.axes.empty() || cfg.frames_per_buffer == 0) {
+    usage();
+    return 1;
+  }
+  cfg.unit_path = argv[optind];
+
+  // Note: header only, instances are loaded by workers
+  Unit probe;
+  std::string error;
+  if (!probe.Load(cfg.unit_path, error)) {
+    std::fprintf(stderr, "error: %s\n", error.c_str());
+    return 1;
+  }
+
+  size_t points = 1;
+  for (Axis & axis : cfg.axes) {
+    if (axis.values.empty()) {
+      const unit_param_t & param = probe.header->params[axis.id];
+      for (int32_t v = param.min; v <= param.max; ++v)
+        axis.values.push_back(v);
+    }
+    points *= axis.values.size();
+  }
+  probe.Unload();
+
+  std::vector<PointResult> results(points);
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  for (unsigned j = 0; j < std::min<size_t>(jobs, points); ++j)
+    pool.emplace_back(worker, std::cref(cfg), std::ref(next), std::ref(results));
+  for (std::thread & t : pool)
+    t.join();
+
+  FILE * out = out_path ? std::fopen(out_path, "w") : stdout;
+  if (!out) {
+    std::fprintf(stderr, "error: cannot open %s\n", out_path);
+    return 1;
+  }
+
+  const size_t blocks = (cfg.frames + cfg.frames_per_buffer - 1) / cfg.frames_per_buffer;
+  for (const Axis & axis : cfg.axes)
+    std::fprintf(out, "p%u,", axis.id);
+  std::fprintf(out, "cycles,cycles_per_block,max_block_cycles,peak,non_finite,hash");
+  if (cfg.counters) {
+    for (int c = 0; c < unit_host::k_perf_counter_count; ++c)
+      std::fprintf(out, ",hw_%s_per_block", PerfCounters::Name((PerfCounter)c));
+  }
+  std::fprintf(out, "\n");
+
+  bool ok = true;
+  for (size_t i = 0; i < points; ++i) {
+    size_t stride = points;
+    for (const Axis & axis : cfg.axes) {
+      stride /= axis.values.size();
+      std::fprintf(out, "%d,", axis.values[(i / stride) % axis.values.size()]);
+    }
+    const PointResult & r = results[i];
+    if (!r.done) {
+      std::fprintf(out, ",,,,,failed%s\n", cfg.counters ? ",,,," : "");
+      ok = false;
+      continue;
+    }
+    std::fprintf(out, "%llu,%llu,%llu,%.6f,%d,%016llx", (unsigned long long)r.cycles,
+                 (unsigned long long)(blocks ? r.cycles / blocks : 0), (unsigned long long)r.max_cycles, r.peak,
+                 r.non_finite ? 1 : 0, (unsigned long long)r.hash);
+    if (cfg.counters) {
+      for (int c = 0; c < unit_host::k_perf_counter_count; ++c)
+        std::fprintf(out, ",%.1f", blocks ? (double)r.counts[c] / blocks : 0.);
+    }
+    std::fprintf(out, "\n");
+  }
+
+  if (out != stdout)
+    std::fclose(out);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+/**
+ * @file unit_trace_recorder.c
+ * @brief Render trace recorder shim
+ *
+ * Linked into units built with TRACE=1, see unit_trace_shim.h. Exports the
+ * unit_* callbacks, appends a record to the trace for every state changing
+ * call, and forwards to the unit's own implementation.
+ *
+ * Environment:
+ *   UNIT_TRACE_PATH   Output file (default: unit.trace)
+ *   UNIT_TRACE_INPUT  If set to 1, also record input audio of render calls
+ *
+ * Note: records are appended through a large stdio buffer, so that most calls
+ *       only copy a few bytes. The file is still written from the calling
+ *       thread when that buffer fills up, which perturbs timing: use the trace
+ *       for replay, not the timings of the recording session.
+ *
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TRACE_RECORDER
+#include "unit.h"
+#include "unit_trace.h"
+#include "unit_trace_shim.h"
+
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+#include "unit_osc.h"
+#elif defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+#include "unit_genericfx.h"
+#endif
+
+#if defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+#define TRACE_UNIT_HEADER (unit_header.common)
+#else
+#define TRACE_UNIT_HEADER (unit_header)
+#endif
+
+#define TRACE_STDIO_BUFFER_SIZE (1U << 20)
+#define TRACE_CONTEXT_MAX_SIZE  (64U)
+
+/*===========================================================================*/
+/* Traced unit callbacks, see unit_trace_shim.h */
+/*===========================================================================*/
+
+int8_t UNIT_TRACE_TRACED(unit_init)(const unit_runtime_desc_t *);
+void UNIT_TRACE_TRACED(unit_teardown)();
+void UNIT_TRACE_TRACED(unit_reset)();
+void UNIT_TRACE_TRACED(unit_resume)();
+void UNIT_TRACE_TRACED(unit_suspend)();
+void UNIT_TRACE_TRACED(unit_render)(const float *, float *, uint32_t);
+int32_t UNIT_TRACE_TRACED(unit_get_param_value)(uint8_t);
+const char * UNIT_TRACE_TRACED(unit_get_param_str_value)(uint8_t, int32_t);
+void UNIT_TRACE_TRACED(unit_set_param_value)(uint8_t, int32_t);
+void UNIT_TRACE_TRACED(unit_set_param_values)(const int32_t *, uint32_t);
+void UNIT_TRACE_TRACED(unit_set_tempo)(uint32_t);
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+uint8_t UNIT_TRACE_TRACED(unit_get_preset_index)();
+const char * UNIT_TRACE_TRACED(unit_get_preset_name)(uint8_t);
+void UNIT_TRACE_TRACED(unit_load_preset)(uint8_t);
+const uint8_t * UNIT_TRACE_TRACED(unit_get_param_bmp_value)(uint8_t, int32_t);
+void UNIT_TRACE_TRACED(unit_gate_on)(uint8_t);
+void UNIT_TRACE_TRACED(unit_gate_off)(void);
+#else
+void UNIT_TRACE_TRACED(unit_tempo_4ppqn_tick)(uint32_t);
+#endif
+#if defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+void UNIT_TRACE_TRACED(unit_touch_event)(uint8_t, uint8_t, uint32_t, uint32_t);
+#else
+void UNIT_TRACE_TRACED(unit_note_on)(uint8_t, uint8_t);
+void UNIT_TRACE_TRACED(unit_note_off)(uint8_t);
+void UNIT_TRACE_TRACED(unit_all_note_off)(void);
+void UNIT_TRACE_TRACED(unit_pitch_bend)(uint16_t);
+void UNIT_TRACE_TRACED(unit_channel_pressure)(uint8_t);
+void UNIT_TRACE_TRACED(unit_aftertouch)(uint8_t, uint8_t);
+#endif
+
+/*===========================================================================*/
+/* Recorder state */
+/*===========================================================================*/
+
+static struct {
+  FILE * file;
+  char * stdio_buffer;
+  atomic_flag lock;
+  uint32_t frame;
+  uint32_t flags;
+  uint8_t input_channels;
+  const void * context;
+  uint32_t context_size;
+  uint8_t context_last[TRACE_CONTEXT_MAX_SIZE];
+} s_trace = {
+  .lock = ATOMIC_FLAG_INIT,
+};
+
+static const uint8_t s_zero_pad[UNIT_TRACE_ALIGN] = {0};
+
+static inline void trace_lock(void) {
+  while (atomic_flag_test_and_set_explicit(&s_trace.lock, memory_order_acquire))
+    ;
+}
+
+static inline void trace_unlock(void) {
+  atomic_flag_clear_explicit(&s_trace.lock, memory_order_release);
+}
+
+static void trace_write_locked(uint8_t type, uint8_t arg0, uint16_t arg1, uint32_t value0, uint32_t value1,
+                               const void * payload) {
+  if (!s_trace.file)
+    return;
+
+  const unit_trace_record_t rec = {
+    .frame = s_trace.frame,
+    .type = type,
+    .arg0 = arg0,
+    .arg1 = arg1,
+    .value0 = value0,
+    .value1 = value1,
+  };
+  fwrite(&rec, sizeof(rec), 1, s_trace.file);
+
+  if (type & k_unit_trace_rec_payload) {
+    // Note: value1 holds the payload size for these record types
+    if (value1) {
+      fwrite(payload, 1, value1, s_trace.file);
+      fwrite(s_zero_pad, 1, UNIT_TRACE_PAD(value1) - value1, s_trace.file);
+    }
+  }
+}
+
+static inline void trace_write(uint8_t type, uint8_t arg0, uint16_t arg1, uint32_t value0, uint32_t value1) {
+  trace_lock();
+  trace_write_locked(type, arg0, arg1, value0, value1, NULL);
+  trace_unlock();
+}
+
+static uint32_t trace_context_size(const unit_runtime_desc_t * desc) {
+  // Note: only the leading data fields are captured, function pointers are not replayable
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+  if ((desc->target & UNIT_TARGET_MODULE_MASK) == k_unit_module_osc && desc->hooks.runtime_context)
+    return offsetof(unit_runtime_osc_context_t, notify_input_usage);
+#elif defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+  if (desc->hooks.runtime_context)
+    return offsetof(unit_runtime_genericfx_context_t, get_raw_input);
+#endif
+  (void)desc;
+  return 0;
+}
+
+static void trace_open(const unit_runtime_desc_t * desc) {
+  const char * path = getenv("UNIT_TRACE_PATH");
+  const char * input = getenv("UNIT_TRACE_INPUT");
+
+  s_trace.file = fopen(path ? path : "unit.trace", "wb");
+  if (!s_trace.file)
+    return;
+
+  s_trace.stdio_buffer = (char *)malloc(TRACE_STDIO_BUFFER_SIZE);
+  if (s_trace.stdio_buffer)
+    setvbuf(s_trace.file, s_trace.stdio_buffer, _IOFBF, TRACE_STDIO_BUFFER_SIZE);
+
+  s_trace.frame = 0;
+  s_trace.flags = (input && input[0] == '1') ? k_unit_trace_flag_input_audio : k_unit_trace_flags_none;
+  s_trace.input_channels = desc->input_channels;
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+  s_trace.context = NULL;
+#else
+  s_trace.context = desc->hooks.runtime_context;
+#endif
+  s_trace.context_size = trace_context_size(desc);
+  if (s_trace.context_size > TRACE_CONTEXT_MAX_SIZE)
+    s_trace.context_size = TRACE_CONTEXT_MAX_SIZE;
+  // Note: force a first snapshot
+  memset(s_trace.context_last, 0xFF, sizeof(s_trace.context_last));
+
+  unit_trace_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.magic = UNIT_TRACE_MAGIC;
+  header.version = UNIT_TRACE_VERSION;
+  header.header_size = sizeof(header);
+  header.flags = s_trace.flags;
+  header.target = desc->target;
+  header.api = desc->api;
+  header.samplerate = desc->samplerate;
+  header.frames_per_buffer = desc->frames_per_buffer;
+  header.input_channels = desc->input_channels;
+  header.output_channels = desc->output_channels;
+  header.dev_id = TRACE_UNIT_HEADER.dev_id;
+  header.unit_id = TRACE_UNIT_HEADER.unit_id;
+  header.unit_version = TRACE_UNIT_HEADER.version;
+  header.context_size = s_trace.context_size;
+  strncpy(header.unit_name, TRACE_UNIT_HEADER.name, UNIT_TRACE_NAME_SIZE - 1);
+  fwrite(&header, sizeof(header), 1, s_trace.file);
+}
+
+static void trace_close(void) {
+  if (!s_trace.file)
+    return;
+  fclose(s_trace.file);
+  s_trace.file = NULL;
+  free(s_trace.stdio_buffer);
+  s_trace.stdio_buffer = NULL;
+}
+
+/*===========================================================================*/
+/* Exported callbacks */
+/*===========================================================================*/
+
+__unit_callback int8_t unit_init(const unit_runtime_desc_t * desc) {
+  const int8_t err = UNIT_TRACE_TRACED(unit_init)(desc);
+  if (desc) {
+    trace_lock();
+    // Note: unit_init() may be called again without a teardown in between
+    trace_close();
+    trace_open(desc);
+    trace_write_locked(k_unit_trace_rec_init, 0, 0, (uint32_t)(int32_t)err, 0, NULL);
+    trace_unlock();
+  }
+  return err;
+}
+
+__unit_callback void unit_teardown() {
+  UNIT_TRACE_TRACED(unit_teardown)();
+  trace_write(k_unit_trace_rec_teardown, 0, 0, 0, 0);
+  trace_lock();
+  trace_close();
+  trace_unlock();
+}
+
+__unit_callback void unit_reset() {
+  trace_write(k_unit_trace_rec_reset, 0, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_reset)();
+}
+
+__unit_callback void unit_resume() {
+  trace_write(k_unit_trace_rec_resume, 0, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_resume)();
+}
+
+__unit_callback void unit_suspend() {
+  trace_write(k_unit_trace_rec_suspend, 0, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_suspend)();
+}
+
+__unit_callback void unit_render(const float * in, float * out, uint32_t frames) {
+  trace_lock();
+  if (s_trace.context_size && memcmp(s_trace.context_last, s_trace.context, s_trace.context_size)) {
+    memcpy(s_trace.context_last, s_trace.context, s_trace.context_size);
+    trace_write_locked(k_unit_trace_rec_context, 0, 0, 0, s_trace.context_size, s_trace.context_last);
+  }
+  const uint32_t input_size = (s_trace.flags & k_unit_trace_flag_input_audio) && in
+                              ? frames * s_trace.input_channels * sizeof(float) : 0;
+  trace_write_locked(k_unit_trace_rec_render, 0, 0, frames, input_size, in);
+  trace_unlock();
+
+  UNIT_TRACE_TRACED(unit_render)(in, out, frames);
+
+  trace_lock();
+  s_trace.frame += frames;
+  trace_unlock();
+}
+
+__unit_callback int32_t unit_get_param_value(uint8_t id) {
+  return UNIT_TRACE_TRACED(unit_get_param_value)(id);
+}
+
+__unit_callback const char * unit_get_param_str_value(uint8_t id, int32_t value) {
+  return UNIT_TRACE_TRACED(unit_get_param_str_value)(id, value);
+}
+
+__unit_callback void unit_set_param_value(uint8_t id, int32_t value) {
+  trace_write(k_unit_trace_rec_set_param_value, id, 0, (uint32_t)value, 0);
+  UNIT_TRACE_TRACED(unit_set_param_value)(id, value);
+}
+
+__unit_callback void unit_set_param_values(const int32_t * values, uint32_t mask) {
+  const uint32_t count = mask ? 32 - __builtin_clz(mask) : 0;
+  trace_lock();
+  trace_write_locked(k_unit_trace_rec_set_param_values, 0, 0, mask, count * sizeof(int32_t), values);
+  trace_unlock();
+  UNIT_TRACE_TRACED(unit_set_param_values)(values, mask);
+}
+
+__unit_callback void unit_set_tempo(uint32_t tempo) {
+  trace_write(k_unit_trace_rec_set_tempo, 0, 0, tempo, 0);
+  UNIT_TRACE_TRACED(unit_set_tempo)(tempo);
+}
+
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+
+__unit_callback uint8_t unit_get_preset_index() {
+  return UNIT_TRACE_TRACED(unit_get_preset_index)();
+}
+
+__unit_callback const char * unit_get_preset_name(uint8_t idx) {
+  return UNIT_TRACE_TRACED(unit_get_preset_name)(idx);
+}
+
+__unit_callback void unit_load_preset(uint8_t idx) {
+  trace_write(k_unit_trace_rec_load_preset, idx, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_load_preset)(idx);
+}
+
+__unit_callback const uint8_t * unit_get_param_bmp_value(uint8_t id, int32_t value) {
+  return UNIT_TRACE_TRACED(unit_get_param_bmp_value)(id, value);
+}
+
+__unit_callback void unit_gate_on(uint8_t velocity) {
+  trace_write(k_unit_trace_rec_gate_on, velocity, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_gate_on)(velocity);
+}
+
+__unit_callback void unit_gate_off(void) {
+  trace_write(k_unit_trace_rec_gate_off, 0, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_gate_off)();
+}
+
+#else
+
+__unit_callback void unit_tempo_4ppqn_tick(uint32_t counter) {
+  trace_write(k_unit_trace_rec_tempo_4ppqn_tick, 0, 0, counter, 0);
+  UNIT_TRACE_TRACED(unit_tempo_4ppqn_tick)(counter);
+}
+
+#endif
+
+#if defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+
+__unit_callback void unit_touch_event(uint8_t id, uint8_t phase, uint32_t x, uint32_t y) {
+  trace_write(k_unit_trace_rec_touch_event, id, phase, x, y);
+  UNIT_TRACE_TRACED(unit_touch_event)(id, phase, x, y);
+}
+
+#else
+
+__unit_callback void unit_note_on(uint8_t note, uint8_t velocity) {
+  trace_write(k_unit_trace_rec_note_on, note, velocity, 0, 0);
+  UNIT_TRACE_TRACED(unit_note_on)(note, velocity);
+}
+
+__unit_callback void unit_note_off(uint8_t note) {
+  trace_write(k_unit_trace_rec_note_off, note, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_note_off)(note);
+}
+
+__unit_callback void unit_all_note_off(void) {
+  trace_write(k_unit_trace_rec_all_note_off, 0, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_all_note_off)();
+}
+
+__unit_callback void unit_pitch_bend(uint16_t bend) {
+  trace_write(k_unit_trace_rec_pitch_bend, 0, bend, 0, 0);
+  UNIT_TRACE_TRACED(unit_pitch_bend)(bend);
+}
+
+__unit_callback void unit_channel_pressure(uint8_t pressure) {
+  trace_write(k_unit_trace_rec_channel_pressure, pressure, 0, 0, 0);
+  UNIT_TRACE_TRACED(unit_channel_pressure)(pressure);
+}
+
+__unit_callback void unit_aftertouch(uint8_t note, uint8_t aftertouch) {
+  trace_write(k_unit_trace_rec_aftertouch, note, aftertouch, 0, 0);
+  UNIT_TRACE_TRACED(unit_aftertouch)(note, aftertouch);
+}
+
+#endif
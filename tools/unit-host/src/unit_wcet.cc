@@ -0,0 +1,691 @@
+/**
+ * @file unit_wcet.cc
+ * @brief Worst-case render cost search
+ *
+ * Drives a unit with randomized adversarial callback sequences (parameter
+ * changes on every block, note storms, tempo changes, silence to full scale
+ * input transitions...), measures each unit_render() call, and reports the
+ * most expensive block found together with the callbacks that led to it.
+ *
+ * Sequences are generated from a seed and each runs on a freshly loaded and
+ * initialized private copy of the unit's shared object, so that file-static
+ * state does not carry over between sequences (unit_init() alone does not
+ * reset it). The worst candidates can thus be measured again to rule out host
+ * noise, and replays of the saved trace start from the same state. The
+ * winning sequence is saved as a render trace (see inc/unit_trace.h) ending
+ * with the worst block, for use with unit-replay.
+ *
+ * Usage: unit-wcet [options] <unit.so>
+ *   -m <list>       Comma separated strategies: params, notes, tempo, input or all (default: all)
+ *   -s <seed>       Random seed (default: 1)
+ *   -n <count>      Number of sequences (default: 200)
+ *   -l <blocks>     Blocks per sequence (default: 256)
+ *   -b <frames>     Frames per buffer (default: 64)
+ *   -w <blocks>     Leading blocks excluded from the search (default: 4)
+ *   -v <count>      Measurements of each candidate block (default: 5)
+ *   -e <blocks>     Blocks of events listed before the worst block (default: 4)
+ *   -o <file>       Output trace (default: wcet.trace)
+ *
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "unit_host.h"
+
+using unit_host::Runtime;
+using unit_host::Unit;
+
+namespace {
+
+  constexpr uint32_t k_wcet_samplerate = 48000;
+  constexpr size_t k_candidate_count = 16;
+
+  enum Strategy {
+    k_strategy_params = 1U << 0,
+    k_strategy_notes = 1U << 1,
+    k_strategy_tempo = 1U << 2,
+    k_strategy_input = 1U << 3,
+    k_strategy_all = (1U << 4) - 1,
+  };
+
+  struct Config {
+    const char * unit_path = nullptr;
+    const char * out_path = "wcet.trace";
+    uint32_t strategies = k_strategy_all;
+    uint64_t seed = 1;
+    uint32_t sequences = 200;
+    uint32_t blocks = 256;
+    uint16_t frames_per_buffer = 64;
+    uint32_t warmup = 4;
+    uint32_t verify = 5;
+    uint32_t listed = 4;
+  };
+
+  struct Event {
+    unit_trace_record_t rec;
+    std::vector<uint8_t> payload;
+  };
+
+  struct Block {
+    std::vector<Event> events;  // Issued before rendering the block
+    std::vector<float> input;
+  };
+
+  typedef std::vector<Block> Sequence;
+
+  struct Candidate {
+    uint64_t cycles;
+    uint32_t sequence;
+    uint32_t block;
+  };
+
+  void usage() {
+    std::fprintf(stderr,
+                 "usage: unit-wcet [-m params,notes,tempo,input|all] [-s seed] [-n sequences] [-l blocks] [-b frames] "
+                 "[-w blocks] [-v count] [-e blocks] [-o out.trace] <unit.so>\n");
+  }
+
+  bool parse_strategies(const char * arg, uint32_t & mask) {
+    mask = 0;
+    std::string list(arg);
+    size_t pos = 0;
+    while (pos <= list.size()) {
+      const size_t end = std::min(list.find(',', pos), list.size());
+      const std::string name = list.substr(pos, end - pos);
+      if (name == "params")
+        mask |= k_strategy_params;
+      else if (name == "notes")
+        mask |= k_strategy_notes;
+      else if (name == "tempo")
+        mask |= k_strategy_tempo;
+      else if (name == "input")
+        mask |= k_strategy_input;
+      else if (name == "all")
+        mask |= k_strategy_all;
+      else
+        return false;
+      pos = end + 1;
+    }
+    return mask != 0;
+  }
+
+  /**
+   * SplitMix64, so that sequences only depend on the seed and not on the host's standard library.
+   */
+  class Random {
+   public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t Next() {
+      uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, n)
+    uint32_t Below(uint32_t n) { return n ? (uint32_t)(Next() % n) : 0; }
+
+    // Uniform in [lo, hi]
+    int32_t Range(int32_t lo, int32_t hi) { return lo + (int32_t)Below((uint32_t)(hi - lo) + 1); }
+
+    bool Chance(float p) { return (Next() >> 40) < (uint64_t)(p * (float)(1ULL << 24)); }
+
+    // Uniform in [-1, 1)
+    float Bipolar() { return (float)(Next() >> 40) * (2.f / (float)(1ULL << 24)) - 1.f; }
+
+   private:
+    uint64_t state_;
+  };
+
+  /*===========================================================================*/
+  /* Sequence generation */
+  /*===========================================================================*/
+
+  enum InputShape {
+    k_input_silence = 0,
+    k_input_noise,
+    k_input_square,
+    k_input_dc,
+    k_input_tiny,  // Subnormal range
+    k_num_input_shapes,
+  };
+
+  class Generator {
+   public:
+    Generator(const Config & cfg, const Unit & unit, Runtime & runtime, uint64_t seed)
+        : cfg_(cfg), unit_(unit), runtime_(runtime), rng_(seed) {
+      // Note: per sequence intensities, so that both sparse and dense event patterns are explored
+      static const float k_rates[] = {0.05f, 0.25f, 1.f};
+      param_rate_ = k_rates[rng_.Below(3)];
+      note_rate_ = k_rates[rng_.Below(3)];
+      tempo_rate_ = k_rates[rng_.Below(3)] * 0.5f;
+      input_rate_ = k_rates[rng_.Below(3)] * 0.25f;
+
+      context_.resize(runtime.context_data_size());
+      if (!context_.empty())
+        std::memcpy(context_.data(), runtime.context(), context_.size());
+    }
+
+    Sequence Generate() {
+      Sequence seq(cfg_.blocks);
+      for (uint32_t b = 0; b < cfg_.blocks; ++b) {
+        Block & block = seq[b];
+        frame_ = b * cfg_.frames_per_buffer;
+        context_dirty_ = false;
+
+        if (cfg_.strategies & k_strategy_params)
+          GenerateParams(block);
+        if (cfg_.strategies & k_strategy_notes)
+          GenerateNotes(block);
+        if (cfg_.strategies & k_strategy_tempo)
+          GenerateTempo(block);
+        if (context_dirty_) {
+          Event & ev = Push(block, k_unit_trace_rec_context);
+          ev.rec.value1 = (uint32_t)context_.size();
+          ev.payload = context_;
+        }
+        GenerateInput(block);
+      }
+      return seq;
+    }
+
+   private:
+    Event & Push(Block & block, uint8_t type, uint8_t arg0 = 0, uint16_t arg1 = 0, uint32_t value0 = 0,
+                 uint32_t value1 = 0) {
+      block.events.push_back(Event());
+      Event & ev = block.events.back();
+      ev.rec.frame = frame_;
+      ev.rec.type = type;
+      ev.rec.arg0 = arg0;
+      ev.rec.arg1 = arg1;
+      ev.rec.value0 = value0;
+      ev.rec.value1 = value1;
+      return ev;
+    }
+
+    void GenerateParams(Block & block) {
+      const uint32_t num_params = std::min<uint32_t>(unit_.header->num_params, UNIT_MAX_PARAM_COUNT);
+      if (num_params && rng_.Chance(param_rate_)) {
+        // Note: one parameter, or a storm touching all of them
+        const uint32_t count = rng_.Chance(0.25f) ? num_params : 1 + rng_.Below(num_params);
+        for (uint32_t i = 0; i < count; ++i) {
+          const uint8_t id = (count == num_params) ? (uint8_t)i : (uint8_t)rng_.Below(num_params);
+          const unit_param_t & p = unit_.header->params[id];
+          if (p.min == p.max && p.min == 0)
+            continue;
+          int32_t value;
+          switch (rng_.Below(4)) {
+          case 0: value = p.min; break;
+          case 1: value = p.max; break;
+          case 2: value = p.init; break;
+          default: value = rng_.Range(std::min(p.min, p.max), std::max(p.min, p.max)); break;
+          }
+          Push(block, k_unit_trace_rec_set_param_value, id, 0, (uint32_t)value);
+        }
+      }
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+      if (unit_.header->num_presets && rng_.Chance(param_rate_ * 0.05f))
+        Push(block, k_unit_trace_rec_load_preset, (uint8_t)rng_.Below(unit_.header->num_presets));
+#elif defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+      if (!context_.empty() && rng_.Chance(param_rate_)) {
+        unit_runtime_osc_context_t & ctx = context();
+        ctx.shape_lfo = (int32_t)(uint32_t)rng_.Next();
+        context_dirty_ = true;
+      }
+#endif
+    }
+
+    void GenerateNotes(Block & block) {
+      if (!rng_.Chance(note_rate_))
+        return;
+#if defined(UNIT_HOST_PLATFORM_NTS3_KAOSS)
+      // Note: touch lifecycles on the runtime's touch area, see unit_genericfx.h
+      const uint32_t w = std::max<uint32_t>(1, runtime_.genericfx_context.touch_area_width);
+      const uint32_t h = std::max<uint32_t>(1, runtime_.genericfx_context.touch_area_height);
+      const uint32_t count = 1 + rng_.Below(4);
+      for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t id = (uint8_t)rng_.Below(2);
+        uint8_t phase;
+        if (!touching_[id])
+          phase = k_unit_touch_phase_began;
+        else
+          phase = rng_.Chance(0.2f) ? k_unit_touch_phase_ended : k_unit_touch_phase_moved;
+        touching_[id] = (phase != k_unit_touch_phase_ended);
+        Push(block, k_unit_trace_rec_touch_event, id, phase, rng_.Below(w), rng_.Below(h));
+      }
+#else
+      // Note: storms of up to 16 notes per block
+      const uint32_t count = rng_.Chance(0.2f) ? 16 : 1 + rng_.Below(3);
+      for (uint32_t i = 0; i < count; ++i) {
+        switch (rng_.Below(8)) {
+        case 0:
+          Push(block, k_unit_trace_rec_all_note_off);
+          break;
+        case 1:
+          Push(block, k_unit_trace_rec_pitch_bend, 0, (uint16_t)rng_.Below(0x4000));
+          break;
+        case 2:
+          Push(block, k_unit_trace_rec_channel_pressure, (uint8_t)rng_.Below(128));
+          break;
+        case 3:
+          Push(block, k_unit_trace_rec_aftertouch, (uint8_t)rng_.Below(128), (uint16_t)rng_.Below(128));
+          break;
+        case 4:
+        case 5:
+          Push(block, k_unit_trace_rec_note_off, last_note_);
+          break;
+        default: {
+          last_note_ = (uint8_t)rng_.Below(128);
+          Push(block, k_unit_trace_rec_note_on, last_note_, (uint16_t)(1 + rng_.Below(127)));
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+          if (!context_.empty()) {
+            context().pitch = (uint16_t)((last_note_ << 8) | rng_.Below(256));
+            context_dirty_ = true;
+          }
+#endif
+        } break;
+        }
+      }
+#if defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+      if (rng_.Chance(0.5f)) {
+        if (rng_.Chance(0.5f))
+          Push(block, k_unit_trace_rec_gate_on, (uint8_t)(1 + rng_.Below(127)));
+        else
+          Push(block, k_unit_trace_rec_gate_off);
+      }
+#endif
+#endif
+    }
+
+    void GenerateTempo(Block & block) {
+      if (rng_.Chance(tempo_rate_)) {
+        // Note: 16.16 fixed point BPM, 30 to 300
+        const uint32_t bpm = (uint32_t)rng_.Range(30, 300);
+        Push(block, k_unit_trace_rec_set_tempo, 0, 0, (bpm << 16) | rng_.Below(0x10000));
+      }
+#if !defined(UNIT_HOST_PLATFORM_DRUMLOGUE)
+      if (rng_.Chance(tempo_rate_)) {
+        const uint32_t ticks = rng_.Chance(0.1f) ? 4 : 1;
+        for (uint32_t i = 0; i < ticks; ++i)
+          Push(block, k_unit_trace_rec_tempo_4ppqn_tick, 0, 0, tick_++);
+      }
+#endif
+    }
+
+    void GenerateInput(Block & block) {
+      const size_t channels = runtime_.desc.input_channels;
+      if (!channels)
+        return;
+      if ((cfg_.strategies & k_strategy_input) && rng_.Chance(input_rate_))
+        shape_ = rng_.Below(k_num_input_shapes);
+
+      block.input.assign((size_t)cfg_.frames_per_buffer * channels, 0.f);
+      for (size_t f = 0; f < cfg_.frames_per_buffer; ++f) {
+        for (size_t c = 0; c < channels; ++c) {
+          float & x = block.input[f * channels + c];
+          switch (shape_) {
+          case k_input_noise: x = rng_.Bipolar(); break;
+          case k_input_square: x = ((frame_ + f) & 32) ? 1.f : -1.f; break;
+          case k_input_dc: x = 1.f; break;
+          case k_input_tiny: x = rng_.Bipolar() * 1e-39f; break;
+          default: break;
+          }
+        }
+      }
+    }
+
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+    unit_runtime_osc_context_t & context() {
+      return *reinterpret_cast<unit_runtime_osc_context_t *>(context_.data());
+    }
+#endif
+
+    const Config & cfg_;
+    const Unit & unit_;
+    const Runtime & runtime_;
+    Random rng_;
+
+    float param_rate_;
+    float note_rate_;
+    float tempo_rate_;
+    float input_rate_;
+
+    uint32_t frame_ = 0;
+    uint32_t shape_ = k_input_silence;
+    uint32_t tick_ = 0;
+    uint8_t last_note_ = 60;
+    bool touching_[2] = {false, false};
+    std::vector<uint8_t> context_;  // Runtime context data fields, as sent to the unit
+    bool context_dirty_ = false;
+  };
+
+  uint64_t sequence_seed(uint64_t seed, uint32_t index) {
+    Random rng(seed ^ (0xD1B54A32D192ED03ULL * (index + 1)));
+    return rng.Next();
+  }
+
+  /*===========================================================================*/
+  /* Measurement */
+  /*===========================================================================*/
+
+  /**
+   * Render blocks [0, last] of a sequence from a freshly loaded and initialized unit.
+   *
+   * @param cycles Cost of each rendered block.
+   * @param error  Set to a description of the failure, if any.
+   * @return False if the unit failed to load or initialize.
+   */
+  bool run(const Config & cfg, const Sequence & seq, uint32_t last, std::vector<uint64_t> & cycles,
+           std::string & error) {
+    // Note: new copy per sequence, each copy is a distinct file and thus gets a fresh image
+    Unit unit;
+    if (!unit.LoadCopy(cfg.unit_path, error))
+      return false;
+    unit.ResetStubs();
+
+    Runtime runtime;
+    runtime.Setup(unit.header->target, k_wcet_samplerate, cfg.frames_per_buffer);
+    const int8_t err = unit.init(&runtime.desc);
+    if (err != k_unit_err_none) {
+      error = std::string("unit_init failed (") + unit_host::ErrorString(err) + ")";
+      return false;
+    }
+    for (uint32_t p = 0; p < unit.header->num_params && p < UNIT_MAX_PARAM_COUNT; ++p) {
+      if (unit.set_param_value)
+        unit.set_param_value(p, unit.header->params[p].init);
+    }
+    if (unit.resume)
+      unit.resume();
+
+    std::vector<float> silence((size_t)cfg.frames_per_buffer * runtime.desc.input_channels, 0.f);
+    std::vector<float> out((size_t)cfg.frames_per_buffer * runtime.desc.output_channels, 0.f);
+    cycles.assign(last + 1, 0);
+
+    for (uint32_t b = 0; b <= last; ++b) {
+      const Block & block = seq[b];
+      for (const Event & ev : block.events)
+        unit_host::Dispatch(unit, runtime, ev.rec, ev.payload.empty() ? nullptr : ev.payload.data());
+
+      const float * in = block.input.empty() ? silence.data() : block.input.data();
+      Runtime::SetCurrentInput(in);
+      const uint64_t t0 = unit_host::CycleCount();
+      unit.render(in, out.data(), cfg.frames_per_buffer);
+      cycles[b] = unit_host::CycleCount() - t0;
+    }
+
+    if (unit.teardown)
+      unit.teardown();
+    return true;
+  }
+
+  uint64_t median(std::vector<uint64_t> v) {
+    if (v.empty())
+      return 0;
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    return v[v.size() / 2];
+  }
+
+  /*===========================================================================*/
+  /* Report */
+  /*===========================================================================*/
+
+  const char * record_name(uint8_t type) {
+    switch (type) {
+    case k_unit_trace_rec_set_param_value: return "set_param_value";
+    case k_unit_trace_rec_set_tempo: return "set_tempo";
+    case k_unit_trace_rec_tempo_4ppqn_tick: return "tempo_4ppqn_tick";
+    case k_unit_trace_rec_note_on: return "note_on";
+    case k_unit_trace_rec_note_off: return "note_off";
+    case k_unit_trace_rec_gate_on: return "gate_on";
+    case k_unit_trace_rec_gate_off: return "gate_off";
+    case k_unit_trace_rec_all_note_off: return "all_note_off";
+    case k_unit_trace_rec_pitch_bend: return "pitch_bend";
+    case k_unit_trace_rec_channel_pressure: return "channel_pressure";
+    case k_unit_trace_rec_aftertouch: return "aftertouch";
+    case k_unit_trace_rec_load_preset: return "load_preset";
+    case k_unit_trace_rec_touch_event: return "touch_event";
+    case k_unit_trace_rec_context: return "context";
+    default: return "?";
+    }
+  }
+
+  void print_event(const Unit & unit, const Event & ev) {
+    const unit_trace_record_t & r = ev.rec;
+    std::printf("    %-18s", record_name(r.type));
+    switch (r.type) {
+    case k_unit_trace_rec_set_param_value:
+      std::printf(" %u (%.*s) = %d", r.arg0, UNIT_PARAM_NAME_LEN, unit.header->params[r.arg0].name, (int32_t)r.value0);
+      break;
+    case k_unit_trace_rec_set_tempo:
+      std::printf(" %.2f bpm", r.value0 / 65536.);
+      break;
+    case k_unit_trace_rec_tempo_4ppqn_tick: std::printf(" %u", r.value0); break;
+    case k_unit_trace_rec_note_on:
+    case k_unit_trace_rec_aftertouch: std::printf(" %u %u", r.arg0, r.arg1); break;
+    case k_unit_trace_rec_note_off:
+    case k_unit_trace_rec_gate_on:
+    case k_unit_trace_rec_channel_pressure:
+    case k_unit_trace_rec_load_preset: std::printf(" %u", r.arg0); break;
+    case k_unit_trace_rec_pitch_bend: std::printf(" %u", r.arg1); break;
+    case k_unit_trace_rec_touch_event: std::printf(" id %u phase %u at %u,%u", r.arg0, r.arg1, r.value0, r.value1); break;
+#if defined(UNIT_HOST_PLATFORM_NTS1_MKII)
+    case k_unit_trace_rec_context: {
+      const unit_runtime_osc_context_t & ctx = *reinterpret_cast<const unit_runtime_osc_context_t *>(ev.payload.data());
+      std::printf(" pitch %u.%03u shape_lfo %d", ctx.pitch >> 8, (ctx.pitch & 0xFF) * 1000 / 256, ctx.shape_lfo);
+    } break;
+#endif
+    default: break;
+    }
+    std::printf("\n");
+  }
+
+  const char * input_description(const Block & block) {
+    if (block.input.empty())
+      return "none";
+    float peak = 0.f;
+    for (float x : block.input)
+      peak = std::max(peak, x < 0.f ? -x : x);
+    if (peak == 0.f)
+      return "silence";
+    return peak < 1e-30f ? "subnormal" : "full scale";
+  }
+
+  /*===========================================================================*/
+  /* Trace output */
+  /*===========================================================================*/
+
+  void write_record(FILE * fp, const unit_trace_record_t & rec, const void * payload) {
+    static const uint8_t k_zeros[UNIT_TRACE_ALIGN] = {0};
+    std::fwrite(&rec, sizeof(rec), 1, fp);
+    if (rec.type & k_unit_trace_rec_payload) {
+      std::fwrite(payload, 1, rec.value1, fp);
+      std::fwrite(k_zeros, 1, UNIT_TRACE_PAD(rec.value1) - rec.value1, fp);
+    }
+  }
+
+  /**
+   * Save blocks [0, last] of a sequence as a render trace, see inc/unit_trace.h.
+   */
+  bool write_trace(const char * path, const Config & cfg, const Unit & unit, const Sequence & seq, uint32_t last) {
+    FILE * fp = std::fopen(path, "wb");
+    if (!fp)
+      return false;
+
+    Runtime runtime;
+    runtime.Setup(unit.header->target, k_wcet_samplerate, cfg.frames_per_buffer);
+
+    unit_trace_header_t h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = UNIT_TRACE_MAGIC;
+    h.version = UNIT_TRACE_VERSION;
+    h.header_size = sizeof(h);
+    h.flags = runtime.desc.input_channels ? k_unit_trace_flag_input_audio : k_unit_trace_flags_none;
+    h.target = runtime.desc.target;
+    h.api = runtime.desc.api;
+    h.samplerate = runtime.desc.samplerate;
+    h.frames_per_buffer = runtime.desc.frames_per_buffer;
+    h.input_channels = runtime.desc.input_channels;
+    h.output_channels = runtime.desc.output_channels;
+    h.dev_id = unit.header->dev_id;
+    h.unit_id = unit.header->unit_id;
+    h.unit_version = unit.header->version;
+    h.context_size = (uint32_t)runtime.context_data_size();
+    std::snprintf(h.unit_name, UNIT_TRACE_NAME_SIZE, "%.*s", UNIT_NAME_LEN, unit.header->name);
+    std::fwrite(&h, sizeof(h), 1, fp);
+
+    unit_trace_record_t rec;
+    std::memset(&rec, 0, sizeof(rec));
+    rec.type = k_unit_trace_rec_init;
+    write_record(fp, rec, nullptr);
+
+    // Note: same initial state as run()
+    rec.type = k_unit_trace_rec_set_param_value;
+    for (uint32_t p = 0; p < unit.header->num_params && p < UNIT_MAX_PARAM_COUNT; ++p) {
+      rec.arg0 = (uint8_t)p;
+      rec.value0 = (uint32_t)unit.header->params[p].init;
+      write_record(fp, rec, nullptr);
+    }
+    std::memset(&rec, 0, sizeof(rec));
+    rec.type = k_unit_trace_rec_resume;
+    write_record(fp, rec, nullptr);
+
+    for (uint32_t b = 0; b <= last; ++b) {
+      const Block & block = seq[b];
+      for (const Event & ev : block.events)
+        write_record(fp, ev.rec, ev.payload.data());
+
+      std::memset(&rec, 0, sizeof(rec));
+      rec.frame = b * cfg.frames_per_buffer;
+      rec.type = k_unit_trace_rec_render;
+      rec.value0 = cfg.frames_per_buffer;
+      rec.value1 = (uint32_t)(block.input.size() * sizeof(float));
+      write_record(fp, rec, block.input.data());
+    }
+
+    std::memset(&rec, 0, sizeof(rec));
+    rec.frame = (last + 1) * cfg.frames_per_buffer;
+    rec.type = k_unit_trace_rec_teardown;
+    write_record(fp, rec, nullptr);
+
+    const bool ok = !std::ferror(fp);
+    return (std::fclose(fp) == 0) && ok;
+  }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+  Config cfg;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "m:s:n:l:b:w:v:e:o:")) != -1) {
+    switch (opt) {
+    case 'm':
+      if (!parse_strategies(optarg, cfg.strategies)) {
+        usage();
+        return 1;
+      }
+      break;
+    case 's': cfg.seed = std::strtoull(optarg, nullptr, 0); break;
+    case 'n': cfg.sequences = (uint32_t)std::max(1, std::atoi(optarg)); break;
+    case 'l': cfg.blocks = (uint32_t)std::max(1, std::atoi(optarg)); break;
+    case 'b': cfg.frames_per_buffer = (uint16_t)std::atoi(optarg); break;
+    case 'w': cfg.warmup = (uint32_t)std::max(0, std::atoi(optarg)); break;
+    case 'v': cfg.verify = (uint32_t)std::max(1, std::atoi(optarg)); break;
+    case 'e': cfg.listed = (uint32_t)std::max(0, std::atoi(optarg)); break;
+    case 'o': cfg.out_path = optarg; break;
+    default: usage(); return 1;
+    }
+  }
+  if (argc - optind != 1 || cfg.frames_per_buffer == 0 || cfg.warmup >= cfg.blocks) {
+    usage();
+    return 1;
+  }
+  cfg.unit_path = argv[optind];
+
+  // Note: header only, sequences run on private copies, see run()
+  Unit unit;
+  std::string error;
+  if (!unit.Load(cfg.unit_path, error)) {
+    std::fprintf(stderr, "error: %s\n", error.c_str());
+    return 1;
+  }
+
+  // Note: initial runtime context, as seen by generators
+  Runtime runtime;
+  runtime.Setup(unit.header->target, k_wcet_samplerate, cfg.frames_per_buffer);
+
+  // Search: keep the most expensive blocks over all sequences
+  std::vector<Candidate> candidates;
+  std::vector<uint64_t> all_cycles;
+  std::vector<uint64_t> cycles;
+  all_cycles.reserve((size_t)cfg.sequences * (cfg.blocks - cfg.warmup));
+
+  for (uint32_t s = 0; s < cfg.sequences; ++s) {
+    const Sequence seq = Generator(cfg, unit, runtime, sequence_seed(cfg.seed, s)).Generate();
+    if (!run(cfg, seq, cfg.blocks - 1, cycles, error)) {
+      std::fprintf(stderr, "error: %s\n", error.c_str());
+      return 1;
+    }
+    for (uint32_t b = cfg.warmup; b < cfg.blocks; ++b) {
+      all_cycles.push_back(cycles[b]);
+      const Candidate c = {cycles[b], s, b};
+      if (candidates.size() < k_candidate_count || c.cycles > candidates.back().cycles) {
+        if (candidates.size() == k_candidate_count)
+          candidates.pop_back();
+        candidates.insert(std::upper_bound(candidates.begin(), candidates.end(), c,
+                                           [](const Candidate & a, const Candidate & b) { return a.cycles > b.cycles; }),
+                          c);
+      }
+    }
+  }
+
+  // Verification: single measurements may be host noise (interrupts, frequency changes)
+  Candidate worst = {0, 0, 0};
+  std::vector<uint64_t> samples;
+  for (const Candidate & c : candidates) {
+    const Sequence seq = Generator(cfg, unit, runtime, sequence_seed(cfg.seed, c.sequence)).Generate();
+    samples.clear();
+    for (uint32_t v = 0; v < cfg.verify; ++v) {
+      if (!run(cfg, seq, c.block, cycles, error)) {
+        std::fprintf(stderr, "error: %s\n", error.c_str());
+        return 1;
+      }
+      samples.push_back(cycles[c.block]);
+    }
+    const uint64_t m = median(samples);
+    if (m > worst.cycles)
+      worst = {m, c.sequence, c.block};
+  }
+
+  const uint64_t typical = median(all_cycles);
+  std::printf("%s: %zu blocks of %u frames over %u sequences, seed %llu\n", unit.header->name, all_cycles.size(),
+              cfg.frames_per_buffer, cfg.sequences, (unsigned long long)cfg.seed);
+  std::printf("median block: %llu cycles\n", (unsigned long long)typical);
+  std::printf("worst block:  %llu cycles (%.2fx median), sequence %u block %u\n", (unsigned long long)worst.cycles,
+              typical ? (double)worst.cycles / typical : 0., worst.sequence, worst.block);
+
+  const Sequence seq = Generator(cfg, unit, runtime, sequence_seed(cfg.seed, worst.sequence)).Generate();
+  const uint32_t first = worst.block >= cfg.listed ? worst.block - cfg.listed : 0;
+  std::printf("\nevents before the worst block:\n");
+  for (uint32_t b = first; b <= worst.block; ++b) {
+    std::printf("  block %u (frame %u), input %s%s\n", b, b * cfg.frames_per_buffer, input_description(seq[b]),
+                (b == worst.block) ? ", worst" : "");
+    for (const Event & ev : seq[b].events)
+      print_event(unit, ev);
+  }
+
+  if (!write_trace(cfg.out_path, cfg, unit, seq, worst.block)) {
+    std::fprintf(stderr, "error: cannot write %s\n", cfg.out_path);
+    return 1;
+  }
+  std::printf("\nsaved %u blocks to %s\n", worst.block + 1, cfg.out_path);
+
+  return 0;
+}
@@ -0,0 +1,323 @@
+/**
+ * @file wav_file.cc
+ * @brief Streaming WAV file reader and writer
+ *
+ */
+
+#include "wav_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace unit_host {
+
+  namespace {
+
+    constexpr uint16_t k_tag_pcm = 0x0001;
+    constexpr uint16_t k_tag_float = 0x0003;
+    constexpr uint16_t k_tag_extensible = 0xFFFE;
+
+    constexpr size_t k_header_size = 44;
+    constexpr size_t k_page_size = 4096;
+    constexpr size_t k_chunk_size = 1U << 20;  // Multiple of k_page_size
+
+    inline uint16_t rd16(const uint8_t * p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+    inline uint32_t rd32(const uint8_t * p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+    inline void wr16(uint8_t * p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+    inline void wr32(uint8_t * p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+    inline uint16_t sample_size(WavFormat format) {
+      return (format == k_wav_format_int16) ? 2 : (format == k_wav_format_int24) ? 3 : 4;
+    }
+
+    inline float decode(const uint8_t * p, WavFormat format) {
+      switch (format) {
+      case k_wav_format_int16:
+        return (int16_t)rd16(p) * (1.f / 32768.f);
+      case k_wav_format_int24:
+        // Note: shift into the upper bytes for sign extension
+        return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) * (1.f / 2147483648.f);
+      default: {
+        float f;
+        std::memcpy(&f, p, sizeof(f));
+        return f;
+      }
+      }
+    }
+
+    inline uint32_t encode(float x, WavFormat format) {
+      switch (format) {
+      case k_wav_format_int16:
+        x = (x > 1.f) ? 1.f : (x < -1.f) ? -1.f : x;
+        return (uint32_t)(int32_t)lrintf(x * 32767.f);
+      case k_wav_format_int24:
+        x = (x > 1.f) ? 1.f : (x < -1.f) ? -1.f : x;
+        return (uint32_t)(int32_t)lrintf(x * 8388607.f);
+      default: {
+        uint32_t u;
+        std::memcpy(&u, &x, sizeof(u));
+        return u;
+      }
+      }
+    }
+
+  }  // namespace
+
+  bool ParseWavFormat(const char * name, WavFormat & format) {
+    if (!std::strcmp(name, "float") || !std::strcmp(name, "32f"))
+      format = k_wav_format_float32;
+    else if (!std::strcmp(name, "16"))
+      format = k_wav_format_int16;
+    else if (!std::strcmp(name, "24"))
+      format = k_wav_format_int24;
+    else
+      return false;
+    return true;
+  }
+
+  /*===========================================================================*/
+  /* Reader */
+  /*===========================================================================*/
+
+  bool WavReader::Open(const char * path, std::string & error) {
+    Close();
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      error = std::string(path) + ": " + std::strerror(errno);
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 12) {
+      close(fd);
+      error = std::string(path) + ": not a WAV file";
+      return false;
+    }
+    void * p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      error = std::string(path) + ": " + std::strerror(errno);
+      return false;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    map_ = static_cast<const uint8_t *>(p);
+    map_size_ = st.st_size;
+
+    if (std::memcmp(map_, "RIFF", 4) || std::memcmp(map_ + 8, "WAVE", 4)) {
+      error = std::string(path) + ": not a WAV file";
+      Close();
+      return false;
+    }
+
+    bool has_fmt = false;
+    size_t offset = 12;
+    while (offset + 8 <= map_size_) {
+      const uint8_t * chunk = map_ + offset;
+      const size_t available = map_size_ - offset - 8;
+      size_t size = rd32(chunk + 4);
+
+      if (!std::memcmp(chunk, "fmt ", 4) && size >= 16 && size <= available) {
+        uint16_t tag = rd16(chunk + 8);
+        if (tag == k_tag_extensible && size >= 40)
+          tag = rd16(chunk + 8 + 24);  // Sub-format GUID
+        channels_ = rd16(chunk + 10);
+        samplerate_ = rd32(chunk + 12);
+        const uint16_t bits = rd16(chunk + 22);
+        if (tag == k_tag_float && bits == 32)
+          format_ = k_wav_format_float32;
+        else if (tag == k_tag_pcm && bits == 16)
+          format_ = k_wav_format_int16;
+        else if (tag == k_tag_pcm && bits == 24)
+          format_ = k_wav_format_int24;
+        else {
+          error = std::string(path) + ": unsupported sample format";
+          Close();
+          return false;
+        }
+        frame_size_ = channels_ * sample_size(format_);
+        has_fmt = true;
+      } else if (!std::memcmp(chunk, "data", 4)) {
+        // Note: tolerate unfinalized files, data then extends to the end of the file
+        if (size == 0 || size > available)
+          size = available;
+        data_ = chunk + 8;
+        if (has_fmt && frame_size_)
+          frames_ = size / frame_size_;
+        break;
+      }
+
+      offset += 8 + size + (size & 1);
+    }
+
+    if (!has_fmt || !data_ || channels_ == 0) {
+      error = std::string(path) + ": missing fmt or data chunk";
+      Close();
+      return false;
+    }
+
+    position_ = 0;
+    return true;
+  }
+
+  void WavReader::Close() {
+    if (map_)
+      munmap(const_cast<uint8_t *>(map_), map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+    data_ = nullptr;
+    frames_ = position_ = 0;
+    channels_ = frame_size_ = 0;
+    samplerate_ = 0;
+  }
+
+  const float * WavReader::Read(size_t frames, uint16_t dst_channels, float * scratch) {
+    const size_t avail = (position_ < frames_) ? frames_ - position_ : 0;
+    const size_t n = (frames < avail) ? frames : avail;
+    const uint8_t * src = data_ + position_ * frame_size_;
+    position_ += n;
+
+    if (n == frames && format_ == k_wav_format_float32 && channels_ == dst_channels
+        && ((uintptr_t)src % alignof(float)) == 0)
+      return reinterpret_cast<const float *>(src);
+
+    const uint16_t ss = sample_size(format_);
+    float * dst = scratch;
+    for (size_t f = 0; f < n; ++f, src += frame_size_) {
+      for (uint16_t ch = 0; ch < dst_channels; ++ch)
+        *(dst++) = decode(src + (ch % channels_) * ss, format_);
+    }
+    std::memset(dst, 0, (frames - n) * dst_channels * sizeof(float));
+    return scratch;
+  }
+
+  /*===========================================================================*/
+  /* Writer */
+  /*===========================================================================*/
+
+  bool WavWriter::Open(const char * path, uint32_t samplerate, uint16_t channels, WavFormat format,
+                       std::string & error) {
+    Close();
+
+    fd_ = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+      error = std::string(path) + ": " + std::strerror(errno);
+      return false;
+    }
+
+    void * chunk = nullptr;
+    if (posix_memalign(&chunk, k_page_size, k_chunk_size) != 0) {
+      error = "out of memory";
+      close(fd_);
+      fd_ = -1;
+      return false;
+    }
+
+    chunk_ = static_cast<uint8_t *>(chunk);
+    samplerate_ = samplerate;
+    channels_ = channels;
+    format_ = format;
+    frame_size_ = channels * sample_size(format);
+    frames_ = 0;
+    data_size_ = 0;
+    ok_ = true;
+
+    // Note: header placeholder is part of the first chunk so that all chunk writes stay aligned
+    std::memset(chunk_, 0, k_header_size);
+    chunk_fill_ = k_header_size;
+    return true;
+  }
+
+  bool WavWriter::Write(const float * samples, size_t frames) {
+    if (fd_ < 0 || !ok_)
+      return false;
+
+    const size_t bytes = frames * frame_size_;
+    if (k_header_size + data_size_ + bytes > UINT32_MAX) {
+      ok_ = false;
+      return false;
+    }
+
+    const uint16_t ss = sample_size(format_);
+    const size_t count = frames * channels_;
+    for (size_t i = 0; i < count; ++i) {
+      uint8_t s[4];
+      wr32(s, encode(samples[i], format_));
+      if (chunk_fill_ + ss <= k_chunk_size) {
+        std::memcpy(chunk_ + chunk_fill_, s, ss);
+        chunk_fill_ += ss;
+        if (chunk_fill_ == k_chunk_size && !Flush())
+          return false;
+      } else {
+        // Note: sample straddles two chunks (24-bit formats)
+        const size_t head = k_chunk_size - chunk_fill_;
+        std::memcpy(chunk_ + chunk_fill_, s, head);
+        chunk_fill_ = k_chunk_size;
+        if (!Flush())
+          return false;
+        std::memcpy(chunk_, s + head, ss - head);
+        chunk_fill_ = ss - head;
+      }
+    }
+
+    data_size_ += bytes;
+    frames_ += frames;
+    return true;
+  }
+
+  bool WavWriter::Flush() {
+    size_t done = 0;
+    while (done < chunk_fill_) {
+      const ssize_t w = write(fd_, chunk_ + done, chunk_fill_ - done);
+      if (w < 0) {
+        if (errno == EINTR)
+          continue;
+        ok_ = false;
+        return false;
+      }
+      done += w;
+    }
+    chunk_fill_ = 0;
+    return true;
+  }
+
+  bool WavWriter::Close() {
+    if (fd_ < 0)
+      return true;
+
+    bool ok = ok_ && Flush();
+
+    uint8_t h[k_header_size];
+    std::memcpy(h, "RIFF", 4);
+    wr32(h + 4, (uint32_t)(k_header_size - 8 + data_size_ + (data_size_ & 1)));
+    std::memcpy(h + 8, "WAVEfmt ", 8);
+    wr32(h + 16, 16);
+    wr16(h + 20, (format_ == k_wav_format_float32) ? k_tag_float : k_tag_pcm);
+    wr16(h + 22, channels_);
+    wr32(h + 24, samplerate_);
+    wr32(h + 28, samplerate_ * frame_size_);
+    wr16(h + 32, frame_size_);
+    wr16(h + 34, sample_size(format_) * 8);
+    std::memcpy(h + 36, "data", 4);
+    wr32(h + 40, (uint32_t)data_size_);
+
+    if (ok && (data_size_ & 1)) {
+      const uint8_t pad = 0;
+      ok = write(fd_, &pad, 1) == 1;
+    }
+    ok = ok && pwrite(fd_, h, k_header_size, 0) == (ssize_t)k_header_size;
+    ok = (close(fd_) == 0) && ok;
+
+    std::free(chunk_);
+    chunk_ = nullptr;
+    fd_ = -1;
+    return ok;
+  }
+
+}  // namespace unit_host
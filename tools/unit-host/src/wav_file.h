@@ -0,0 +1,147 @@
+/**
+ * @file wav_file.h
+ * @brief Streaming WAV file reader and writer
+ *
+ * Both operate on interleaved float buffers, matching the layout of
+ * unit_render() buffers. Supported sample formats: 32-bit float, 16-bit and
+ * 24-bit integer PCM.
+ *
+ * The reader memory maps the file: float data with a matching channel count
+ * is handed out in place, other formats are converted block by block. The
+ * writer converts into a page aligned chunk buffer, flushed with large
+ * writes, so that neither side needs memory proportional to the file length.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace unit_host {
+
+  enum WavFormat {
+    k_wav_format_float32 = 0,
+    k_wav_format_int16,
+    k_wav_format_int24,
+  };
+
+  /**
+   * Parse a sample format name: "float", "16" or "24".
+   *
+   * @return True if the name was recognized.
+   */
+  bool ParseWavFormat(const char * name, WavFormat & format);
+
+  class WavReader {
+   public:
+    WavReader() = default;
+    WavReader(const WavReader &) = delete;
+    WavReader & operator=(const WavReader &) = delete;
+    ~WavReader() { Close(); }
+
+    /**
+     * Map a WAV file and parse its header.
+     *
+     * @param path  Path to the file.
+     * @param error Set to a description of the failure, if any.
+     * @return True on success.
+     */
+    bool Open(const char * path, std::string & error);
+
+    void Close();
+
+    inline uint32_t samplerate() const { return samplerate_; }
+    inline uint16_t channels() const { return channels_; }
+    inline WavFormat format() const { return format_; }
+    inline size_t frames() const { return frames_; }
+    inline size_t position() const { return position_; }
+    inline size_t remaining() const { return frames_ - position_; }
+
+    /**
+     * Rewind to the first frame.
+     */
+    inline void Rewind() { position_ = 0; }
+
+    /**
+     * Read the next block of frames.
+     *
+     * If the file holds 32-bit float data with dst_channels channels, a pointer
+     * into the mapping is returned and scratch is left untouched. Otherwise
+     * frames are converted into scratch, which must hold frames * dst_channels
+     * samples. Channels are dropped, or duplicated cyclically (e.g.: mono to
+     * stereo), to match dst_channels. Past the end of the file, frames are
+     * zero filled.
+     *
+     * @param frames       Number of frames to read.
+     * @param dst_channels Channel count expected by the caller.
+     * @param scratch      Conversion buffer.
+     * @return Pointer to frames * dst_channels interleaved samples.
+     */
+    const float * Read(size_t frames, uint16_t dst_channels, float * scratch);
+
+   private:
+    const uint8_t * map_ = nullptr;
+    size_t map_size_ = 0;
+    const uint8_t * data_ = nullptr;
+    size_t frames_ = 0;
+    size_t position_ = 0;
+    uint32_t samplerate_ = 0;
+    uint16_t channels_ = 0;
+    uint16_t frame_size_ = 0;
+    WavFormat format_ = k_wav_format_float32;
+  };
+
+  class WavWriter {
+   public:
+    WavWriter() = default;
+    WavWriter(const WavWriter &) = delete;
+    WavWriter & operator=(const WavWriter &) = delete;
+    ~WavWriter() { Close(); }
+
+    /**
+     * Create a WAV file. Samples are buffered and written in large chunks.
+     *
+     * @param path       Path to the file, truncated if it exists.
+     * @param samplerate Sample rate in Hz.
+     * @param channels   Number of interleaved channels.
+     * @param format     Sample format of the file.
+     * @param error      Set to a description of the failure, if any.
+     * @return True on success.
+     */
+    bool Open(const char * path, uint32_t samplerate, uint16_t channels, WavFormat format, std::string & error);
+
+    /**
+     * Append interleaved frames. Integer formats are clipped to [-1, 1].
+     *
+     * @return False on I/O error, or if the file would exceed the 4GB RIFF limit.
+     */
+    bool Write(const float * samples, size_t frames);
+
+    /**
+     * Flush buffered samples and finalize the header.
+     *
+     * @return False on I/O error.
+     */
+    bool Close();
+
+    inline bool is_open() const { return fd_ >= 0; }
+    inline size_t frames() const { return frames_; }
+
+   private:
+    bool Flush();
+
+    int fd_ = -1;
+    uint8_t * chunk_ = nullptr;
+    size_t chunk_fill_ = 0;
+    uint64_t data_size_ = 0;
+    size_t frames_ = 0;
+    uint32_t samplerate_ = 0;
+    uint16_t channels_ = 0;
+    uint16_t frame_size_ = 0;
+    WavFormat format_ = k_wav_format_float32;
+    bool ok_ = true;
+  };
+
+}  // namespace unit_host